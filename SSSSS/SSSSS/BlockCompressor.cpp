@@ -0,0 +1,475 @@
+#include "BlockCompressor.h"
+
+#include <cmath>
+#include <cstring>
+#include <cfloat>
+#include <algorithm>
+#include <emmintrin.h>
+
+#include "ThreadPool.h"
+
+namespace
+{
+	//bc7 interpolation weights of 4 bit indices
+	const uint32_t BC7_WEIGHTS4[16] = { 0, 4, 9, 13, 17, 21, 26, 30, 34, 38, 43, 47, 51, 55, 60, 64 };
+
+	//appends bits to a block, least significant bit first
+	class BitWriter
+	{
+	public:
+		explicit BitWriter(uint8_t* _destination) :
+			destination(_destination),
+			position(0)
+		{
+		}
+
+		void Write(uint32_t value, uint32_t bitCount)
+		{
+			for (uint32_t i = 0; i < bitCount; i++)
+			{
+				if ((value >> i) & 1)
+					destination[position >> 3] |= static_cast<uint8_t>(1 << (position & 7));
+				position++;
+			}
+		}
+
+	private:
+		uint8_t* destination;
+		uint32_t position;
+	};
+
+	uint16_t PackRGB565(const float* color)
+	{
+		uint32_t r = static_cast<uint32_t>(std::min(std::max(color[0] * 31.0f / 255.0f + 0.5f, 0.0f), 31.0f));
+		uint32_t g = static_cast<uint32_t>(std::min(std::max(color[1] * 63.0f / 255.0f + 0.5f, 0.0f), 63.0f));
+		uint32_t b = static_cast<uint32_t>(std::min(std::max(color[2] * 31.0f / 255.0f + 0.5f, 0.0f), 31.0f));
+		return static_cast<uint16_t>((r << 11) | (g << 5) | b);
+	}
+
+	void UnpackRGB565(uint16_t packed, float* color)
+	{
+		uint32_t r = (packed >> 11) & 31;
+		uint32_t g = (packed >> 5) & 63;
+		uint32_t b = packed & 31;
+		color[0] = static_cast<float>((r << 3) | (r >> 2));
+		color[1] = static_cast<float>((g << 2) | (g >> 4));
+		color[2] = static_cast<float>((b << 3) | (b >> 2));
+		color[3] = 255.0f;
+	}
+}
+
+VkFormat BlockCompressor::GetVkFormat(Format format)
+{
+	switch (format)
+	{
+	case Format::BC1: return VK_FORMAT_BC1_RGB_UNORM_BLOCK;
+	case Format::BC4: return VK_FORMAT_BC4_UNORM_BLOCK;
+	case Format::BC5: return VK_FORMAT_BC5_UNORM_BLOCK;
+	case Format::BC7: return VK_FORMAT_BC7_UNORM_BLOCK;
+	}
+	throw std::runtime_error("block compressor : unknown format!");
+}
+
+uint32_t BlockCompressor::GetBlockSize(Format format)
+{
+	return format == Format::BC1 || format == Format::BC4 ? 8 : 16;
+}
+
+uint64_t BlockCompressor::GetLevelSize(uint32_t width, uint32_t height, Format format)
+{
+	return static_cast<uint64_t>((width + 3) / 4) * ((height + 3) / 4) * GetBlockSize(format);
+}
+
+void BlockCompressor::CompressLevel(const uint8_t* source, uint32_t width, uint32_t height, Format format, uint8_t* destination, ThreadPool* pThreadPool)
+{
+	uint32_t blockCountX = (width + 3) / 4;
+	uint32_t blockCountY = (height + 3) / 4;
+	uint32_t blockSize = GetBlockSize(format);
+	auto compressRows = [&](uint32_t begin, uint32_t end)
+	{
+		Block block;
+		for (uint32_t blockY = begin; blockY < end; blockY++)
+		{
+			uint8_t* out = destination + static_cast<size_t>(blockY) * blockCountX * blockSize;
+			for (uint32_t blockX = 0; blockX < blockCountX; blockX++, out += blockSize)
+			{
+				LoadBlock(source, width, height, blockX, blockY, block);
+				switch (format)
+				{
+				case Format::BC1:
+					EncodeBC1(block, out);
+					break;
+				case Format::BC4:
+					EncodeBC4(block.r, out);
+					break;
+				case Format::BC5:
+					EncodeBC4(block.r, out);
+					EncodeBC4(block.g, out + 8);
+					break;
+				case Format::BC7:
+					EncodeBC7(block, out);
+					break;
+				}
+			}
+		}
+	};
+
+	if (pThreadPool == nullptr)
+	{
+		compressRows(0, blockCountY);
+		return;
+	}
+	pThreadPool->ParallelFor(blockCountY, 4, compressRows);
+}
+
+void BlockCompressor::LoadBlock(const uint8_t* source, uint32_t width, uint32_t height, uint32_t blockX, uint32_t blockY, Block& block)
+{
+	for (uint32_t y = 0; y < 4; y++)
+	{
+		uint32_t sourceY = std::min(blockY * 4 + y, height - 1);
+		for (uint32_t x = 0; x < 4; x++)
+		{
+			uint32_t sourceX = std::min(blockX * 4 + x, width - 1);
+			const uint8_t* texel = source + (static_cast<size_t>(sourceY) * width + sourceX) * 4;
+			block.r[y * 4 + x] = texel[0];
+			block.g[y * 4 + x] = texel[1];
+			block.b[y * 4 + x] = texel[2];
+			block.a[y * 4 + x] = texel[3];
+		}
+	}
+}
+
+//endpoints along the principal axis, 4 color mode only(color0 > color1), texel i at bits 2i of the indices
+void BlockCompressor::EncodeBC1(const Block& block, uint8_t* destination)
+{
+	float endpoint0[4];
+	float endpoint1[4];
+	FindEndpoints(block, 3, endpoint0, endpoint1);
+
+	uint16_t color0 = PackRGB565(endpoint1);//the larger end first
+	uint16_t color1 = PackRGB565(endpoint0);
+	if (color0 < color1)
+	{
+		std::swap(color0, color1);
+	}
+
+	uint8_t indices[16] = {};
+	if (color0 != color1)
+	{
+		float palette[4][4];
+		UnpackRGB565(color0, palette[0]);
+		UnpackRGB565(color1, palette[1]);
+		for (uint32_t c = 0; c < 4; c++)
+		{
+			palette[2][c] = (2.0f * palette[0][c] + palette[1][c]) / 3.0f;
+			palette[3][c] = (palette[0][c] + 2.0f * palette[1][c]) / 3.0f;
+		}
+		const float weights[4] = { 1.0f, 1.0f, 1.0f, 0.0f };
+		FitIndices(block, palette, 4, weights, indices);
+	}
+
+	uint32_t packedIndices = 0;
+	for (uint32_t i = 0; i < 16; i++)
+	{
+		packedIndices |= static_cast<uint32_t>(indices[i]) << (i * 2);
+	}
+	memcpy(destination, &color0, 2);
+	memcpy(destination + 2, &color1, 2);
+	memcpy(destination + 4, &packedIndices, 4);
+}
+
+//8 value mode(red0 > red1) between the extremes of the channel, texel i at bits 16 + 3i of the block
+void BlockCompressor::EncodeBC4(const float* channel, uint8_t* destination)
+{
+	float minValue = channel[0];
+	float maxValue = channel[0];
+	for (uint32_t i = 1; i < 16; i++)
+	{
+		minValue = std::min(minValue, channel[i]);
+		maxValue = std::max(maxValue, channel[i]);
+	}
+	uint32_t red0 = static_cast<uint32_t>(maxValue);
+	uint32_t red1 = static_cast<uint32_t>(minValue);
+
+	uint8_t indices[16] = {};
+	if (red0 != red1)
+	{
+		Block single = {};
+		memcpy(single.r, channel, sizeof(single.r));
+		float palette[8][4] = {};
+		palette[0][0] = static_cast<float>(red0);
+		palette[1][0] = static_cast<float>(red1);
+		for (uint32_t i = 2; i < 8; i++)
+		{
+			palette[i][0] = ((8 - i) * palette[0][0] + (i - 1) * palette[1][0]) / 7.0f;
+		}
+		const float weights[4] = { 1.0f, 0.0f, 0.0f, 0.0f };
+		FitIndices(single, palette, 8, weights, indices);
+	}
+
+	uint64_t bits = red0 | (red1 << 8);
+	for (uint32_t i = 0; i < 16; i++)
+	{
+		bits |= static_cast<uint64_t>(indices[i]) << (16 + i * 3);
+	}
+	memcpy(destination, &bits, 8);
+}
+
+//mode 6 only: one subset, rgba endpoints of 7 bits plus a p-bit each and 4 bit indices,
+//the endpoints of the principal axis are tried with every p-bit pair and refined once by least squares on the chosen indices
+void BlockCompressor::EncodeBC7(const Block& block, uint8_t* destination)
+{
+	const float weights[4] = { 1.0f, 1.0f, 1.0f, 1.0f };
+
+	auto quantize = [](const float* endpoint, uint32_t pBit, uint32_t* quantized)
+	{
+		for (uint32_t c = 0; c < 4; c++)
+		{
+			int32_t value = static_cast<int32_t>(std::floor((endpoint[c] - pBit) * 0.5f + 0.5f));
+			quantized[c] = static_cast<uint32_t>(std::min(std::max(value, 0), 127));
+		}
+	};
+	auto buildPalette = [](const uint32_t* quantized0, uint32_t pBit0, const uint32_t* quantized1, uint32_t pBit1, float (*palette)[4])
+	{
+		for (uint32_t i = 0; i < 16; i++)
+		{
+			for (uint32_t c = 0; c < 4; c++)
+			{
+				uint32_t value0 = (quantized0[c] << 1) | pBit0;
+				uint32_t value1 = (quantized1[c] << 1) | pBit1;
+				palette[i][c] = static_cast<float>(((64 - BC7_WEIGHTS4[i]) * value0 + BC7_WEIGHTS4[i] * value1 + 32) >> 6);
+			}
+		}
+	};
+
+	float endpoint0[4];
+	float endpoint1[4];
+	FindEndpoints(block, 4, endpoint0, endpoint1);
+
+	float bestError = FLT_MAX;
+	uint32_t bestQuantized0[4];
+	uint32_t bestQuantized1[4];
+	uint32_t bestPBit0 = 0;
+	uint32_t bestPBit1 = 0;
+	uint8_t bestIndices[16];
+	for (uint32_t pass = 0; pass < 2; pass++)
+	{
+		for (uint32_t pBits = 0; pBits < 4; pBits++)
+		{
+			uint32_t pBit0 = pBits & 1;
+			uint32_t pBit1 = pBits >> 1;
+			uint32_t quantized0[4];
+			uint32_t quantized1[4];
+			quantize(endpoint0, pBit0, quantized0);
+			quantize(endpoint1, pBit1, quantized1);
+
+			float palette[16][4];
+			uint8_t indices[16];
+			buildPalette(quantized0, pBit0, quantized1, pBit1, palette);
+			float error = FitIndices(block, palette, 16, weights, indices);
+			if (error < bestError)
+			{
+				bestError = error;
+				memcpy(bestQuantized0, quantized0, sizeof(quantized0));
+				memcpy(bestQuantized1, quantized1, sizeof(quantized1));
+				bestPBit0 = pBit0;
+				bestPBit1 = pBit1;
+				memcpy(bestIndices, indices, sizeof(indices));
+			}
+		}
+		if (bestError == 0.0f || pass == 1)
+			break;
+
+		//least squares endpoints for the interpolation weights of the best indices
+		float sumWW = 0.0f, sumW1W1 = 0.0f, sumWW1 = 0.0f;
+		float sumWX[4] = {}, sumW1X[4] = {};
+		const float* channels[4] = { block.r, block.g, block.b, block.a };
+		for (uint32_t i = 0; i < 16; i++)
+		{
+			float w = BC7_WEIGHTS4[bestIndices[i]] / 64.0f;
+			float w1 = 1.0f - w;
+			sumWW += w * w;
+			sumW1W1 += w1 * w1;
+			sumWW1 += w * w1;
+			for (uint32_t c = 0; c < 4; c++)
+			{
+				sumWX[c] += w * channels[c][i];
+				sumW1X[c] += w1 * channels[c][i];
+			}
+		}
+		float determinant = sumW1W1 * sumWW - sumWW1 * sumWW1;
+		if (std::abs(determinant) < 1e-6f)
+			break;
+		for (uint32_t c = 0; c < 4; c++)
+		{
+			endpoint0[c] = std::min(std::max((sumWW * sumW1X[c] - sumWW1 * sumWX[c]) / determinant, 0.0f), 255.0f);
+			endpoint1[c] = std::min(std::max((sumW1W1 * sumWX[c] - sumWW1 * sumW1X[c]) / determinant, 0.0f), 255.0f);
+		}
+	}
+
+	//the most significant index bit of texel 0 is implied 0, swap the endpoints when it is set
+	if (bestIndices[0] >= 8)
+	{
+		std::swap(bestQuantized0, bestQuantized1);
+		std::swap(bestPBit0, bestPBit1);
+		for (uint32_t i = 0; i < 16; i++)
+		{
+			bestIndices[i] = 15 - bestIndices[i];
+		}
+	}
+
+	memset(destination, 0, 16);
+	BitWriter writer(destination);
+	writer.Write(1 << 6, 7);//mode 6
+	for (uint32_t c = 0; c < 4; c++)
+	{
+		writer.Write(bestQuantized0[c], 7);
+		writer.Write(bestQuantized1[c], 7);
+	}
+	writer.Write(bestPBit0, 1);
+	writer.Write(bestPBit1, 1);
+	writer.Write(bestIndices[0], 3);
+	for (uint32_t i = 1; i < 16; i++)
+	{
+		writer.Write(bestIndices[i], 4);
+	}
+}
+
+float BlockCompressor::FitIndices(const Block& block, const float (*palette)[4], uint32_t paletteSize, const float* weights, uint8_t* indices)
+{
+	const __m128 weightR = _mm_set1_ps(weights[0]);
+	const __m128 weightG = _mm_set1_ps(weights[1]);
+	const __m128 weightB = _mm_set1_ps(weights[2]);
+	const __m128 weightA = _mm_set1_ps(weights[3]);
+	__m128 totalError = _mm_setzero_ps();
+	for (uint32_t i = 0; i < 16; i += 4)
+	{
+		__m128 r = _mm_load_ps(block.r + i);
+		__m128 g = _mm_load_ps(block.g + i);
+		__m128 b = _mm_load_ps(block.b + i);
+		__m128 a = _mm_load_ps(block.a + i);
+		__m128 bestError = _mm_set1_ps(FLT_MAX);
+		__m128i bestIndex = _mm_setzero_si128();
+		for (uint32_t p = 0; p < paletteSize; p++)
+		{
+			__m128 dr = _mm_sub_ps(r, _mm_set1_ps(palette[p][0]));
+			__m128 dg = _mm_sub_ps(g, _mm_set1_ps(palette[p][1]));
+			__m128 db = _mm_sub_ps(b, _mm_set1_ps(palette[p][2]));
+			__m128 da = _mm_sub_ps(a, _mm_set1_ps(palette[p][3]));
+			__m128 error = _mm_add_ps(
+				_mm_add_ps(_mm_mul_ps(_mm_mul_ps(dr, dr), weightR), _mm_mul_ps(_mm_mul_ps(dg, dg), weightG)),
+				_mm_add_ps(_mm_mul_ps(_mm_mul_ps(db, db), weightB), _mm_mul_ps(_mm_mul_ps(da, da), weightA)));
+			__m128 better = _mm_cmplt_ps(error, bestError);
+			bestError = _mm_min_ps(error, bestError);
+			bestIndex = _mm_or_si128(_mm_and_si128(_mm_castps_si128(better), _mm_set1_epi32(static_cast<int>(p))), _mm_andnot_si128(_mm_castps_si128(better), bestIndex));
+		}
+		totalError = _mm_add_ps(totalError, bestError);
+
+		alignas(16) int32_t bestIndexArr[4];
+		_mm_store_si128(reinterpret_cast<__m128i*>(bestIndexArr), bestIndex);
+		for (uint32_t j = 0; j < 4; j++)
+		{
+			indices[i + j] = static_cast<uint8_t>(bestIndexArr[j]);
+		}
+	}
+
+	alignas(16) float totalErrorArr[4];
+	_mm_store_ps(totalErrorArr, totalError);
+	return totalErrorArr[0] + totalErrorArr[1] + totalErrorArr[2] + totalErrorArr[3];
+}
+
+void BlockCompressor::FindPrincipalAxis(const Block& block, uint32_t channelCount, float* mean, float* axis)
+{
+	const float* channels[4] = { block.r, block.g, block.b, block.a };
+	for (uint32_t c = 0; c < 4; c++)
+	{
+		mean[c] = 0.0f;
+		for (uint32_t i = 0; i < 16 && c < channelCount; i++)
+			mean[c] += channels[c][i];
+		mean[c] /= 16.0f;
+	}
+
+	float covariance[4][4] = {};
+	for (uint32_t i = 0; i < 16; i++)
+	{
+		for (uint32_t c0 = 0; c0 < channelCount; c0++)
+		{
+			for (uint32_t c1 = c0; c1 < channelCount; c1++)
+			{
+				covariance[c0][c1] += (channels[c0][i] - mean[c0]) * (channels[c1][i] - mean[c1]);
+			}
+		}
+	}
+	for (uint32_t c0 = 0; c0 < channelCount; c0++)
+	{
+		for (uint32_t c1 = 0; c1 < c0; c1++)
+			covariance[c0][c1] = covariance[c1][c0];
+	}
+
+	//power iteration from the diagonal of the bounding box
+	for (uint32_t c = 0; c < 4; c++)
+		axis[c] = c < channelCount ? 1.0f : 0.0f;
+	for (uint32_t iteration = 0; iteration < 8; iteration++)
+	{
+		float next[4] = {};
+		float length = 0.0f;
+		for (uint32_t c0 = 0; c0 < channelCount; c0++)
+		{
+			for (uint32_t c1 = 0; c1 < channelCount; c1++)
+				next[c0] += covariance[c0][c1] * axis[c1];
+			length = std::max(length, std::abs(next[c0]));
+		}
+		if (length < 1e-6f)
+		{
+			//a flat block, any axis does
+			return;
+		}
+		for (uint32_t c = 0; c < channelCount; c++)
+			axis[c] = next[c] / length;
+	}
+}
+
+//the extremes of the texels projected on the principal axis
+void BlockCompressor::FindEndpoints(const Block& block, uint32_t channelCount, float* endpoint0, float* endpoint1)
+{
+	float mean[4];
+	float axis[4];
+	FindPrincipalAxis(block, channelCount, mean, axis);
+
+	const __m128 axisR = _mm_set1_ps(axis[0]);
+	const __m128 axisG = _mm_set1_ps(axis[1]);
+	const __m128 axisB = _mm_set1_ps(axis[2]);
+	const __m128 axisA = _mm_set1_ps(channelCount == 4 ? axis[3] : 0.0f);
+	__m128 minProjection = _mm_set1_ps(FLT_MAX);
+	__m128 maxProjection = _mm_set1_ps(-FLT_MAX);
+	for (uint32_t i = 0; i < 16; i += 4)
+	{
+		__m128 projection = _mm_add_ps(
+			_mm_add_ps(_mm_mul_ps(_mm_sub_ps(_mm_load_ps(block.r + i), _mm_set1_ps(mean[0])), axisR), _mm_mul_ps(_mm_sub_ps(_mm_load_ps(block.g + i), _mm_set1_ps(mean[1])), axisG)),
+			_mm_add_ps(_mm_mul_ps(_mm_sub_ps(_mm_load_ps(block.b + i), _mm_set1_ps(mean[2])), axisB), _mm_mul_ps(_mm_sub_ps(_mm_load_ps(block.a + i), _mm_set1_ps(mean[3])), axisA)));
+		minProjection = _mm_min_ps(minProjection, projection);
+		maxProjection = _mm_max_ps(maxProjection, projection);
+	}
+	alignas(16) float minArr[4];
+	alignas(16) float maxArr[4];
+	_mm_store_ps(minArr, minProjection);
+	_mm_store_ps(maxArr, maxProjection);
+	float tMin = std::min(std::min(minArr[0], minArr[1]), std::min(minArr[2], minArr[3]));
+	float tMax = std::max(std::max(maxArr[0], maxArr[1]), std::max(maxArr[2], maxArr[3]));
+
+	float axisLengthSquared = 0.0f;
+	for (uint32_t c = 0; c < channelCount; c++)
+		axisLengthSquared += axis[c] * axis[c];
+	tMin /= axisLengthSquared;
+	tMax /= axisLengthSquared;
+	for (uint32_t c = 0; c < 4; c++)
+	{
+		float direction = c < channelCount ? axis[c] : 0.0f;
+		endpoint0[c] = std::min(std::max(mean[c] + direction * tMin, 0.0f), 255.0f);
+		endpoint1[c] = std::min(std::max(mean[c] + direction * tMax, 0.0f), 255.0f);
+	}
+	if (channelCount == 3)
+	{
+		endpoint0[3] = endpoint1[3] = 255.0f;
+	}
+}
@@ -0,0 +1,41 @@
+#pragma once
+
+#include "GlobalInclude.h"
+
+class ThreadPool;
+
+//cpu encoder of rgba8 images into bc block formats, blocks are fitted with sse2 and rows of blocks are spread over the thread pool,
+//bc1 for opaque color, bc4 for one channel(red), bc5 for two channels(red, green), bc7 for color with alpha at the highest quality
+class BlockCompressor
+{
+public:
+	enum class Format { BC1, BC4, BC5, BC7 };
+
+	static VkFormat GetVkFormat(Format format);
+	static uint32_t GetBlockSize(Format format);//in bytes, every block covers 4x4 texels
+	static uint64_t GetLevelSize(uint32_t width, uint32_t height, Format format);
+
+	//partial blocks at the right and bottom edges repeat the last texel, pThreadPool can be null
+	static void CompressLevel(const uint8_t* source, uint32_t width, uint32_t height, Format format, uint8_t* destination, ThreadPool* pThreadPool);
+
+private:
+	//one 4x4 block in structure of arrays, 4 texels per sse register
+	struct Block
+	{
+		alignas(16) float r[16];
+		alignas(16) float g[16];
+		alignas(16) float b[16];
+		alignas(16) float a[16];
+	};
+
+	static void LoadBlock(const uint8_t* source, uint32_t width, uint32_t height, uint32_t blockX, uint32_t blockY, Block& block);
+	static void EncodeBC1(const Block& block, uint8_t* destination);
+	static void EncodeBC4(const float* channel, uint8_t* destination);
+	static void EncodeBC7(const Block& block, uint8_t* destination);
+
+	//nearest palette entry of every texel by weighted squared distance, returns the total error
+	static float FitIndices(const Block& block, const float (*palette)[4], uint32_t paletteSize, const float* weights, uint8_t* indices);
+	//principal axis of the texels through their mean, channelCount 3 ignores alpha
+	static void FindPrincipalAxis(const Block& block, uint32_t channelCount, float* mean, float* axis);
+	static void FindEndpoints(const Block& block, uint32_t channelCount, float* endpoint0, float* endpoint1);
+};
@@ -61,6 +61,16 @@ float Camera::GetFar() const
 	return far;
 }
 
+float Camera::GetFov() const
+{
+	return fov;
+}
+
+uint32_t Camera::GetHeight() const
+{
+	return height;
+}
+
 OrbitCamera::OrbitCamera(
 	const std::string& _name,
 	float _distance,
@@ -21,6 +21,8 @@ public:
 	glm::mat4 GetViewMatrix() const;
 	float GetNear() const;
 	float GetFar() const;
+	float GetFov() const;//vertical, in degrees
+	uint32_t GetHeight() const;
 
 	void CleanUp();
 
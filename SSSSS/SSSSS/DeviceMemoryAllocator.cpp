@@ -0,0 +1,291 @@
+#include "DeviceMemoryAllocator.h"
+
+#include "Renderer.h"
+
+DeviceMemoryAllocator::DeviceMemoryAllocator() :
+	pRenderer(nullptr),
+	memoryProperties({})
+{
+}
+
+DeviceMemoryAllocator::~DeviceMemoryAllocator()
+{
+	CleanUp();
+}
+
+void DeviceMemoryAllocator::InitDeviceMemoryAllocator(Renderer* _pRenderer)
+{
+	if (_pRenderer == nullptr)
+	{
+		throw std::runtime_error("device memory allocator : pRenderer is null!");
+	}
+
+	pRenderer = _pRenderer;
+	vkGetPhysicalDeviceMemoryProperties(pRenderer->GetPhysicalDevice(), &memoryProperties);
+
+	VkPhysicalDeviceProperties physicalDeviceProperties;
+	vkGetPhysicalDeviceProperties(pRenderer->GetPhysicalDevice(), &physicalDeviceProperties);
+	stats.maxDeviceAllocationCount = physicalDeviceProperties.limits.maxMemoryAllocationCount;
+}
+
+void DeviceMemoryAllocator::CleanUp()
+{
+	if (pRenderer != nullptr)
+	{
+		for (Pool& pool : poolVec)
+		{
+			for (Block& block : pool.blockVec)
+			{
+				if (block.memory != VK_NULL_HANDLE)
+				{
+					vkFreeMemory(pRenderer->GetDevice(), block.memory, nullptr);
+				}
+			}
+		}
+		poolVec.clear();
+		stats = MemoryStats();
+		pRenderer = nullptr;
+	}
+}
+
+DeviceMemoryAllocator::Allocation DeviceMemoryAllocator::Allocate(const VkMemoryRequirements& requirements, uint32_t memoryTypeIndex, ResourceType resourceType, MemoryUsage usage)
+{
+	Allocation allocation;
+	VkDeviceSize size = requirements.size;
+	bool dedicated =
+		usage == MemoryUsage::Dedicated ||
+		(usage == MemoryUsage::Pooled && size > DEDICATED_ALLOCATION_SIZE) ||
+		(usage == MemoryUsage::Transient && size > TRANSIENT_BLOCK_SIZE);
+	if (dedicated)
+	{
+		allocation.memory = AllocateDeviceMemory(size, memoryTypeIndex, &allocation.pMapped);
+		allocation.size = size;
+		stats.dedicatedCount++;
+		stats.allocationCount++;
+		stats.usedSize += size;
+		return allocation;
+	}
+
+	SizeClass sizeClass = usage == MemoryUsage::Transient ? SizeClass::Transient : size <= SMALL_ALLOCATION_SIZE ? SizeClass::Small : SizeClass::Large;
+	uint32_t poolIndex = GetPool(memoryTypeIndex, resourceType, sizeClass);
+
+	//first fit, blocks are few so a linear search is fine
+	for (uint32_t i = 0; i < poolVec[poolIndex].blockVec.size(); i++)
+	{
+		if (AllocateFromBlock(poolIndex, i, requirements, allocation))
+			return allocation;
+	}
+
+	VkDeviceSize blockSize = sizeClass == SizeClass::Transient ? TRANSIENT_BLOCK_SIZE : sizeClass == SizeClass::Small ? SMALL_BLOCK_SIZE : LARGE_BLOCK_SIZE;
+	CreateBlock(poolIndex, blockSize);
+	for (uint32_t i = 0; i < poolVec[poolIndex].blockVec.size(); i++)
+	{
+		if (AllocateFromBlock(poolIndex, i, requirements, allocation))
+			return allocation;
+	}
+	throw std::runtime_error("device memory allocator : failed to allocate from a new block!");
+}
+
+void DeviceMemoryAllocator::Free(Allocation& allocation)
+{
+	if (allocation.memory == VK_NULL_HANDLE)
+		return;
+
+	stats.allocationCount--;
+	stats.usedSize -= allocation.size;
+
+	if (allocation.pool == UINT32_MAX)
+	{
+		FreeDeviceMemory(allocation.memory, allocation.size);
+		stats.dedicatedCount--;
+		allocation = Allocation();
+		return;
+	}
+
+	Pool& pool = poolVec[allocation.pool];
+	Block& block = pool.blockVec[allocation.block];
+	block.allocationCount--;
+	if (pool.sizeClass == SizeClass::Transient)
+	{
+		//everything bumped through the block is gone, give the memory back until the next burst of transient resources
+		if (block.allocationCount == 0)
+		{
+			FreeDeviceMemory(block.memory, block.size);
+			block.memory = VK_NULL_HANDLE;
+			block.pMapped = nullptr;
+			block.head = 0;
+			stats.blockCount--;
+		}
+	}
+	else
+	{
+		FreeToBlock(block, allocation.offset, allocation.size);
+	}
+	allocation = Allocation();
+}
+
+const DeviceMemoryAllocator::MemoryStats& DeviceMemoryAllocator::GetMemoryStats() const
+{
+	return stats;
+}
+
+uint32_t DeviceMemoryAllocator::GetPool(uint32_t memoryTypeIndex, ResourceType resourceType, SizeClass sizeClass)
+{
+	for (uint32_t i = 0; i < poolVec.size(); i++)
+	{
+		if (poolVec[i].memoryTypeIndex == memoryTypeIndex && poolVec[i].resourceType == resourceType && poolVec[i].sizeClass == sizeClass)
+			return i;
+	}
+
+	poolVec.push_back({ memoryTypeIndex, resourceType, sizeClass, {} });
+	return static_cast<uint32_t>(poolVec.size() - 1);
+}
+
+bool DeviceMemoryAllocator::AllocateFromBlock(uint32_t poolIndex, uint32_t blockIndex, const VkMemoryRequirements& requirements, Allocation& allocation)
+{
+	Pool& pool = poolVec[poolIndex];
+	Block& block = pool.blockVec[blockIndex];
+	if (block.memory == VK_NULL_HANDLE)
+		return false;
+
+	//vulkan alignments are powers of two
+	VkDeviceSize alignmentMask = requirements.alignment - 1;
+	VkDeviceSize offset = 0;
+	if (pool.sizeClass == SizeClass::Transient)
+	{
+		offset = (block.head + alignmentMask) & ~alignmentMask;
+		if (offset + requirements.size > block.size)
+			return false;
+
+		block.head = offset + requirements.size;
+	}
+	else
+	{
+		bool found = false;
+		for (auto it = block.freeRangeMap.begin(); it != block.freeRangeMap.end(); ++it)
+		{
+			VkDeviceSize rangeOffset = it->first;
+			VkDeviceSize rangeEnd = it->first + it->second;
+			offset = (rangeOffset + alignmentMask) & ~alignmentMask;
+			if (offset + requirements.size > rangeEnd)
+				continue;
+
+			//keep what is left on both sides of the allocation
+			block.freeRangeMap.erase(it);
+			if (offset > rangeOffset)
+			{
+				block.freeRangeMap.emplace(rangeOffset, offset - rangeOffset);
+			}
+			if (offset + requirements.size < rangeEnd)
+			{
+				block.freeRangeMap.emplace(offset + requirements.size, rangeEnd - offset - requirements.size);
+			}
+			found = true;
+			break;
+		}
+		if (!found)
+			return false;
+	}
+
+	allocation.memory = block.memory;
+	allocation.offset = offset;
+	allocation.size = requirements.size;
+	allocation.pMapped = block.pMapped != nullptr ? block.pMapped + offset : nullptr;
+	allocation.pool = poolIndex;
+	allocation.block = blockIndex;
+	block.allocationCount++;
+	stats.allocationCount++;
+	stats.usedSize += requirements.size;
+	return true;
+}
+
+void DeviceMemoryAllocator::CreateBlock(uint32_t poolIndex, VkDeviceSize size)
+{
+	Pool& pool = poolVec[poolIndex];
+
+	Block block;
+	block.size = size;
+	void* pMapped = nullptr;
+	block.memory = AllocateDeviceMemory(size, pool.memoryTypeIndex, &pMapped);
+	block.pMapped = static_cast<uint8_t*>(pMapped);
+	if (pool.sizeClass != SizeClass::Transient)
+	{
+		block.freeRangeMap.emplace(0, size);
+	}
+	stats.blockCount++;
+
+	//released transient blocks keep their slot, so the indices in live allocations stay valid
+	for (Block& slot : pool.blockVec)
+	{
+		if (slot.memory == VK_NULL_HANDLE)
+		{
+			slot = std::move(block);
+			return;
+		}
+	}
+	pool.blockVec.push_back(std::move(block));
+}
+
+void DeviceMemoryAllocator::FreeToBlock(Block& block, VkDeviceSize offset, VkDeviceSize size)
+{
+	std::map<VkDeviceSize, VkDeviceSize>& freeRangeMap = block.freeRangeMap;
+
+	//merge with the free range after
+	auto next = freeRangeMap.lower_bound(offset);
+	if (next != freeRangeMap.end() && next->first == offset + size)
+	{
+		size += next->second;
+		next = freeRangeMap.erase(next);
+	}
+
+	//merge with the free range before
+	if (next != freeRangeMap.begin())
+	{
+		auto previous = std::prev(next);
+		if (previous->first + previous->second == offset)
+		{
+			previous->second += size;
+			size = 0;
+		}
+	}
+	if (size != 0)
+	{
+		freeRangeMap.emplace(offset, size);
+	}
+}
+
+VkDeviceMemory DeviceMemoryAllocator::AllocateDeviceMemory(VkDeviceSize size, uint32_t memoryTypeIndex, void** ppMapped)
+{
+	if (pRenderer == nullptr)
+	{
+		throw std::runtime_error("device memory allocator : not initialized!");
+	}
+
+	VkMemoryAllocateInfo allocInfo = {};
+	allocInfo.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
+	allocInfo.allocationSize = size;
+	allocInfo.memoryTypeIndex = memoryTypeIndex;
+
+	VkDeviceMemory memory;
+	if (vkAllocateMemory(pRenderer->GetDevice(), &allocInfo, nullptr, &memory) != VK_SUCCESS) {
+		throw std::runtime_error("failed to allocate device memory!");
+	}
+
+	*ppMapped = nullptr;
+	if (memoryProperties.memoryTypes[memoryTypeIndex].propertyFlags & VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT)
+	{
+		vkMapMemory(pRenderer->GetDevice(), memory, 0, VK_WHOLE_SIZE, 0, ppMapped);
+	}
+
+	stats.deviceAllocationCount++;
+	stats.reservedSize += size;
+	return memory;
+}
+
+void DeviceMemoryAllocator::FreeDeviceMemory(VkDeviceMemory memory, VkDeviceSize size)
+{
+	//freeing unmaps as well
+	vkFreeMemory(pRenderer->GetDevice(), memory, nullptr);
+	stats.deviceAllocationCount--;
+	stats.reservedSize -= size;
+}
@@ -0,0 +1,92 @@
+#pragma once
+
+#include <map>
+
+#include "GlobalInclude.h"
+
+class Renderer;
+
+//device memory of every buffer and image sub-allocated from a few vkAllocateMemory blocks per memory type,
+//small and large allocations live in blocks of their own size class so small ones do not fragment the large blocks,
+//transient allocations are bumped linearly through blocks that are released once everything in them is freed,
+//very large allocations get device memory of their own
+class DeviceMemoryAllocator
+{
+public:
+	enum class MemoryUsage { Pooled, Transient, Dedicated };
+	//linear and optimal resources never share a block, so bufferImageGranularity never has to be respected between neighbours
+	enum class ResourceType { Buffer, Image };
+
+	struct Allocation
+	{
+		VkDeviceMemory memory = VK_NULL_HANDLE;
+		VkDeviceSize offset = 0;
+		VkDeviceSize size = 0;
+		void* pMapped = nullptr;//host visible memory stays mapped as long as it lives
+		uint32_t pool = UINT32_MAX;//UINT32_MAX for dedicated allocations
+		uint32_t block = UINT32_MAX;
+	};
+
+	//instrumentation
+	struct MemoryStats
+	{
+		uint32_t deviceAllocationCount = 0;//live vkAllocateMemory allocations
+		uint32_t maxDeviceAllocationCount = 0;//maxMemoryAllocationCount of the device
+		uint32_t blockCount = 0;
+		uint32_t dedicatedCount = 0;
+		uint32_t allocationCount = 0;
+		VkDeviceSize reservedSize = 0;
+		VkDeviceSize usedSize = 0;
+	};
+
+	//allocations up to this size go to the small blocks
+	static const VkDeviceSize SMALL_ALLOCATION_SIZE = 256 * 1024;
+	static const VkDeviceSize SMALL_BLOCK_SIZE = 8 * 1024 * 1024;
+	static const VkDeviceSize LARGE_BLOCK_SIZE = 64 * 1024 * 1024;
+	static const VkDeviceSize TRANSIENT_BLOCK_SIZE = 64 * 1024 * 1024;
+	//larger pooled allocations get device memory of their own
+	static const VkDeviceSize DEDICATED_ALLOCATION_SIZE = 32 * 1024 * 1024;
+
+	DeviceMemoryAllocator();
+	~DeviceMemoryAllocator();
+
+	void InitDeviceMemoryAllocator(Renderer* _pRenderer);
+	void CleanUp();
+
+	Allocation Allocate(const VkMemoryRequirements& requirements, uint32_t memoryTypeIndex, ResourceType resourceType, MemoryUsage usage);
+	void Free(Allocation& allocation);
+	const MemoryStats& GetMemoryStats() const;
+
+private:
+	enum class SizeClass { Small, Large, Transient };
+
+	struct Block
+	{
+		VkDeviceMemory memory = VK_NULL_HANDLE;//null once a released transient block waits for reuse
+		VkDeviceSize size = 0;
+		uint8_t* pMapped = nullptr;
+		std::map<VkDeviceSize, VkDeviceSize> freeRangeMap;//offset to size, neighbouring free ranges are always merged, unused by transient blocks
+		VkDeviceSize head = 0;//next free offset of transient blocks
+		uint32_t allocationCount = 0;
+	};
+
+	struct Pool
+	{
+		uint32_t memoryTypeIndex;
+		ResourceType resourceType;
+		SizeClass sizeClass;
+		std::vector<Block> blockVec;
+	};
+
+	Renderer* pRenderer;
+	VkPhysicalDeviceMemoryProperties memoryProperties;
+	std::vector<Pool> poolVec;
+	MemoryStats stats;
+
+	uint32_t GetPool(uint32_t memoryTypeIndex, ResourceType resourceType, SizeClass sizeClass);
+	bool AllocateFromBlock(uint32_t poolIndex, uint32_t blockIndex, const VkMemoryRequirements& requirements, Allocation& allocation);
+	void CreateBlock(uint32_t poolIndex, VkDeviceSize size);
+	void FreeToBlock(Block& block, VkDeviceSize offset, VkDeviceSize size);
+	VkDeviceMemory AllocateDeviceMemory(VkDeviceSize size, uint32_t memoryTypeIndex, void** ppMapped);
+	void FreeDeviceMemory(VkDeviceMemory memory, VkDeviceSize size);
+};
@@ -43,9 +43,11 @@ void Frame::InitFrame(Renderer* _pRenderer, VkDescriptorPool descriptorPool)
 	pRenderer->BindUniformBufferToDescriptorSets(frameUniformBuffer, 0, sizeof(fUBO), { frameDescriptorSet }, 0);//only 1 fUBO
 
 	//bind texture
+	boundImageViewVec.resize(pTextureVec.size());
 	for (int i = 0; i < pTextureVec.size(); i++)
 	{
 		pRenderer->BindTextureToDescriptorSets(pTextureVec[i]->GetTextureImageView(), pTextureVec[i]->GetSampler(), { frameDescriptorSet }, fUboCount + i);//only 1 fUBO, so offset is 1
+		boundImageViewVec[i] = pTextureVec[i]->GetTextureImageView();
 	}
 }
 
@@ -54,8 +56,7 @@ void Frame::CleanUp()
 	if (pRenderer != nullptr)
 	{
 		vkDestroyDescriptorSetLayout(pRenderer->GetDevice(), frameDescriptorSetLayout, nullptr);
-		vkDestroyBuffer(pRenderer->GetDevice(), frameUniformBuffer, nullptr);
-		vkFreeMemory(pRenderer->GetDevice(), frameUniformBufferMemory, nullptr);
+		pRenderer->DestroyBuffer(frameUniformBuffer, frameUniformBufferAllocation);
 		pRenderer = nullptr;
 	}
 }
@@ -90,6 +91,19 @@ VkDescriptorSet* Frame::GetFrameDescriptorSetPtr()
 	return &frameDescriptorSet;
 }
 
+void Frame::UpdateTextureBindings()
+{
+	for (size_t i = 0; i < pTextureVec.size(); i++)
+	{
+		VkImageView imageView = pTextureVec[i]->GetTextureImageView();
+		if (boundImageViewVec[i] == imageView)
+			continue;
+
+		pRenderer->BindTextureToDescriptorSets(imageView, pTextureVec[i]->GetSampler(), { frameDescriptorSet }, fUboCount + static_cast<uint32_t>(i));
+		boundImageViewVec[i] = imageView;
+	}
+}
+
 VkDescriptorSetLayout Frame::GetFrameDescriptorSetLayout() const
 {
 	return frameDescriptorSetLayout;
@@ -103,9 +117,8 @@ void Frame::AddTexture(Texture* pTexture)
 void Frame::UpdateFrameUniformBuffer()
 {
 	void* data;
-	vkMapMemory(pRenderer->GetDevice(), frameUniformBufferMemory, 0, sizeof(fUBO), 0, &data);
+	data = frameUniformBufferAllocation.pMapped;
 	memcpy(data, &fUBO, sizeof(fUBO));
-	vkUnmapMemory(pRenderer->GetDevice(), frameUniformBufferMemory);
 }
 
 void Frame::CreateFrameUniformBuffer()
@@ -116,7 +129,7 @@ void Frame::CreateFrameUniformBuffer()
 		VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT,
 		VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
 		frameUniformBuffer,
-		frameUniformBufferMemory);
+		frameUniformBufferAllocation);
 
 	//initial update
 	UpdateFrameUniformBuffer();
@@ -1,6 +1,7 @@
 #pragma once
 
 #include "GlobalInclude.h"
+#include "DeviceMemoryAllocator.h"
 
 class Renderer;
 class Texture;
@@ -18,6 +19,9 @@ public:
 	VkBuffer GetFrameUniformBuffer() const;
 	const FrameUniformBufferObject& GetFrameUniformBufferObject() const;
 	VkDescriptorSet* GetFrameDescriptorSetPtr();
+	//rewrites the textures whose image view changed since they were bound, like Pass::UpdateTextureBindings,
+	//call after the frame's fence has signalled and before the set is bound
+	void UpdateTextureBindings();
 	VkDescriptorSetLayout GetFrameDescriptorSetLayout() const;
 
 	void AddTexture(Texture* pTexture);
@@ -38,8 +42,9 @@ private:
 	//frame uniform
 	FrameUniformBufferObject fUBO;
 	VkBuffer frameUniformBuffer;
-	VkDeviceMemory frameUniformBufferMemory;
+	DeviceMemoryAllocator::Allocation frameUniformBufferAllocation;
 	VkDescriptorSet frameDescriptorSet;
+	std::vector<VkImageView> boundImageViewVec;//[texture], what the descriptor set holds
 	VkDescriptorSetLayout frameDescriptorSetLayout;
 
 	void CreateFrameUniformBuffer();
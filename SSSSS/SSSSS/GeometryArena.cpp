@@ -0,0 +1,158 @@
+#include "GeometryArena.h"
+
+#include "Renderer.h"
+
+GeometryArena::GeometryArena() :
+	pRenderer(nullptr)
+{
+}
+
+GeometryArena::~GeometryArena()
+{
+	CleanUp();
+}
+
+void GeometryArena::InitGeometryArena(Renderer* _pRenderer)
+{
+	if (_pRenderer == nullptr)
+	{
+		throw std::runtime_error("geometry arena : pRenderer is null!");
+	}
+
+	pRenderer = _pRenderer;
+}
+
+void GeometryArena::CleanUp()
+{
+	if (pRenderer != nullptr)
+	{
+		for (Block& block : blockVec)
+		{
+			pRenderer->DestroyBuffer(block.buffer, block.memory);
+		}
+		blockVec.clear();
+		stats = ArenaStats();
+		pRenderer = nullptr;
+	}
+}
+
+GeometryArena::Allocation GeometryArena::Allocate(VkDeviceSize size, VkDeviceSize alignment)
+{
+	Allocation allocation;
+	if (size == 0)
+		return allocation;
+
+	//first fit, blocks are few and big so a linear search is fine
+	for (uint32_t i = 0; i < blockVec.size(); i++)
+	{
+		if (AllocateFromBlock(i, size, alignment, allocation))
+			return allocation;
+	}
+
+	CreateBlock(std::max(size, BLOCK_SIZE));
+	if (!AllocateFromBlock(static_cast<uint32_t>(blockVec.size() - 1), size, alignment, allocation))
+	{
+		throw std::runtime_error("geometry arena : failed to allocate from a new block!");
+	}
+	return allocation;
+}
+
+void GeometryArena::Free(Allocation& allocation)
+{
+	if (allocation.block == UINT32_MAX)
+		return;
+
+	std::map<VkDeviceSize, VkDeviceSize>& freeRangeMap = blockVec[allocation.block].freeRangeMap;
+	VkDeviceSize offset = allocation.offset;
+	VkDeviceSize size = allocation.size;
+
+	//merge with the free range after
+	auto next = freeRangeMap.lower_bound(offset);
+	if (next != freeRangeMap.end() && next->first == offset + size)
+	{
+		size += next->second;
+		next = freeRangeMap.erase(next);
+	}
+
+	//merge with the free range before
+	if (next != freeRangeMap.begin())
+	{
+		auto previous = std::prev(next);
+		if (previous->first + previous->second == offset)
+		{
+			previous->second += size;
+			size = 0;
+		}
+	}
+	if (size != 0)
+	{
+		freeRangeMap.emplace(offset, size);
+	}
+
+	stats.allocationCount--;
+	stats.usedSize -= allocation.size;
+	allocation = Allocation();
+}
+
+const GeometryArena::ArenaStats& GeometryArena::GetArenaStats() const
+{
+	return stats;
+}
+
+bool GeometryArena::AllocateFromBlock(uint32_t blockIndex, VkDeviceSize size, VkDeviceSize alignment, Allocation& allocation)
+{
+	Block& block = blockVec[blockIndex];
+	for (auto it = block.freeRangeMap.begin(); it != block.freeRangeMap.end(); ++it)
+	{
+		VkDeviceSize rangeOffset = it->first;
+		VkDeviceSize rangeEnd = it->first + it->second;
+		VkDeviceSize offset = (rangeOffset + alignment - 1) / alignment * alignment;
+		if (offset + size > rangeEnd)
+			continue;
+
+		//keep what is left on both sides of the allocation
+		block.freeRangeMap.erase(it);
+		if (offset > rangeOffset)
+		{
+			block.freeRangeMap.emplace(rangeOffset, offset - rangeOffset);
+		}
+		if (offset + size < rangeEnd)
+		{
+			block.freeRangeMap.emplace(offset + size, rangeEnd - offset - size);
+		}
+
+		allocation.buffer = block.buffer;
+		allocation.offset = offset;
+		allocation.size = size;
+		allocation.pMapped = block.memory.pMapped != nullptr ? static_cast<uint8_t*>(block.memory.pMapped) + offset : nullptr;
+		allocation.block = blockIndex;
+		stats.allocationCount++;
+		stats.usedSize += size;
+		return true;
+	}
+	return false;
+}
+
+void GeometryArena::CreateBlock(VkDeviceSize size)
+{
+	if (pRenderer == nullptr)
+	{
+		throw std::runtime_error("geometry arena : not initialized!");
+	}
+
+	Block block;
+	block.size = size;
+	pRenderer->CreateBuffer(
+		size,
+		VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_VERTEX_BUFFER_BIT | VK_BUFFER_USAGE_INDEX_BUFFER_BIT,
+		pRenderer->IsUnifiedMemory() ?
+		VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT | VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT :
+		VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
+		block.buffer,
+		block.memory);
+	block.freeRangeMap.emplace(0, size);
+	blockVec.push_back(std::move(block));
+
+	stats.blockCount++;
+	stats.reservedSize += size;
+}
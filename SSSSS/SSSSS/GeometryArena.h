@@ -0,0 +1,63 @@
+#pragma once
+
+#include <map>
+
+#include "GlobalInclude.h"
+#include "DeviceMemoryAllocator.h"
+
+class Renderer;
+
+//vertex and index data of every mesh sub-allocated from a few large device local buffers,
+//so a pass binds geometry once and draws address their mesh with firstIndex and vertexOffset,
+//on unified memory the buffers are host visible as well and meshes write their data in place
+class GeometryArena
+{
+public:
+	struct Allocation
+	{
+		VkBuffer buffer = VK_NULL_HANDLE;
+		VkDeviceSize offset = 0;
+		VkDeviceSize size = 0;
+		void* pMapped = nullptr;//where the cpu writes the range, null unless the memory is unified
+		uint32_t block = UINT32_MAX;//UINT32_MAX when nothing is allocated
+	};
+
+	//instrumentation
+	struct ArenaStats
+	{
+		uint32_t blockCount = 0;
+		uint32_t allocationCount = 0;
+		VkDeviceSize reservedSize = 0;
+		VkDeviceSize usedSize = 0;
+	};
+
+	//allocations larger than a block get a block of their own
+	static const VkDeviceSize BLOCK_SIZE = 64 * 1024 * 1024;
+
+	GeometryArena();
+	~GeometryArena();
+
+	void InitGeometryArena(Renderer* _pRenderer);
+	void CleanUp();
+
+	//alignment does not have to be a power of two, a vertex range aligned to its stride can be addressed with vertexOffset
+	Allocation Allocate(VkDeviceSize size, VkDeviceSize alignment);
+	void Free(Allocation& allocation);
+	const ArenaStats& GetArenaStats() const;
+
+private:
+	struct Block
+	{
+		VkBuffer buffer = VK_NULL_HANDLE;
+		DeviceMemoryAllocator::Allocation memory;
+		VkDeviceSize size = 0;
+		std::map<VkDeviceSize, VkDeviceSize> freeRangeMap;//offset to size, neighbouring free ranges are always merged
+	};
+
+	Renderer* pRenderer;
+	std::vector<Block> blockVec;
+	ArenaStats stats;
+
+	bool AllocateFromBlock(uint32_t blockIndex, VkDeviceSize size, VkDeviceSize alignment, Allocation& allocation);
+	void CreateBlock(VkDeviceSize size);
+};
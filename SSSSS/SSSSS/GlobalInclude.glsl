@@ -87,6 +87,8 @@ layout(set = PASS_SET, binding = UBO_SLOT(PASS, 0)) uniform PassUniformBufferObj
 layout(set = OBJECT_SET, binding = UBO_SLOT(OBJECT, 0)) uniform ObjectUniformBufferObject {
     mat4 model;
 	mat4 modelInvTrans;
+	vec4 positionScale;
+	vec4 positionOffset;
 } objectUBO;
 
 layout(set = FRAME_SET, binding = UBO_SLOT(FRAME, 0)) uniform FrameUniformBufferObject {
@@ -98,6 +100,13 @@ vec2 FlipV(vec2 uv)
 	return vec2(uv.x, 1.0 - uv.y);
 }
 
+//tangent space normals keep x and y only(bc5), z is rebuilt as the positive root of the unit length
+vec3 UnpackNormal(vec2 xy)
+{
+	vec2 normalXY = xy * 2.0 - 1.0;
+	return vec3(normalXY, sqrt(clamp(1.0 - dot(normalXY, normalXY), 0.0, 1.0)));
+}
+
 float ShadowFeeler(mat4 view, mat4 proj, vec3 pos, sampler2D shadowMap)
 {
 	vec4 clip = proj * view * vec4(pos, 1.0);
@@ -256,7 +265,7 @@ float BSSRDF(vec3 xOut, vec3 xIn, vec3 nIn, float eta)
 }
 
 //r = shadow, gba = translucency
-vec4 MultiLevelBSSRDF(vec3 cameraDirWorld, vec3 transmitanceMask, vec3 pos, vec3 normal, vec3 lightPos, vec3 lightCol, float near, float far, mat4 view, mat4 proj, mat4 viewInv, mat4 projInv, sampler2D TSM)
+vec4 MultiLevelBSSRDF(vec3 cameraDirWorld, float transmitanceMask, vec3 pos, vec3 normal, vec3 lightPos, vec3 lightCol, float near, float far, mat4 view, mat4 proj, mat4 viewInv, mat4 projInv, sampler2D TSM)
 {
 	vec3 color = vec3(0);
 	int colorCount = 0;
@@ -487,7 +496,7 @@ vec4 MultiLevelBSSRDF(vec3 cameraDirWorld, vec3 transmitanceMask, vec3 pos, vec3
 }
 
 //r = shadow, gba = translucency
-vec4 ShadowFeelerTSM(vec3 cameraDirWorld, vec3 transmitanceMask, vec3 pos, vec3 normal, vec3 lightPos, vec3 lightCol, float near, float far, mat4 view, mat4 proj, mat4 viewInv, mat4 projInv, sampler2D TSM)
+vec4 ShadowFeelerTSM(vec3 cameraDirWorld, float transmitanceMask, vec3 pos, vec3 normal, vec3 lightPos, vec3 lightCol, float near, float far, mat4 view, mat4 proj, mat4 viewInv, mat4 projInv, sampler2D TSM)
 {
 	return MultiLevelBSSRDF(cameraDirWorld, transmitanceMask, pos, normal, lightPos, lightCol, near, far, view, proj, viewInv, projInv, TSM);
 }
@@ -17,6 +17,11 @@
 const uint32_t MAX_LIGHTS_PER_SCENE = 10;
 enum class BLUR_TYPE { Horizontal, Vertical, Count };
 enum class UNIFORM_SLOT { Scene, Frame, Pass, Object, Count };
+//vertex layout in the vertex buffer, vertex shaders are compiled with a matching VERTEX_FORMAT_* macro
+enum class VERTEX_FORMAT { Standard, Compact, CompactQuantized, Count };
+//vertex inputs a vertex shader reads, with split vertex streams a PositionOnly shader only needs the position stream
+//and a PositionNormal shader the position and normal streams of a mesh
+enum class VERTEX_INPUT { All, PositionOnly, PositionNormal, Count };
 
 struct LightData {
 	glm::mat4 view = glm::mat4(1);
@@ -77,6 +82,9 @@ struct PassUniformBufferObject {
 struct ObjectUniformBufferObject {
 	glm::mat4 model = glm::mat4(1);
 	glm::mat4 modelInvTrans = glm::mat4(1);
+	//quantized positions are decoded as position * positionScale + positionOffset, identity for the other vertex formats
+	glm::vec4 positionScale = glm::vec4(1);
+	glm::vec4 positionOffset = glm::vec4(0);
 };
 
 //stored in renderer (because related to swap chain)
@@ -125,3 +133,89 @@ struct Vertex {
 		return attributeDescriptions;
 	}
 };
+
+//24 bytes, normal and tangent are octahedral encoded, the bitangent sign is stored in tangent[2], texCoord is half float
+struct CompactVertex {
+	float pos[3];
+	uint16_t normal[2];
+	uint8_t tangent[4];
+	uint16_t texCoord[2];
+
+	static VkVertexInputBindingDescription getBindingDescription() {
+		VkVertexInputBindingDescription bindingDescription = {};
+		bindingDescription.binding = 0;
+		bindingDescription.stride = sizeof(CompactVertex);
+		bindingDescription.inputRate = VK_VERTEX_INPUT_RATE_VERTEX;
+
+		return bindingDescription;
+	}
+
+	static std::array<VkVertexInputAttributeDescription, 4> getAttributeDescriptions() {
+		std::array<VkVertexInputAttributeDescription, 4> attributeDescriptions = {};
+
+		attributeDescriptions[0].binding = 0;
+		attributeDescriptions[0].location = 0;
+		attributeDescriptions[0].format = VK_FORMAT_R32G32B32_SFLOAT;
+		attributeDescriptions[0].offset = offsetof(CompactVertex, pos);
+
+		attributeDescriptions[1].binding = 0;
+		attributeDescriptions[1].location = 1;
+		attributeDescriptions[1].format = VK_FORMAT_R16G16_SNORM;
+		attributeDescriptions[1].offset = offsetof(CompactVertex, normal);
+
+		attributeDescriptions[2].binding = 0;
+		attributeDescriptions[2].location = 2;
+		attributeDescriptions[2].format = VK_FORMAT_R8G8B8A8_SNORM;
+		attributeDescriptions[2].offset = offsetof(CompactVertex, tangent);
+
+		attributeDescriptions[3].binding = 0;
+		attributeDescriptions[3].location = 3;
+		attributeDescriptions[3].format = VK_FORMAT_R16G16_SFLOAT;
+		attributeDescriptions[3].offset = offsetof(CompactVertex, texCoord);
+
+		return attributeDescriptions;
+	}
+};
+
+//20 bytes, same as CompactVertex but the position is 16 bit unorm relative to the mesh bounds, see ObjectUniformBufferObject::positionScale
+struct QuantizedVertex {
+	uint16_t pos[4];
+	uint16_t normal[2];
+	uint8_t tangent[4];
+	uint16_t texCoord[2];
+
+	static VkVertexInputBindingDescription getBindingDescription() {
+		VkVertexInputBindingDescription bindingDescription = {};
+		bindingDescription.binding = 0;
+		bindingDescription.stride = sizeof(QuantizedVertex);
+		bindingDescription.inputRate = VK_VERTEX_INPUT_RATE_VERTEX;
+
+		return bindingDescription;
+	}
+
+	static std::array<VkVertexInputAttributeDescription, 4> getAttributeDescriptions() {
+		std::array<VkVertexInputAttributeDescription, 4> attributeDescriptions = {};
+
+		attributeDescriptions[0].binding = 0;
+		attributeDescriptions[0].location = 0;
+		attributeDescriptions[0].format = VK_FORMAT_R16G16B16A16_UNORM;
+		attributeDescriptions[0].offset = offsetof(QuantizedVertex, pos);
+
+		attributeDescriptions[1].binding = 0;
+		attributeDescriptions[1].location = 1;
+		attributeDescriptions[1].format = VK_FORMAT_R16G16_SNORM;
+		attributeDescriptions[1].offset = offsetof(QuantizedVertex, normal);
+
+		attributeDescriptions[2].binding = 0;
+		attributeDescriptions[2].location = 2;
+		attributeDescriptions[2].format = VK_FORMAT_R8G8B8A8_SNORM;
+		attributeDescriptions[2].offset = offsetof(QuantizedVertex, tangent);
+
+		attributeDescriptions[3].binding = 0;
+		attributeDescriptions[3].location = 3;
+		attributeDescriptions[3].format = VK_FORMAT_R16G16_SFLOAT;
+		attributeDescriptions[3].offset = offsetof(QuantizedVertex, texCoord);
+
+		return attributeDescriptions;
+	}
+};
@@ -1,10 +1,79 @@
+//the vertex format is picked by the VERTEX_FORMAT_* macro that the shader is compiled with, see VERTEX_FORMAT in GlobalInclude.h
+//always read the inputs through the GetVertex* functions below
+//VERTEX_INPUT_POSITION_ONLY leaves only the position input, so the pipeline binds nothing but the position stream, see VERTEX_INPUT
+//VERTEX_INPUT_POSITION_NORMAL leaves the position and normal inputs, so the pipeline binds the position and normal streams
+#if defined(VERTEX_FORMAT_COMPACT) || defined(VERTEX_FORMAT_COMPACT_QUANTIZED)
+#ifdef VERTEX_FORMAT_COMPACT_QUANTIZED
+layout(location = 0) in vec4 inPosition;//unorm, relative to the mesh bounds
+#else
 layout(location = 0) in vec3 inPosition;
+#endif
+#ifndef VERTEX_INPUT_POSITION_ONLY
+layout(location = 1) in vec2 inNormal;//octahedral
+#ifndef VERTEX_INPUT_POSITION_NORMAL
+layout(location = 2) in vec4 inTangent;//octahedral in xy, bitangent sign in z
+layout(location = 3) in vec2 inTexCoord;//half float
+#endif
+#endif
+#else
+layout(location = 0) in vec3 inPosition;
+#ifndef VERTEX_INPUT_POSITION_ONLY
 layout(location = 1) in vec3 inNormal;
+#ifndef VERTEX_INPUT_POSITION_NORMAL
 layout(location = 2) in vec4 inTangent;
 layout(location = 3) in vec2 inTexCoord;
+#endif
+#endif
+#endif
 
 layout(location = 0) out vec3 fragPosition;
 layout(location = 1) out vec3 fragGeometryNormal;
 layout(location = 2) out vec3 fragTangent;
 layout(location = 3) out vec3 fragBitangent;
 layout(location = 4) out vec2 fragTexCoord;
+
+//https://knarkowicz.wordpress.com/2014/04/16/octahedron-normal-vector-encoding/
+vec3 OctDecode(vec2 e)
+{
+	vec3 v = vec3(e, 1.0 - abs(e.x) - abs(e.y));
+	float t = max(-v.z, 0.0);
+	v.xy += vec2(v.x >= 0.0 ? -t : t, v.y >= 0.0 ? -t : t);
+	return normalize(v);
+}
+
+vec3 GetVertexPosition()
+{
+#if defined(VERTEX_FORMAT_COMPACT_QUANTIZED)
+	return inPosition.xyz * objectUBO.positionScale.xyz + objectUBO.positionOffset.xyz;
+#else
+	return inPosition;
+#endif
+}
+
+#ifndef VERTEX_INPUT_POSITION_ONLY
+vec3 GetVertexNormal()
+{
+#if defined(VERTEX_FORMAT_COMPACT) || defined(VERTEX_FORMAT_COMPACT_QUANTIZED)
+	return OctDecode(inNormal);
+#else
+	return inNormal;
+#endif
+}
+
+#ifndef VERTEX_INPUT_POSITION_NORMAL
+//w is the bitangent sign
+vec4 GetVertexTangent()
+{
+#if defined(VERTEX_FORMAT_COMPACT) || defined(VERTEX_FORMAT_COMPACT_QUANTIZED)
+	return vec4(OctDecode(inTangent.xy), inTangent.z < 0.0 ? -1.0 : 1.0);
+#else
+	return inTangent;
+#endif
+}
+
+vec2 GetVertexTexCoord()
+{
+	return inTexCoord;
+}
+#endif
+#endif
@@ -0,0 +1,116 @@
+#include "Hash.h"
+
+#include <cstring>
+
+static const uint64_t PRIME1 = 11400714785074694791ULL;
+static const uint64_t PRIME2 = 14029467366897019727ULL;
+static const uint64_t PRIME3 = 1609587929392839161ULL;
+static const uint64_t PRIME4 = 9650029242287828579ULL;
+static const uint64_t PRIME5 = 2870177450012600261ULL;
+
+static inline uint64_t RotateLeft(uint64_t x, int r)
+{
+	return (x << r) | (x >> (64 - r));
+}
+
+static inline uint64_t Read64(const unsigned char* p)
+{
+	uint64_t value;
+	memcpy(&value, p, sizeof(value));
+	return value;
+}
+
+static inline uint32_t Read32(const unsigned char* p)
+{
+	uint32_t value;
+	memcpy(&value, p, sizeof(value));
+	return value;
+}
+
+static inline uint64_t Round(uint64_t acc, uint64_t input)
+{
+	acc += input * PRIME2;
+	acc = RotateLeft(acc, 31);
+	return acc * PRIME1;
+}
+
+static inline uint64_t MergeRound(uint64_t acc, uint64_t value)
+{
+	acc ^= Round(0, value);
+	return acc * PRIME1 + PRIME4;
+}
+
+uint64_t Hash64(const void* data, size_t size, uint64_t seed)
+{
+	const unsigned char* p = static_cast<const unsigned char*>(data);
+	const unsigned char* end = p + size;
+	uint64_t h;
+
+	if (size >= 32)
+	{
+		//4 independent lanes so the multiplies can overlap
+		uint64_t v1 = seed + PRIME1 + PRIME2;
+		uint64_t v2 = seed + PRIME2;
+		uint64_t v3 = seed;
+		uint64_t v4 = seed - PRIME1;
+		const unsigned char* limit = end - 32;
+		do
+		{
+			v1 = Round(v1, Read64(p));
+			v2 = Round(v2, Read64(p + 8));
+			v3 = Round(v3, Read64(p + 16));
+			v4 = Round(v4, Read64(p + 24));
+			p += 32;
+		} while (p <= limit);
+
+		h = RotateLeft(v1, 1) + RotateLeft(v2, 7) + RotateLeft(v3, 12) + RotateLeft(v4, 18);
+		h = MergeRound(h, v1);
+		h = MergeRound(h, v2);
+		h = MergeRound(h, v3);
+		h = MergeRound(h, v4);
+	}
+	else
+	{
+		h = seed + PRIME5;
+	}
+
+	h += static_cast<uint64_t>(size);
+
+	while (p + 8 <= end)
+	{
+		h ^= Round(0, Read64(p));
+		h = RotateLeft(h, 27) * PRIME1 + PRIME4;
+		p += 8;
+	}
+	if (p + 4 <= end)
+	{
+		h ^= static_cast<uint64_t>(Read32(p)) * PRIME1;
+		h = RotateLeft(h, 23) * PRIME2 + PRIME3;
+		p += 4;
+	}
+	while (p < end)
+	{
+		h ^= (*p) * PRIME5;
+		h = RotateLeft(h, 11) * PRIME1;
+		p++;
+	}
+
+	h ^= h >> 33;
+	h *= PRIME2;
+	h ^= h >> 29;
+	h *= PRIME3;
+	h ^= h >> 32;
+	return h;
+}
+
+std::string HashToString(uint64_t hash)
+{
+	static const char digits[] = "0123456789abcdef";
+	std::string str(16, '0');
+	for (int i = 15; i >= 0; i--)
+	{
+		str[i] = digits[hash & 0xF];
+		hash >>= 4;
+	}
+	return str;
+}
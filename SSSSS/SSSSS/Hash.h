@@ -0,0 +1,11 @@
+#pragma once
+
+#include <cstdint>
+#include <cstddef>
+#include <string>
+
+//64 bit non-cryptographic hash of a byte range(xxHash64 construction), used to key on-disk caches by content
+uint64_t Hash64(const void* data, size_t size, uint64_t seed = 0);
+
+//16 hex digits, for cache file names
+std::string HashToString(uint64_t hash);
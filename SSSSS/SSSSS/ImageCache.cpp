@@ -0,0 +1,97 @@
+#include "ImageCache.h"
+
+#include "Renderer.h"
+
+ImageCache::ImageCache() :
+	pRenderer(nullptr)
+{
+}
+
+ImageCache::~ImageCache()
+{
+	CleanUp();
+}
+
+void ImageCache::InitImageCache(Renderer* _pRenderer)
+{
+	if (_pRenderer == nullptr)
+	{
+		throw std::runtime_error("image cache : pRenderer is null!");
+	}
+
+	pRenderer = _pRenderer;
+}
+
+void ImageCache::CleanUp()
+{
+	if (pRenderer != nullptr)
+	{
+		for (auto& keyEntry : entryMap)
+		{
+			Destroy(keyEntry.second);
+		}
+		entryMap.clear();
+		stats = ImageCacheStats();
+		pRenderer = nullptr;
+	}
+}
+
+bool ImageCache::Contains(const std::string& key) const
+{
+	return entryMap.find(key) != entryMap.end();
+}
+
+bool ImageCache::Acquire(const std::string& key, Image& image)
+{
+	auto it = entryMap.find(key);
+	if (it == entryMap.end())
+		return false;
+
+	it->second.referenceCount++;
+	stats.referenceCount++;
+	image = it->second.image;
+	return true;
+}
+
+void ImageCache::Add(const std::string& key, const Image& image)
+{
+	if (pRenderer == nullptr)
+	{
+		throw std::runtime_error("image cache : not initialized!");
+	}
+	if (!entryMap.emplace(key, Entry{ image, 1 }).second)
+	{
+		throw std::runtime_error("image cache : " + key + " is already shared!");
+	}
+
+	stats.imageCount++;
+	stats.referenceCount++;
+	stats.imageSize += image.allocation.size;
+}
+
+void ImageCache::Release(const std::string& key)
+{
+	auto it = entryMap.find(key);
+	if (pRenderer == nullptr || it == entryMap.end())
+		return;
+
+	stats.referenceCount--;
+	if (--it->second.referenceCount == 0)
+	{
+		stats.imageCount--;
+		stats.imageSize -= it->second.image.allocation.size;
+		Destroy(it->second);
+		entryMap.erase(it);
+	}
+}
+
+const ImageCache::ImageCacheStats& ImageCache::GetImageCacheStats() const
+{
+	return stats;
+}
+
+void ImageCache::Destroy(Entry& entry)
+{
+	vkDestroyImageView(pRenderer->GetDevice(), entry.image.imageView, nullptr);
+	pRenderer->DestroyImage(entry.image.image, entry.image.allocation);
+}
@@ -0,0 +1,63 @@
+#pragma once
+
+#include <unordered_map>
+
+#include "GlobalInclude.h"
+#include "DeviceMemoryAllocator.h"
+#include "UploadManager.h"
+
+class Renderer;
+
+//gpu images of texture files shared by every texture that loads the same file with the same settings,
+//the first texture loads the image and hands it over, the image lives until the last texture releases it,
+//not to be confused with the texture cache, which keeps cooked mip chains on disk
+class ImageCache
+{
+public:
+	struct Image
+	{
+		VkImage image = VK_NULL_HANDLE;
+		DeviceMemoryAllocator::Allocation allocation;
+		VkImageView imageView = VK_NULL_HANDLE;
+		VkFormat format = VK_FORMAT_UNDEFINED;
+		int width = 0;
+		int height = 0;
+		uint32_t mipLevels = 1;
+		UploadTicket uploadTicket;
+	};
+
+	//instrumentation
+	struct ImageCacheStats
+	{
+		uint32_t imageCount = 0;
+		uint32_t referenceCount = 0;
+		VkDeviceSize imageSize = 0;
+	};
+
+	ImageCache();
+	~ImageCache();
+
+	void InitImageCache(Renderer* _pRenderer);
+	void CleanUp();
+
+	bool Contains(const std::string& key) const;
+	//false when no texture holds the key, otherwise the image is shared with one more reference
+	bool Acquire(const std::string& key, Image& image);
+	//the cache owns the image from now on, with one reference for the texture that loaded it
+	void Add(const std::string& key, const Image& image);
+	void Release(const std::string& key);
+	const ImageCacheStats& GetImageCacheStats() const;
+
+private:
+	struct Entry
+	{
+		Image image;
+		uint32_t referenceCount;
+	};
+
+	Renderer* pRenderer;
+	std::unordered_map<std::string, Entry> entryMap;
+	ImageCacheStats stats;
+
+	void Destroy(Entry& entry);
+};
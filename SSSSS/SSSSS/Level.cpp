@@ -81,11 +81,9 @@ void Level::InitLevel(
 	for (auto pCamera : pCameraVec)
 		pCamera->InitCamera();
 
-	for (auto pShader : pShaderVec)
-		pShader->InitShader(pRenderer);
+	Shader::InitShaders(pRenderer, pShaderVec);
 
-	for (auto pTexture : pTextureVec)
-		pTexture->InitTexture(pRenderer);
+	Texture::InitTextures(pRenderer, pTextureVec);
 
 	for (auto pMesh : pMeshVec)
 		pMesh->InitMesh(pRenderer, descriptorPool);
@@ -1,13 +1,25 @@
 #include "Mesh.h"
 
-#include <fstream>
-#include <sstream>
+#include <charconv>
+#include <algorithm>
+#include <cstdlib>
+#include <cstring>
+#include <limits>
+#include <cmath>
+#include <filesystem>
+#include <glm/gtc/packing.hpp>
+
+#include "MappedFile.h"
+#include "ThreadPool.h"
+#include "MeshOptimizer.h"
+#include "MeshSimplifier.h"
+#include "Hash.h"
 
 #include "Texture.h"
 #include "Renderer.h"
 
 Mesh::Mesh(const std::string& _name, MeshType _type, const glm::vec3& _position, const glm::vec3& _rotation, const glm::vec3& _scale) :
-	pRenderer(nullptr), name(_name), type(_type), position(_position), rotation(_rotation), scale(_scale)
+	position(_position), scale(_scale), rotation(_rotation), pRenderer(nullptr), name(_name), type(_type), indexMode(IndexMode::Welded), optimize(true), useMeshCache(true), vertexFormat(VERTEX_FORMAT::Standard), splitVertexStreams(false), allow16BitIndices(true), lodCount(1), buildClusters(false), indexCount(0), indexType(VK_INDEX_TYPE_UINT32), boundsMin(0), boundsMax(0), normalStreamOffset(0), attributeStreamOffset(0)
 {
 	oUBO.model = glm::mat4(1);
 }
@@ -29,12 +41,27 @@ VkBuffer Mesh::GetObjectUniformBuffer() const
 
 VkBuffer Mesh::GetVertexBuffer() const
 {
-	return vertexBuffer;
+	return vertexAllocation.buffer;
 }
 
 VkBuffer Mesh::GetIndexBuffer() const
 {
-	return indexBuffer;
+	return indexAllocation.buffer;
+}
+
+VkDeviceSize Mesh::GetVertexBufferOffset() const
+{
+	return splitVertexStreams ? vertexAllocation.offset : 0;
+}
+
+int32_t Mesh::GetBaseVertex() const
+{
+	return splitVertexStreams ? 0 : static_cast<int32_t>(vertexAllocation.offset / GetVertexStride());
+}
+
+uint32_t Mesh::GetFirstIndex() const
+{
+	return static_cast<uint32_t>(indexAllocation.offset / (indexType == VK_INDEX_TYPE_UINT16 ? sizeof(uint16_t) : sizeof(uint32_t)));
 }
 
 VkDescriptorSet* Mesh::GetObjectDescriptorSetPtr(int frame)
@@ -42,14 +69,71 @@ VkDescriptorSet* Mesh::GetObjectDescriptorSetPtr(int frame)
 	return objectDescriptorSetVec.data() + frame;
 }
 
+void Mesh::UpdateTextureBindings(int frame)
+{
+	for (size_t j = 0; j < pTextureVec.size(); j++)
+	{
+		VkImageView imageView = pTextureVec[j]->GetTextureImageView();
+		if (boundImageViewVec[frame][j] == imageView)
+			continue;
+
+		pRenderer->BindTextureToDescriptorSets(imageView, pTextureVec[j]->GetSampler(), { objectDescriptorSetVec[frame] }, oUboCount + static_cast<uint32_t>(j));
+		boundImageViewVec[frame][j] = imageView;
+	}
+}
+
 int Mesh::GetObjectDescriptorSetCount() const
 {
 	return objectDescriptorSetVec.size();
 }
 
-const std::vector<uint32_t>& Mesh::GetIndexVec() const
+uint32_t Mesh::GetIndexCount() const
+{
+	return indexCount;
+}
+
+VkIndexType Mesh::GetIndexType() const
+{
+	return indexType;
+}
+
+const std::vector<Mesh::SubMesh>& Mesh::GetSubMeshVec(uint32_t lod) const
+{
+	return lodSubMeshVec[lod];
+}
+
+uint32_t Mesh::GetLodCount() const
+{
+	return static_cast<uint32_t>(lodVec.size());
+}
+
+const Mesh::Lod& Mesh::GetLod(uint32_t lod) const
 {
-	return indices;
+	return lodVec[lod];
+}
+
+const std::vector<MeshClusterizer::Cluster>& Mesh::GetClusterVec() const
+{
+	return clusterVec;
+}
+
+glm::mat4 Mesh::GetModelMatrix() const
+{
+	return glm::translate(glm::mat4(1.0f), position) *
+		glm::rotate(glm::mat4(1.0f), glm::radians(rotation.z), glm::vec3(0, 0, 1)) *
+		glm::rotate(glm::mat4(1.0f), glm::radians(rotation.y), glm::vec3(0, 1, 0)) *
+		glm::rotate(glm::mat4(1.0f), glm::radians(rotation.x), glm::vec3(1, 0, 0)) *
+		glm::scale(glm::mat4(1.0f), scale);
+}
+
+glm::vec3 Mesh::GetBoundsMin() const
+{
+	return boundsMin;
+}
+
+glm::vec3 Mesh::GetBoundsMax() const
+{
+	return boundsMax;
 }
 
 uint32_t Mesh::GetTextureCount() const
@@ -57,6 +141,19 @@ uint32_t Mesh::GetTextureCount() const
 	return static_cast<uint32_t>(pTextureVec.size());
 }
 
+bool Mesh::IsUploadComplete() const
+{
+	if (pRenderer == nullptr || !pRenderer->IsUploadComplete(uploadTicket))
+		return false;
+
+	for (const Texture* pTexture : pTextureVec)
+	{
+		if (!pTexture->IsUploadComplete())
+			return false;
+	}
+	return true;
+}
+
 uint32_t Mesh::GetUboCount() const
 {
 	return oUboCount;
@@ -88,9 +185,17 @@ void Mesh::InitMesh(Renderer* _pRenderer, VkDescriptorPool descriptorPool)
 		InitFromFile(name);
 	}
 
-	//create vertex resources
+	//meshes from files are built(or mapped from the mesh cache) by InitFromFile
+	if (type != MeshType::File)
+	{
+		BuildMesh();
+	}
+
+	//create vertex resources, a cached mesh is copied straight from the mapped cache file into the staging buffers
 	CreateVertexBuffer();
 	CreateIndexBuffer();
+	uploadTicket = pRenderer->FlushUploads();
+	meshCache.Close();
 
 	//create uniform resources
 	CreateObjectUniformBuffer(_pRenderer->frameCount);
@@ -107,6 +212,7 @@ void Mesh::InitMesh(Renderer* _pRenderer, VkDescriptorPool descriptorPool)
 		objectDescriptorSetLayout);
 
 	VkDeviceSize uboSize = sizeof(oUBO);
+	boundImageViewVec.assign(objectDescriptorSetVec.size(), std::vector<VkImageView>(pTextureVec.size()));
 	for (int i = 0; i < objectDescriptorSetVec.size(); i++)
 	{
 		//bind ubo
@@ -117,17 +223,14 @@ void Mesh::InitMesh(Renderer* _pRenderer, VkDescriptorPool descriptorPool)
 		for (int j = 0; j < pTextureVec.size(); j++)
 		{
 			pRenderer->BindTextureToDescriptorSets(pTextureVec[j]->GetTextureImageView(), pTextureVec[j]->GetSampler(), { objectDescriptorSetVec[i] }, oUboCount + j);//only 1 oUBO, so binding offset is 1
+			boundImageViewVec[i][j] = pTextureVec[j]->GetTextureImageView();
 		}
 	}
 }
 
 void Mesh::UpdateObjectUniformBuffer(int frame)
 {
-	oUBO.model = glm::translate(glm::mat4(1.0f), position) *
-		glm::rotate(glm::mat4(1.0f), glm::radians(rotation.z), glm::vec3(0, 0, 1)) *
-		glm::rotate(glm::mat4(1.0f), glm::radians(rotation.y), glm::vec3(0, 1, 0)) *
-		glm::rotate(glm::mat4(1.0f), glm::radians(rotation.x), glm::vec3(1, 0, 0)) *
-		glm::scale(glm::mat4(1.0f), scale);
+	oUBO.model = GetModelMatrix();
 
 	oUBO.modelInvTrans = glm::transpose(
 		glm::scale(glm::mat4(1.0f), 1.f/scale) *
@@ -136,12 +239,116 @@ void Mesh::UpdateObjectUniformBuffer(int frame)
 		glm::rotate(glm::mat4(1.0f), glm::radians(-rotation.z), glm::vec3(0, 0, 1)) *
 		glm::translate(glm::mat4(1.0f), -position));
 
+	if (vertexFormat == VERTEX_FORMAT::CompactQuantized)
+	{
+		oUBO.positionScale = glm::vec4(boundsMax - boundsMin, 0.0f);
+		oUBO.positionOffset = glm::vec4(boundsMin, 0.0f);
+	}
+	else
+	{
+		oUBO.positionScale = glm::vec4(1.0f);
+		oUBO.positionOffset = glm::vec4(0.0f);
+	}
+
 	void* data;
 	VkDeviceSize size = sizeof(oUBO);
 	VkDeviceSize offset = pRenderer->GetAlignedUboOffset(size, frame);
-	vkMapMemory(pRenderer->GetDevice(), objectUniformBufferMemory, offset, size, 0, &data);
+	data = static_cast<uint8_t*>(objectUniformBufferAllocation.pMapped) + offset;
 	memcpy(data, &oUBO, sizeof(oUBO));
-	vkUnmapMemory(pRenderer->GetDevice(), objectUniformBufferMemory);
+}
+
+void Mesh::SetIndexMode(IndexMode _indexMode)
+{
+	indexMode = _indexMode;
+}
+
+void Mesh::SetOptimize(bool _optimize)
+{
+	optimize = _optimize;
+}
+
+void Mesh::SetUseMeshCache(bool _useMeshCache)
+{
+	useMeshCache = _useMeshCache;
+}
+
+void Mesh::SetAllow16BitIndices(bool _allow16BitIndices)
+{
+	allow16BitIndices = _allow16BitIndices;
+}
+
+void Mesh::SetLodCount(uint32_t _lodCount)
+{
+	lodCount = std::max(_lodCount, 1u);
+}
+
+void Mesh::SetBuildClusters(bool _buildClusters)
+{
+	buildClusters = _buildClusters;
+}
+
+void Mesh::SetVertexFormat(VERTEX_FORMAT _vertexFormat)
+{
+	vertexFormat = _vertexFormat;
+}
+
+VERTEX_FORMAT Mesh::GetVertexFormat() const
+{
+	return vertexFormat;
+}
+
+uint32_t Mesh::GetVertexStride() const
+{
+	if (vertexFormat == VERTEX_FORMAT::Compact)
+		return sizeof(CompactVertex);
+	else if (vertexFormat == VERTEX_FORMAT::CompactQuantized)
+		return sizeof(QuantizedVertex);
+	return sizeof(Vertex);
+}
+
+void Mesh::SetSplitVertexStreams(bool _splitVertexStreams)
+{
+	splitVertexStreams = _splitVertexStreams;
+}
+
+bool Mesh::IsVertexStreamSplit() const
+{
+	return splitVertexStreams;
+}
+
+//the position is the first member of every vertex format
+uint32_t Mesh::GetPositionStride() const
+{
+	if (vertexFormat == VERTEX_FORMAT::Compact)
+		return sizeof(CompactVertex::pos);
+	else if (vertexFormat == VERTEX_FORMAT::CompactQuantized)
+		return sizeof(QuantizedVertex::pos);
+	return sizeof(Vertex::pos);
+}
+
+//the normal follows the position in every vertex format
+uint32_t Mesh::GetNormalStride() const
+{
+	if (vertexFormat == VERTEX_FORMAT::Compact)
+		return sizeof(CompactVertex::normal);
+	else if (vertexFormat == VERTEX_FORMAT::CompactQuantized)
+		return sizeof(QuantizedVertex::normal);
+	return sizeof(Vertex::normal);
+}
+
+VkDeviceSize Mesh::GetNormalStreamOffset() const
+{
+	return normalStreamOffset;
+}
+
+VkDeviceSize Mesh::GetAttributeStreamOffset() const
+{
+	return attributeStreamOffset;
+}
+
+const Mesh::MeshStats& Mesh::GetMeshStats() const
+{
+	return stats;
 }
 
 void Mesh::CreateObjectUniformBuffer(int frameCount)
@@ -152,7 +359,7 @@ void Mesh::CreateObjectUniformBuffer(int frameCount)
 		VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT,
 		VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
 		objectUniformBuffer,
-		objectUniformBufferMemory);
+		objectUniformBufferAllocation);
 
 	//initial update
 	for (int i = 0; i < frameCount; i++)
@@ -162,43 +369,134 @@ void Mesh::CreateObjectUniformBuffer(int frameCount)
 }
 
 void Mesh::CreateVertexBuffer() {
-	VkDeviceSize bufferSize = sizeof(vertices[0]) * vertices.size();
-
-	VkBuffer stagingBuffer;
-	VkDeviceMemory stagingBufferMemory;
-	pRenderer->CreateBuffer(bufferSize, VK_BUFFER_USAGE_TRANSFER_SRC_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, stagingBuffer, stagingBufferMemory);
-
-	void* data;
-	vkMapMemory(pRenderer->GetDevice(), stagingBufferMemory, 0, bufferSize, 0, &data);
-	memcpy(data, vertices.data(), (size_t)bufferSize);
-	vkUnmapMemory(pRenderer->GetDevice(), stagingBufferMemory);
+	//the mesh and the mesh cache always hold standard vertices, other formats are encoded straight into the staging buffer
+	const Vertex* vertexData = vertices.data();
+	uint32_t vertexCount = static_cast<uint32_t>(vertices.size());
+	if (meshCache.IsOpen())
+	{
+		uint64_t sectionSize = 0;
+		vertexData = static_cast<const Vertex*>(meshCache.GetSection(MeshCache::SectionType::Vertices, sectionSize));
+		vertexCount = meshCache.GetHeader().vertexCount;
+	}
+	VkDeviceSize bufferSize = static_cast<VkDeviceSize>(GetVertexStride()) * vertexCount;
+	normalStreamOffset = 0;
+	attributeStreamOffset = 0;
+	if (splitVertexStreams)
+	{
+		normalStreamOffset = AlignVertexStream(static_cast<VkDeviceSize>(GetPositionStride()) * vertexCount);
+		attributeStreamOffset = AlignVertexStream(normalStreamOffset + static_cast<VkDeviceSize>(GetNormalStride()) * vertexCount);
+		bufferSize = attributeStreamOffset + static_cast<VkDeviceSize>(GetVertexStride() - GetPositionStride() - GetNormalStride()) * vertexCount;
+	}
+	stats.vertexBufferSize = bufferSize;
 
-	pRenderer->CreateBuffer(bufferSize, VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_VERTEX_BUFFER_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, vertexBuffer, vertexBufferMemory);
+	//interleaved vertices are aligned to the stride so draws reach them through vertexOffset with the arena bound at 0,
+	//split streams have three bases that one vertexOffset can not address, so they are bound at their own offsets
+	vertexAllocation = pRenderer->GetGeometryArena()->Allocate(bufferSize, splitVertexStreams ? VERTEX_STREAM_ALIGNMENT : GetVertexStride());
 
-	pRenderer->CopyBuffer(pRenderer->defaultCommandPool, stagingBuffer, vertexBuffer, bufferSize);
+	//on unified memory the vertices are encoded straight into the arena, otherwise into staging memory that is copied there
+	StagingRing::Region staging;
+	void* data = vertexAllocation.pMapped;
+	if (data == nullptr)
+	{
+		staging = pRenderer->AllocateStaging(bufferSize);
+		data = staging.pData;
+	}
+	if (splitVertexStreams)
+	{
+		std::vector<uint8_t> interleaved(static_cast<size_t>(GetVertexStride()) * vertexCount);
+		EncodeVertices(vertexData, vertexCount, interleaved.data());
+		SplitVertexStreams(interleaved.data(), vertexCount, data);
+	}
+	else
+	{
+		EncodeVertices(vertexData, vertexCount, data);
+	}
 
-	vkDestroyBuffer(pRenderer->GetDevice(), stagingBuffer, nullptr);
-	vkFreeMemory(pRenderer->GetDevice(), stagingBufferMemory, nullptr);
+	if (vertexAllocation.pMapped != nullptr)
+	{
+		pRenderer->CountDirectWrite(bufferSize);
+		return;
+	}
+	pRenderer->UploadBuffer(staging, vertexAllocation.buffer, vertexAllocation.offset, bufferSize);
 }
 
 void Mesh::CreateIndexBuffer() {
-	VkDeviceSize bufferSize = sizeof(indices[0]) * indices.size();
-
-	VkBuffer stagingBuffer;
-	VkDeviceMemory stagingBufferMemory;
-	pRenderer->CreateBuffer(bufferSize, VK_BUFFER_USAGE_TRANSFER_SRC_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, stagingBuffer, stagingBufferMemory);
+	//the mesh and the mesh cache always hold 32 bit indices, they are narrowed while filling the staging buffer
+	const uint32_t* indexData = indices.data();
+	if (meshCache.IsOpen())
+	{
+		uint64_t sectionSize = 0;
+		indexData = static_cast<const uint32_t*>(meshCache.GetSection(MeshCache::SectionType::Indices, sectionSize));
+	}
 
-	void* data;
-	vkMapMemory(pRenderer->GetDevice(), stagingBufferMemory, 0, bufferSize, 0, &data);
-	memcpy(data, indices.data(), (size_t)bufferSize);
-	vkUnmapMemory(pRenderer->GetDevice(), stagingBufferMemory);
+	//one index buffer is bound for all lods, so either every lod fits 16 bit indices or none uses them
+	indexType = VK_INDEX_TYPE_UINT32;
+	lodSubMeshVec.resize(lodVec.size());
+	for (size_t i = 0; i < lodVec.size(); i++)
+	{
+		lodSubMeshVec[i] = { { lodVec[i].firstIndex, lodVec[i].indexCount, 0 } };
+	}
+	if (allow16BitIndices)
+	{
+		std::vector<std::vector<SubMesh>> splitVec(lodVec.size());
+		bool fits = true;
+		for (size_t i = 0; i < lodVec.size() && fits; i++)
+		{
+			fits = MeshOptimizer::SplitIndexRanges(indexData + lodVec[i].firstIndex, lodVec[i].indexCount, MAX_16BIT_INDEX, MAX_SUB_MESH_COUNT, splitVec[i]);
+			for (SubMesh& subMesh : splitVec[i])
+			{
+				subMesh.firstIndex += lodVec[i].firstIndex;
+			}
+		}
+		if (fits)
+		{
+			lodSubMeshVec = std::move(splitVec);
+			indexType = VK_INDEX_TYPE_UINT16;
+		}
+	}
+	VkDeviceSize bufferSize = (indexType == VK_INDEX_TYPE_UINT16 ? sizeof(uint16_t) : sizeof(uint32_t)) * static_cast<VkDeviceSize>(indexCount);
+	stats.indexBufferSize = bufferSize;
+	stats.subMeshCount = static_cast<uint32_t>(lodSubMeshVec[0].size());
 
-	pRenderer->CreateBuffer(bufferSize, VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_INDEX_BUFFER_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, indexBuffer, indexBufferMemory);
+	//aligned to 4 bytes so the range is addressable through firstIndex with either index type
+	indexAllocation = pRenderer->GetGeometryArena()->Allocate(bufferSize, sizeof(uint32_t));
 
-	pRenderer->CopyBuffer(pRenderer->defaultCommandPool, stagingBuffer, indexBuffer, bufferSize);
+	//narrowed straight into the arena on unified memory
+	StagingRing::Region staging;
+	void* data = indexAllocation.pMapped;
+	if (data == nullptr)
+	{
+		staging = pRenderer->AllocateStaging(bufferSize);
+		data = staging.pData;
+	}
+	if (indexType == VK_INDEX_TYPE_UINT16)
+	{
+		uint16_t* result = static_cast<uint16_t*>(data);
+		for (const std::vector<SubMesh>& subMeshVec : lodSubMeshVec)
+		{
+			for (const SubMesh& subMesh : subMeshVec)
+			{
+				pRenderer->GetThreadPool()->ParallelFor(subMesh.indexCount, INDEX_CONVERT_GRAIN_SIZE, [&](uint32_t begin, uint32_t end)
+				{
+					for (uint32_t i = subMesh.firstIndex + begin; i < subMesh.firstIndex + end; i++)
+					{
+						result[i] = static_cast<uint16_t>(indexData[i] - static_cast<uint32_t>(subMesh.vertexOffset));
+					}
+				});
+			}
+		}
+	}
+	else
+	{
+		memcpy(data, indexData, (size_t)bufferSize);
+	}
 
-	vkDestroyBuffer(pRenderer->GetDevice(), stagingBuffer, nullptr);
-	vkFreeMemory(pRenderer->GetDevice(), stagingBufferMemory, nullptr);
+	if (indexAllocation.pMapped != nullptr)
+	{
+		pRenderer->CountDirectWrite(bufferSize);
+		return;
+	}
+	pRenderer->UploadBuffer(staging, indexAllocation.buffer, indexAllocation.offset, bufferSize);
 }
 
 void Mesh::CleanUp()
@@ -207,14 +505,10 @@ void Mesh::CleanUp()
 	{
 		vkDestroyDescriptorSetLayout(pRenderer->GetDevice(), objectDescriptorSetLayout, nullptr);
 
-		vkDestroyBuffer(pRenderer->GetDevice(), objectUniformBuffer, nullptr);
-		vkFreeMemory(pRenderer->GetDevice(), objectUniformBufferMemory, nullptr);
-
-		vkDestroyBuffer(pRenderer->GetDevice(), indexBuffer, nullptr);
-		vkFreeMemory(pRenderer->GetDevice(), indexBufferMemory, nullptr);
+		pRenderer->DestroyBuffer(objectUniformBuffer, objectUniformBufferAllocation);
 
-		vkDestroyBuffer(pRenderer->GetDevice(), vertexBuffer, nullptr);
-		vkFreeMemory(pRenderer->GetDevice(), vertexBufferMemory, nullptr);
+		pRenderer->GetGeometryArena()->Free(indexAllocation);
+		pRenderer->GetGeometryArena()->Free(vertexAllocation);
 
 		pRenderer = nullptr;
 	}
@@ -249,218 +543,784 @@ void Mesh::InitFullScreenQuad()
 	};
 }
 
-//adjacent triangles do not share vertices(vertices are unique)
-void Mesh::InitFromFile(const std::string& fileName)
+//triangle order for the post-transform cache, then cluster order for overdraw, then vertex order for fetch
+void Mesh::OptimizeMesh()
 {
-	LoadObjMesh(fileName);
+	uint32_t vertexCount = static_cast<uint32_t>(vertices.size());
+	MeshOptimizer::VertexCacheStats before = MeshOptimizer::AnalyzeVertexCache(indices, vertexCount);
+
+	std::vector<uint32_t> clusterVec;
+	MeshOptimizer::OptimizeVertexCache(indices, vertexCount, clusterVec);
+	MeshOptimizer::OptimizeOverdraw(indices, vertices, clusterVec);
+	MeshOptimizer::OptimizeVertexFetch(indices, vertices);
+
+	MeshOptimizer::VertexCacheStats after = MeshOptimizer::AnalyzeVertexCache(indices, static_cast<uint32_t>(vertices.size()));
+	stats.acmrBefore = before.acmr;
+	stats.atvrBefore = before.atvr;
+	stats.acmrAfter = after.acmr;
+	stats.atvrAfter = after.atvr;
 }
 
-void Mesh::LoadObjMesh(const std::string& fileName)
+//https://knarkowicz.wordpress.com/2014/04/16/octahedron-normal-vector-encoding/
+static inline glm::vec2 OctEncode(const glm::vec3& v)
 {
-	std::fstream file;
-	file.open(fileName, std::ios::in);
-	if (file.is_open())
+	float sum = glm::abs(v.x) + glm::abs(v.y) + glm::abs(v.z);
+	if (sum == 0.0f)
+		return glm::vec2(0.0f);
+
+	glm::vec2 e = glm::vec2(v) / sum;
+	if (v.z < 0.0f)
 	{
-		std::vector<glm::vec3> vecPos;
-		std::vector<glm::vec3> vecNor;
-		std::vector<glm::vec2> vecUV;
-		std::vector<Point> vecPoint;
+		e = (1.0f - glm::abs(glm::vec2(e.y, e.x))) * glm::vec2(e.x >= 0.0f ? 1.0f : -1.0f, e.y >= 0.0f ? 1.0f : -1.0f);
+	}
+	return e;
+}
 
-		std::string str;
-		while (std::getline(file, str))
-		{
-			if (str.substr(0, 2) == "v ")
-			{
-				std::stringstream ss;
-				ss << str.substr(2);
-				glm::vec3 v;
-				ss >> v.x;
-				ss >> v.y;
-				ss >> v.z;
-				vecPos.push_back(v);
-			}
-			else if (str.substr(0, 3) == "vt ")
-			{
-				std::stringstream ss;
-				ss << str.substr(3);
-				glm::vec2 v;
-				ss >> v.x;
-				ss >> v.y;
-				vecUV.push_back(v);
-			}
-			else if (str.substr(0, 3) == "vn ")
-			{
-				std::stringstream ss;
-				ss << str.substr(3);
-				glm::vec3 v;
-				ss >> v.x;
-				ss >> v.y;
-				ss >> v.z;
-				vecNor.push_back(v);
-			}
-			else if (str.substr(0, 2) == "f ")
-			{
-				std::stringstream ss;
-				std::vector<Point> tempVecPoint;
-				ss << str.substr(2);
+//decoded by GetVertexNormal and GetVertexTangent in GlobalIncludeVert.glsl
+template<typename T>
+static inline void EncodeCompactAttributes(const Vertex& vertex, T& result)
+{
+	glm::vec2 normal = OctEncode(vertex.normal);
+	glm::vec2 tangent = OctEncode(glm::vec3(vertex.tangent));
+	result.normal[0] = glm::packSnorm1x16(normal.x);
+	result.normal[1] = glm::packSnorm1x16(normal.y);
+	result.tangent[0] = glm::packSnorm1x8(tangent.x);
+	result.tangent[1] = glm::packSnorm1x8(tangent.y);
+	result.tangent[2] = glm::packSnorm1x8(vertex.tangent.w < 0.0f ? -1.0f : 1.0f);
+	result.tangent[3] = 0;
+	result.texCoord[0] = glm::packHalf1x16(vertex.texCoord.x);
+	result.texCoord[1] = glm::packHalf1x16(vertex.texCoord.y);
+}
 
-				//Parsing
-				ParseObjFace(ss, tempVecPoint);
+//destination has room for vertexCount vertices of the mesh's vertex format
+void Mesh::EncodeVertices(const Vertex* source, uint32_t vertexCount, void* destination) const
+{
+	if (vertexFormat == VERTEX_FORMAT::Standard)
+	{
+		memcpy(destination, source, sizeof(Vertex) * static_cast<size_t>(vertexCount));
+		return;
+	}
 
-				//if there are more than 3 vertices for one face then split it in to several triangles
-				for (int i = 0; i < tempVecPoint.size(); i++)
-				{
-					if (i >= 3)
-					{
-						vecPoint.push_back(tempVecPoint.at(0));
-						vecPoint.push_back(tempVecPoint.at(i - 1));
-					}
-					vecPoint.push_back(tempVecPoint.at(i));
-				}
+	//positions are quantized against the bounds, a flat axis quantizes to 0
+	glm::vec3 extent = boundsMax - boundsMin;
+	glm::vec3 invExtent(
+		extent.x > 0.0f ? 1.0f / extent.x : 0.0f,
+		extent.y > 0.0f ? 1.0f / extent.y : 0.0f,
+		extent.z > 0.0f ? 1.0f / extent.z : 0.0f);
 
-			}
-			else if (str[0] == '#')
+	pRenderer->GetThreadPool()->ParallelFor(vertexCount, VERTEX_ENCODE_GRAIN_SIZE, [&](uint32_t begin, uint32_t end)
+	{
+		for (uint32_t i = begin; i < end; i++)
+		{
+			const Vertex& vertex = source[i];
+			if (vertexFormat == VERTEX_FORMAT::Compact)
 			{
-				//comment
+				CompactVertex& result = static_cast<CompactVertex*>(destination)[i];
+				result.pos[0] = vertex.pos.x;
+				result.pos[1] = vertex.pos.y;
+				result.pos[2] = vertex.pos.z;
+				EncodeCompactAttributes(vertex, result);
 			}
 			else
 			{
-				//others
+				QuantizedVertex& result = static_cast<QuantizedVertex*>(destination)[i];
+				glm::vec3 position = (vertex.pos - boundsMin) * invExtent;
+				result.pos[0] = glm::packUnorm1x16(position.x);
+				result.pos[1] = glm::packUnorm1x16(position.y);
+				result.pos[2] = glm::packUnorm1x16(position.z);
+				result.pos[3] = 0;
+				EncodeCompactAttributes(vertex, result);
 			}
 		}
+	});
+}
 
-		AssembleObjMesh(vecPos, vecUV, vecNor, vecPoint);
+//source holds interleaved vertices of the mesh's vertex format, destination receives the position stream at 0,
+//the normal stream at normalStreamOffset and the attribute stream at attributeStreamOffset
+void Mesh::SplitVertexStreams(const void* source, uint32_t vertexCount, void* destination) const
+{
+	size_t stride = GetVertexStride();
+	size_t positionStride = GetPositionStride();
+	size_t normalStride = GetNormalStride();
+	size_t attributeStride = stride - positionStride - normalStride;
+	const uint8_t* src = static_cast<const uint8_t*>(source);
+	uint8_t* positionStream = static_cast<uint8_t*>(destination);
+	uint8_t* normalStream = positionStream + normalStreamOffset;
+	uint8_t* attributeStream = positionStream + attributeStreamOffset;
+
+	pRenderer->GetThreadPool()->ParallelFor(vertexCount, VERTEX_ENCODE_GRAIN_SIZE, [&](uint32_t begin, uint32_t end)
+	{
+		for (size_t i = begin; i < end; i++)
+		{
+			memcpy(positionStream + i * positionStride, src + i * stride, positionStride);
+			memcpy(normalStream + i * normalStride, src + i * stride + positionStride, normalStride);
+			memcpy(attributeStream + i * attributeStride, src + i * stride + positionStride + normalStride, attributeStride);
+		}
+	});
+}
 
+VkDeviceSize Mesh::AlignVertexStream(VkDeviceSize offset)
+{
+	return (offset + VERTEX_STREAM_ALIGNMENT - 1) & ~(VERTEX_STREAM_ALIGNMENT - 1);
+}
+
+//optimization, bounds and stats of a freshly assembled mesh
+void Mesh::BuildMesh()
+{
+	//reordering only pays off when vertices are shared
+	if (optimize && indexMode == IndexMode::Welded)
+	{
+		OptimizeMesh();
 	}
 	else
+	{
+		MeshOptimizer::VertexCacheStats cacheStats = MeshOptimizer::AnalyzeVertexCache(indices, static_cast<uint32_t>(vertices.size()));
+		stats.acmrBefore = stats.acmrAfter = cacheStats.acmr;
+		stats.atvrBefore = stats.atvrAfter = cacheStats.atvr;
+	}
+	BuildLods();
+	BuildClusters();
+
+	boundsMin = vertices.empty() ? glm::vec3(0) : vertices[0].pos;
+	boundsMax = boundsMin;
+	for (const Vertex& vertex : vertices)
+	{
+		boundsMin = glm::min(boundsMin, vertex.pos);
+		boundsMax = glm::max(boundsMax, vertex.pos);
+	}
+
+	indexCount = static_cast<uint32_t>(indices.size());
+	stats.vertexCount = static_cast<uint32_t>(vertices.size());
+	stats.triangleCount = lodVec[0].indexCount / 3;
+	stats.clusterCount = lodVec[0].clusterCount;
+}
+
+//every lod is simplified from the previous one and appended to the index buffer,
+//the errors add up so a lod's error is measured against lod 0
+void Mesh::BuildLods()
+{
+	lodVec = { { 0, static_cast<uint32_t>(indices.size()), 0.0f } };
+
+	//collapsing edges needs vertices shared between triangles
+	if (type != MeshType::File || indexMode != IndexMode::Welded)
+		return;
+
+	uint32_t triangleCount = static_cast<uint32_t>(indices.size() / 3);
+	std::vector<uint32_t> lodIndices(indices);
+	for (uint32_t lod = 1; lod < lodCount; lod++)
+	{
+		uint32_t targetIndexCount = static_cast<uint32_t>(triangleCount * std::pow(LOD_REDUCTION, static_cast<float>(lod))) * 3;
+		std::vector<uint32_t> simplified;
+		float error = MeshSimplifier::Simplify(lodIndices, vertices, targetIndexCount, std::numeric_limits<float>::max(), simplified);
+		if (simplified.empty() || simplified.size() >= lodIndices.size())
+			break;
+
+		std::vector<uint32_t> clusterVec;
+		MeshOptimizer::OptimizeVertexCache(simplified, static_cast<uint32_t>(vertices.size()), clusterVec);
+
+		lodVec.push_back({ static_cast<uint32_t>(indices.size()), static_cast<uint32_t>(simplified.size()), lodVec.back().error + error });
+		indices.insert(indices.end(), simplified.begin(), simplified.end());
+		lodIndices = std::move(simplified);
+	}
+}
+
+//clustering reorders the triangles inside each lod, so it runs after the vertex cache optimization
+void Mesh::BuildClusters()
+{
+	clusterVec.clear();
+	if (!buildClusters)
+		return;
+
+	for (Lod& lod : lodVec)
+	{
+		std::vector<uint32_t> lodIndices(indices.begin() + lod.firstIndex, indices.begin() + lod.firstIndex + lod.indexCount);
+		std::vector<MeshClusterizer::Cluster> lodClusterVec;
+		MeshClusterizer::BuildClusters(lodIndices, vertices, lodClusterVec);
+		std::copy(lodIndices.begin(), lodIndices.end(), indices.begin() + lod.firstIndex);
+
+		lod.firstCluster = static_cast<uint32_t>(clusterVec.size());
+		lod.clusterCount = static_cast<uint32_t>(lodClusterVec.size());
+		for (MeshClusterizer::Cluster& cluster : lodClusterVec)
+		{
+			cluster.firstIndex += lod.firstIndex;
+			clusterVec.push_back(cluster);
+		}
+	}
+
+	//the cluster order replaces the optimized triangle order, report what is left of it
+	std::vector<uint32_t> lod0Indices(indices.begin(), indices.begin() + lodVec[0].indexCount);
+	MeshOptimizer::VertexCacheStats cacheStats = MeshOptimizer::AnalyzeVertexCache(lod0Indices, static_cast<uint32_t>(vertices.size()));
+	stats.acmrAfter = cacheStats.acmr;
+	stats.atvrAfter = cacheStats.atvr;
+}
+
+//adjacent triangles share vertices unless the index mode is UniqueCorners
+void Mesh::InitFromFile(const std::string& fileName)
+{
+	MappedFile file;
+	if (!file.Open(fileName))
 	{
 		throw std::runtime_error("can not open: " + fileName);
 	}
 
-	file.close();
+	//the cache is keyed by the content of the .obj file, so an edited file never picks up a stale cache
+	uint64_t sourceHash = Hash64(file.GetData(), file.GetSize());
+	std::string cacheFileName = MESH_CACHE_DIRECTORY + std::filesystem::path(fileName).filename().string() + "." + HashToString(sourceHash) + ".mesh";
+	if (useMeshCache && LoadMeshCache(cacheFileName, sourceHash))
+	{
+		return;
+	}
+
+	LoadObjMesh(file.GetData(), file.GetData() + file.GetSize(), pRenderer->GetThreadPool());
+	BuildMesh();
+
+	if (useMeshCache)
+	{
+		SaveMeshCache(cacheFileName, sourceHash);
+	}
+}
+
+uint32_t Mesh::GetMeshCacheBuildFlags() const
+{
+	return static_cast<uint32_t>(indexMode) | (optimize ? 0x100u : 0u) | (buildClusters ? 0x200u : 0u) | (lodCount << 16);
 }
 
-void Mesh::ParseObjFace(std::stringstream &ss, std::vector<Point>& tempVecPoint)
+//on success the cache stays mapped until the vertex and index buffers are created
+bool Mesh::LoadMeshCache(const std::string& cacheFileName, uint64_t sourceHash)
 {
-	char discard;
-	char peek;
-	uint32_t data;
-	Point tempPoint;
-	bool next;
+	if (!meshCache.Open(cacheFileName, sourceHash, GetMeshCacheBuildFlags()))
+	{
+		return false;
+	}
 
-	//One vertex in one loop
-	do
+	const MeshCache::Header& header = meshCache.GetHeader();
+	uint64_t vertexSize = 0;
+	uint64_t indexSize = 0;
+	meshCache.GetSection(MeshCache::SectionType::Vertices, vertexSize);
+	meshCache.GetSection(MeshCache::SectionType::Indices, indexSize);
+	uint64_t lodSize = 0;
+	const Lod* pLodArr = static_cast<const Lod*>(meshCache.GetSection(MeshCache::SectionType::Lods, lodSize));
+	if (vertexSize != sizeof(Vertex) * static_cast<uint64_t>(header.vertexCount) ||
+		indexSize != sizeof(uint32_t) * static_cast<uint64_t>(header.indexCount) ||
+		lodSize == 0 || lodSize % sizeof(Lod) != 0)
 	{
-		next = false;
-		tempPoint = { 0, 0, 0 };
+		meshCache.Close();
+		return false;
+	}
 
-		if (!next)
+	uint64_t clusterSize = 0;
+	const MeshClusterizer::Cluster* pClusterArr = static_cast<const MeshClusterizer::Cluster*>(meshCache.GetSection(MeshCache::SectionType::Clusters, clusterSize));
+	if (clusterSize % sizeof(MeshClusterizer::Cluster) != 0)
+	{
+		meshCache.Close();
+		return false;
+	}
+
+	lodVec.assign(pLodArr, pLodArr + lodSize / sizeof(Lod));
+	clusterVec.assign(pClusterArr, pClusterArr + clusterSize / sizeof(MeshClusterizer::Cluster));
+	for (const Lod& lod : lodVec)
+	{
+		if (static_cast<uint64_t>(lod.firstIndex) + lod.indexCount > header.indexCount ||
+			static_cast<uint64_t>(lod.firstCluster) + lod.clusterCount > clusterVec.size())
 		{
-			ss >> peek;
-			if (!ss.eof() && peek >= '0' && peek <= '9')
-			{
-				ss.putback(peek);
-				ss >> data;
-				tempPoint.VI = data;//index start at 1 in an .obj file but at 0 in an array
-				ss >> discard;
-				if (!ss.eof())
-				{
-					if (discard == '/')
-					{
-						//do nothing, this is the normal case, we move on to the next property
-					}
-					else
-					{
-						//this happens when the current property is the last property of this point on the face
-						//the discard is actually the starting number of the next point, so we put it back and move on
-						ss.putback(discard);
-						next = true;
-					}
-				}
-				else
-					next = true;
-			}
-			else
-				next = true;
+			meshCache.Close();
+			return false;
+		}
+	}
+
+	indexCount = header.indexCount;
+	boundsMin = glm::vec3(header.boundsMin);
+	boundsMax = glm::vec3(header.boundsMax);
+	stats.vertexCount = header.vertexCount;
+	stats.triangleCount = lodVec[0].indexCount / 3;
+	stats.clusterCount = lodVec[0].clusterCount;
+	stats.acmrBefore = header.acmrBefore;
+	stats.acmrAfter = header.acmrAfter;
+	stats.atvrBefore = header.atvrBefore;
+	stats.atvrAfter = header.atvrAfter;
+	return true;
+}
+
+//a failed write only costs the next launch a rebuild, so it is not an error
+void Mesh::SaveMeshCache(const std::string& cacheFileName, uint64_t sourceHash) const
+{
+	MeshCache::Header header;
+	header.sourceHash = sourceHash;
+	header.buildFlags = GetMeshCacheBuildFlags();
+	header.vertexCount = static_cast<uint32_t>(vertices.size());
+	header.indexCount = static_cast<uint32_t>(indices.size());
+	header.boundsMin = glm::vec4(boundsMin, 0.0f);
+	header.boundsMax = glm::vec4(boundsMax, 0.0f);
+	header.acmrBefore = stats.acmrBefore;
+	header.acmrAfter = stats.acmrAfter;
+	header.atvrBefore = stats.atvrBefore;
+	header.atvrAfter = stats.atvrAfter;
+
+	MeshCache::Write(cacheFileName, header, {
+		{ MeshCache::SectionType::Vertices, vertices.data(), sizeof(Vertex) * vertices.size() },
+		{ MeshCache::SectionType::Indices, indices.data(), sizeof(uint32_t) * indices.size() },
+		{ MeshCache::SectionType::Lods, lodVec.data(), sizeof(Lod) * lodVec.size() },
+		{ MeshCache::SectionType::Clusters, clusterVec.data(), sizeof(MeshClusterizer::Cluster) * clusterVec.size() } });
+}
+
+static inline const char* SkipObjSpaces(const char* p, const char* end)
+{
+	while (p < end && (*p == ' ' || *p == '\t'))
+		p++;
+	return p;
+}
+
+static inline const char* SkipObjLine(const char* p, const char* end)
+{
+	const char* eol = static_cast<const char*>(memchr(p, '\n', end - p));
+	return eol != nullptr ? eol + 1 : end;
+}
+
+static inline bool IsObjFloatChar(char c)
+{
+	return (c >= '0' && c <= '9') || c == '.' || c == '-' || c == '+' || c == 'e' || c == 'E';
+}
+
+//the chunk is not null terminated and the v141 toolset has no floating point from_chars, so strtof reads a bounded copy
+static inline const char* ParseObjFloat(const char* p, const char* end, float& value)
+{
+	const size_t OBJ_FLOAT_MAX_LENGTH = 63;
+	p = SkipObjSpaces(p, end);
+	char buffer[OBJ_FLOAT_MAX_LENGTH + 1];
+	size_t length = 0;
+	while (p + length < end && length < OBJ_FLOAT_MAX_LENGTH && IsObjFloatChar(p[length]))
+		length++;
+	memcpy(buffer, p, length);
+	buffer[length] = '\0';
+
+	char* parsedEnd = nullptr;
+	value = strtof(buffer, &parsedEnd);
+	if (parsedEnd == buffer)
+	{
+		value = 0.0f;
+		return p;
+	}
+	return p + (parsedEnd - buffer);
+}
+
+static inline const char* ParseObjIndex(const char* p, const char* end, size_t count, uint32_t& index)
+{
+	int64_t data = 0;
+	std::from_chars_result result = std::from_chars(p, end, data);
+	if (result.ec != std::errc())
+	{
+		index = 0;//0 marks a missing property
+		return p;
+	}
+	//negative indices are relative to the end of the list parsed so far
+	index = data < 0 ? static_cast<uint32_t>(static_cast<int64_t>(count) + data + 1) : static_cast<uint32_t>(data);
+	return result.ptr;
+}
+
+void Mesh::LoadObjMesh(const char* begin, const char* end, ThreadPool* pThreadPool)
+{
+
+	std::vector<glm::vec3> vecPos;
+	std::vector<glm::vec3> vecNor;
+	std::vector<glm::vec2> vecUV;
+	std::vector<Point> vecPoint;
+
+	uint32_t chunkCount = 1;
+	if (pThreadPool != nullptr && pThreadPool->GetThreadCount() > 1)
+	{
+		//a few chunks per thread so that an unlucky chunk full of long face lines does not stall the others
+		size_t maxChunkCount = (end - begin) / OBJ_CHUNK_MIN_SIZE;
+		chunkCount = static_cast<uint32_t>(std::min<size_t>(pThreadPool->GetThreadCount() * 4, maxChunkCount));
+	}
+
+	bool parsed = false;
+	if (chunkCount > 1)
+	{
+		parsed = LoadObjChunks(begin, end, chunkCount, pThreadPool, vecPos, vecUV, vecNor, vecPoint);
+	}
+
+	if (!parsed)
+	{
+		//relative indices need the running counts of the whole file, so they are parsed on one thread
+		ParseObjRange(begin, end, vecPos, vecUV, vecNor, vecPoint);
+	}
+
+	AssembleObjMesh(vecPos, vecUV, vecNor, vecPoint, pThreadPool);
+}
+
+//returns false if the file uses relative indices, in that case nothing is written to the output vectors
+bool Mesh::LoadObjChunks(
+	const char* begin,
+	const char* end,
+	uint32_t chunkCount,
+	ThreadPool* pThreadPool,
+	std::vector<glm::vec3>& vecPos,
+	std::vector<glm::vec2>& vecUV,
+	std::vector<glm::vec3>& vecNor,
+	std::vector<Point>& vecPoint)
+{
+	//line-aligned chunk boundaries, every chunk starts right after a line break
+	size_t size = end - begin;
+	std::vector<const char*> boundaryVec(chunkCount + 1);
+	boundaryVec[0] = begin;
+	boundaryVec[chunkCount] = end;
+	for (uint32_t i = 1; i < chunkCount; i++)
+	{
+		const char* p = std::max(begin + size / chunkCount * i, boundaryVec[i - 1]);
+		boundaryVec[i] = p > begin && p[-1] == '\n' ? p : SkipObjLine(p, end);
+	}
+
+	std::vector<ObjChunk> chunkVec(chunkCount);
+	pThreadPool->ParallelFor(chunkCount, 1, [&](uint32_t first, uint32_t last)
+	{
+		for (uint32_t i = first; i < last; i++)
+		{
+			ObjChunk& chunk = chunkVec[i];
+			chunk.hasRelativeIndex = ParseObjRange(boundaryVec[i], boundaryVec[i + 1], chunk.vecPos, chunk.vecUV, chunk.vecNor, chunk.vecPoint);
 		}
+	});
+
+	//prefix offsets of every chunk in the merged arrays, indices in an .obj file are absolute so points need no rebasing
+	size_t posCount = 0;
+	size_t uvCount = 0;
+	size_t norCount = 0;
+	size_t pointCount = 0;
+	for (auto& chunk : chunkVec)
+	{
+		if (chunk.hasRelativeIndex)
+			return false;
+		chunk.posOffset = posCount;
+		chunk.uvOffset = uvCount;
+		chunk.norOffset = norCount;
+		chunk.pointOffset = pointCount;
+		posCount += chunk.vecPos.size();
+		uvCount += chunk.vecUV.size();
+		norCount += chunk.vecNor.size();
+		pointCount += chunk.vecPoint.size();
+	}
 
-		if (!next)
+	vecPos.resize(posCount);
+	vecUV.resize(uvCount);
+	vecNor.resize(norCount);
+	vecPoint.resize(pointCount);
+	pThreadPool->ParallelFor(chunkCount, 1, [&](uint32_t first, uint32_t last)
+	{
+		for (uint32_t i = first; i < last; i++)
 		{
-			ss >> peek;
-			if (!ss.eof() && peek >= '0' && peek <= '9')
+			ObjChunk& chunk = chunkVec[i];
+			std::copy(chunk.vecPos.begin(), chunk.vecPos.end(), vecPos.begin() + chunk.posOffset);
+			std::copy(chunk.vecUV.begin(), chunk.vecUV.end(), vecUV.begin() + chunk.uvOffset);
+			std::copy(chunk.vecNor.begin(), chunk.vecNor.end(), vecNor.begin() + chunk.norOffset);
+			std::copy(chunk.vecPoint.begin(), chunk.vecPoint.end(), vecPoint.begin() + chunk.pointOffset);
+			chunk = ObjChunk();//release the chunk memory as soon as it is merged
+		}
+	});
+
+	return true;
+}
+
+//parses the lines in [begin, end), the range must start at the beginning of a line
+//returns true if relative(negative) indices were found, they are resolved against the counts of this range only
+bool Mesh::ParseObjRange(
+	const char* begin,
+	const char* end,
+	std::vector<glm::vec3>& vecPos,
+	std::vector<glm::vec2>& vecUV,
+	std::vector<glm::vec3>& vecNor,
+	std::vector<Point>& vecPoint)
+{
+	std::vector<Point> tempVecPoint;//reused by every face, so faces do not allocate
+	bool hasRelativeIndex = false;
+	const char* p = begin;
+	while (p < end)
+	{
+		p = SkipObjSpaces(p, end);
+		if (end - p >= 2 && p[0] == 'v' && (p[1] == ' ' || p[1] == '\t'))
+		{
+			glm::vec3 v;
+			p = ParseObjFloat(p + 2, end, v.x);
+			p = ParseObjFloat(p, end, v.y);
+			p = ParseObjFloat(p, end, v.z);
+			vecPos.push_back(v);
+		}
+		else if (end - p >= 3 && p[0] == 'v' && p[1] == 't' && (p[2] == ' ' || p[2] == '\t'))
+		{
+			glm::vec2 v;
+			p = ParseObjFloat(p + 3, end, v.x);
+			p = ParseObjFloat(p, end, v.y);
+			vecUV.push_back(v);
+		}
+		else if (end - p >= 3 && p[0] == 'v' && p[1] == 'n' && (p[2] == ' ' || p[2] == '\t'))
+		{
+			glm::vec3 v;
+			p = ParseObjFloat(p + 3, end, v.x);
+			p = ParseObjFloat(p, end, v.y);
+			p = ParseObjFloat(p, end, v.z);
+			vecNor.push_back(v);
+		}
+		else if (end - p >= 2 && p[0] == 'f' && (p[1] == ' ' || p[1] == '\t'))
+		{
+			tempVecPoint.clear();
+
+			//Parsing
+			p = ParseObjFace(p + 2, end, vecPos.size(), vecUV.size(), vecNor.size(), tempVecPoint, hasRelativeIndex);
+
+			//if there are more than 3 vertices for one face then split it in to several triangles
+			for (size_t i = 0; i < tempVecPoint.size(); i++)
 			{
-				ss.putback(peek);
-				ss >> data;
-				tempPoint.TI = data;//index start at 1 in an .obj file but at 0 in an array
-				ss >> discard;
-				if (!ss.eof())
+				if (i >= 3)
 				{
-					if (discard == '/')
-					{
-						//do nothing, this is the normal case, we move on to the next property
-					}
-					else
-					{
-						//this happens when the current property is the last property of this point on the face
-						//the discard is actually the starting number of the next point, so we put it back and move on
-						ss.putback(discard);
-						next = true;
-					}
+					vecPoint.push_back(tempVecPoint[0]);
+					vecPoint.push_back(tempVecPoint[i - 1]);
 				}
-				else
-					next = true;
+				vecPoint.push_back(tempVecPoint[i]);
 			}
-			else
-				next = true;
 		}
+		else
+		{
+			//comment and others
+		}
+		p = SkipObjLine(p, end);
+	}
+	return hasRelativeIndex;
+}
 
-		if (!next)
+//parses "VI/TI/NI" points until the end of the line, any of TI and NI can be missing
+const char* Mesh::ParseObjFace(const char* p, const char* end, size_t posCount, size_t uvCount, size_t norCount, std::vector<Point>& tempVecPoint, bool& hasRelativeIndex)
+{
+	//One vertex in one loop
+	while (true)
+	{
+		p = SkipObjSpaces(p, end);
+		if (p >= end || !((*p >= '0' && *p <= '9') || *p == '-'))
+			break;
+
+		if (*p == '-')
+			hasRelativeIndex = true;
+		Point tempPoint = { 0, 0, 0 };
+		p = ParseObjIndex(p, end, posCount, tempPoint.VI);//index start at 1 in an .obj file but at 0 in an array
+		if (p < end && *p == '/')
 		{
-			ss >> peek;
-			if (!ss.eof() && peek >= '0' && peek <= '9')
+			p++;
+			if (p < end && *p == '-')
+				hasRelativeIndex = true;
+			if (p < end && *p != '/')
+				p = ParseObjIndex(p, end, uvCount, tempPoint.TI);
+			if (p < end && *p == '/')
 			{
-				ss.putback(peek);
-				ss >> data;
-				tempPoint.NI = data;//index start at 1 in an .obj file but at 0 in an array
-				//normally we don't need the code below because normal index usually is the last property, but hey, better safe than sorry
-				ss >> discard;
-				if (!ss.eof())
-				{
-					if (discard == '/')
-					{
-						//do nothing, this is the normal case, we move on to the next property
-					}
-					else
-					{
-						//this happens when the current property is the last property of this point on the face
-						//the discard is actually the starting number of the next point, so we put it back and move on
-						ss.putback(discard);
-						next = true;
-					}
-				}
-				else
-					next = true;
+				p++;
+				if (p < end && *p == '-')
+					hasRelativeIndex = true;
+				p = ParseObjIndex(p, end, norCount, tempPoint.NI);
 			}
-			else
-				next = true;
 		}
-
 		tempVecPoint.push_back(tempPoint);
-	} while (!ss.eof());
+
+		//skip anything that is not part of an index, e.g. a stray '\r'
+		while (p < end && *p != ' ' && *p != '\t' && *p != '\n')
+			p++;
+	}
+	return p;
 }
 
 void Mesh::AssembleObjMesh(
 	const std::vector<glm::vec3> &vecPos,
 	const std::vector<glm::vec2> &vecUV,
 	const std::vector<glm::vec3> &vecNor,
-	const std::vector<Point> &vecPoint)
+	const std::vector<Point> &vecPoint,
+	ThreadPool* pThreadPool)
 {
+	if (indexMode == IndexMode::Welded)
+	{
+		AssembleObjMeshWelded(vecPos, vecUV, vecNor, vecPoint, pThreadPool);
+		return;
+	}
+
 	uint32_t n = static_cast<uint32_t>(vecPoint.size());
 
 	vertices.resize(n);
 	indices.resize(n);
 
-	for (uint32_t i = 0; i < n; i += 3)
+	if (pThreadPool != nullptr)
+	{
+		//triangles are independent of each other, so they are split into ranges across the workers
+		pThreadPool->ParallelFor(n / 3, OBJ_TRIANGLE_GRAIN_SIZE, [&](uint32_t first, uint32_t last)
+		{
+			AssembleObjTriangles(first * 3, last * 3, vecPos, vecUV, vecNor, vecPoint);
+		});
+	}
+	else
+	{
+		AssembleObjTriangles(0, n, vecPos, vecUV, vecNor, vecPoint);
+	}
+}
+
+static inline uint32_t HashObjPoint(uint32_t VI, uint32_t TI, uint32_t NI)
+{
+	uint32_t h = VI * 0x9E3779B1u ^ TI * 0x85EBCA77u ^ NI * 0xC2B2AE3Du;
+	h ^= h >> 16;
+	h *= 0x7FEB352Du;
+	h ^= h >> 15;
+	return h;
+}
+
+//writes one index per point into indices and one point per shared vertex into vecUniquePoint
+void Mesh::WeldObjPoints(const std::vector<Point>& vecPoint, std::vector<Point>& vecUniquePoint)
+{
+	uint32_t n = static_cast<uint32_t>(vecPoint.size());
+
+	//open addressing, slots hold vertex index + 1 so that 0 marks an empty slot
+	uint32_t slotCount = 1;
+	while (slotCount < n + n / 2 + 1)
+		slotCount <<= 1;
+	std::vector<uint32_t> slotVec(slotCount, 0);
+	uint32_t mask = slotCount - 1;
+
+	indices.resize(n);
+	vecUniquePoint.clear();
+	for (uint32_t i = 0; i < n; i++)
+	{
+		const Point& point = vecPoint[i];
+		uint32_t slot = HashObjPoint(point.VI, point.TI, point.NI) & mask;
+		while (true)
+		{
+			uint32_t vertexIndex = slotVec[slot];
+			if (vertexIndex == 0)
+			{
+				vecUniquePoint.push_back(point);
+				slotVec[slot] = static_cast<uint32_t>(vecUniquePoint.size());
+				indices[i] = static_cast<uint32_t>(vecUniquePoint.size() - 1);
+				break;
+			}
+			const Point& unique = vecUniquePoint[vertexIndex - 1];
+			if (unique.VI == point.VI && unique.TI == point.TI && unique.NI == point.NI)
+			{
+				indices[i] = vertexIndex - 1;
+				break;
+			}
+			slot = (slot + 1) & mask;
+		}
+	}
+}
+
+//vertices are shared between triangles and the tangent of a vertex is the average of the tangents of its triangles
+void Mesh::AssembleObjMeshWelded(
+	const std::vector<glm::vec3>& vecPos,
+	const std::vector<glm::vec2>& vecUV,
+	const std::vector<glm::vec3>& vecNor,
+	const std::vector<Point>& vecPoint,
+	ThreadPool* pThreadPool)
+{
+	std::vector<Point> vecUniquePoint;
+	WeldObjPoints(vecPoint, vecUniquePoint);
+
+	uint32_t vertexCount = static_cast<uint32_t>(vecUniquePoint.size());
+	uint32_t triangleCount = static_cast<uint32_t>(vecPoint.size() / 3);
+
+	auto parallelFor = [pThreadPool](uint32_t count, const std::function<void(uint32_t, uint32_t)>& func)
+	{
+		if (pThreadPool != nullptr)
+			pThreadPool->ParallelFor(count, OBJ_TRIANGLE_GRAIN_SIZE, func);
+		else
+			func(0, count);
+	};
+
+	vertices.resize(vertexCount);
+	parallelFor(vertexCount, [&](uint32_t first, uint32_t last)
+	{
+		for (uint32_t i = first; i < last; i++)
+		{
+			const Point& point = vecUniquePoint[i];
+			glm::vec3 pos(0, 0, 0);
+			glm::vec3 nor(0, 0, 0);
+			glm::vec2 uv(0, 0);
+
+			if (point.VI > 0) pos = vecPos[point.VI - 1];//index start at 1 in an .obj file but at 0 in an array, 0 was used to mark not-have-pos
+			if (point.NI > 0) nor = vecNor[point.NI - 1];//index start at 1 in an .obj file but at 0 in an array, 0 was used to mark not-have-nor
+			if (point.TI > 0) uv = vecUV[point.TI - 1];//index start at 1 in an .obj file but at 0 in an array, 0 was used to mark not-have-uv
+
+			vertices[i] = { pos, nor, glm::vec4(0), uv };
+		}
+	});
+
+	//per triangle tangent directions, computed in parallel and accumulated per vertex afterwards
+	std::vector<glm::vec3> triangleSdirVec(triangleCount);
+	std::vector<glm::vec3> triangleTdirVec(triangleCount);
+	parallelFor(triangleCount, [&](uint32_t first, uint32_t last)
+	{
+		for (uint32_t t = first; t < last; t++)
+		{
+			const Vertex& v0 = vertices[indices[t * 3]];
+			const Vertex& v1 = vertices[indices[t * 3 + 1]];
+			const Vertex& v2 = vertices[indices[t * 3 + 2]];
+
+			glm::vec3 e1 = v1.pos - v0.pos;
+			glm::vec3 e2 = v2.pos - v0.pos;
+			glm::vec2 d1 = v1.texCoord - v0.texCoord;
+			glm::vec2 d2 = v2.texCoord - v0.texCoord;
+
+			float det = d1.s * d2.t - d2.s * d1.t;
+			if (std::abs(det) < 1e-12f)
+			{
+				//degenerate uv mapping, this triangle does not contribute
+				triangleSdirVec[t] = glm::vec3(0);
+				triangleTdirVec[t] = glm::vec3(0);
+				continue;
+			}
+
+			float r = 1.0f / det;
+			glm::vec3 sdir = (e1 * d2.t - e2 * d1.t) * r;
+			glm::vec3 tdir = (e2 * d1.s - e1 * d2.s) * r;
+			float sLength = glm::length(sdir);
+			float tLength = glm::length(tdir);
+			triangleSdirVec[t] = sLength > 0.0f ? sdir / sLength : glm::vec3(0);
+			triangleTdirVec[t] = tLength > 0.0f ? tdir / tLength : glm::vec3(0);
+		}
+	});
+
+	std::vector<glm::vec3> sdirVec(vertexCount, glm::vec3(0));
+	std::vector<glm::vec3> tdirVec(vertexCount, glm::vec3(0));
+	for (uint32_t t = 0; t < triangleCount; t++)
+	{
+		for (uint32_t j = t * 3; j < t * 3 + 3; j++)
+		{
+			sdirVec[indices[j]] += triangleSdirVec[t];
+			tdirVec[indices[j]] += triangleTdirVec[t];
+		}
+	}
+
+	parallelFor(vertexCount, [&](uint32_t first, uint32_t last)
+	{
+		for (uint32_t i = first; i < last; i++)
+		{
+			glm::vec3 nor = vertices[i].normal;
+			glm::vec3 sdir = sdirVec[i] - nor * glm::dot(nor, sdirVec[i]);//Gram-Schmidt against the vertex normal
+			if (glm::dot(sdir, sdir) < 1e-20f)
+			{
+				//no usable uv gradient, any direction perpendicular to the normal will do
+				sdir = std::abs(nor.x) < 0.9f ? glm::cross(nor, glm::vec3(1, 0, 0)) : glm::cross(nor, glm::vec3(0, 1, 0));
+				if (glm::dot(sdir, sdir) < 1e-20f)
+					sdir = glm::vec3(1, 0, 0);
+			}
+			sdir = glm::normalize(sdir);
+
+			//The order is fixed, it is the same in the shaders. The only way to tell the direction when reconstructing tangent is the sign component.
+			float sign = glm::dot(glm::cross(nor, sdir), tdirVec[i]) > 0.0f ? 1.0f : -1.0f;
+			vertices[i].tangent = glm::vec4(sdir, sign);
+		}
+	});
+}
+
+//assembles the points in [begin, end), both must be multiples of 3
+void Mesh::AssembleObjTriangles(
+	uint32_t begin,
+	uint32_t end,
+	const std::vector<glm::vec3>& vecPos,
+	const std::vector<glm::vec2>& vecUV,
+	const std::vector<glm::vec3>& vecNor,
+	const std::vector<Point>& vecPoint)
+{
+	for (uint32_t i = begin; i < end; i += 3)
 	{
 		glm::vec3 p0 = vecPos[vecPoint[i].VI - 1];
 		glm::vec3 p1 = vecPos[vecPoint[i + 1].VI - 1];
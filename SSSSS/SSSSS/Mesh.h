@@ -1,14 +1,53 @@
 #pragma once
 
 #include "GlobalInclude.h"
+#include "MeshCache.h"
+#include "MeshClusterizer.h"
+#include "MeshOptimizer.h"
+#include "DeviceMemoryAllocator.h"
+#include "GeometryArena.h"
+#include "UploadManager.h"
 
 class Renderer;
 class Texture;
+class ThreadPool;
 
 class Mesh
 {
 public:
 	enum class MeshType { Square, FullScreenQuad, File, Count };
+	//how .obj points become vertices, Welded shares a vertex between all points with the same (VI, TI, NI)
+	enum class IndexMode { UniqueCorners, Welded, Count };
+
+	//a range of the index buffer drawn with one draw call, indices are relative to vertexOffset
+	using SubMesh = MeshOptimizer::IndexRange;
+
+	//a level of detail is a range of the index buffer, all levels share the vertex buffer
+	struct Lod
+	{
+		uint32_t firstIndex = 0;
+		uint32_t indexCount = 0;
+		float error = 0.0f;//how far the surface moved from lod 0 at most, in object space units
+		uint32_t firstCluster = 0;
+		uint32_t clusterCount = 0;//0 when the mesh has no clusters
+		uint32_t PADDING0 = 0;
+	};
+
+	//instrumentation, filled in by InitMesh
+	struct MeshStats
+	{
+		uint32_t vertexCount = 0;
+		uint32_t triangleCount = 0;
+		uint32_t subMeshCount = 0;
+		uint32_t clusterCount = 0;//of lod 0
+		VkDeviceSize vertexBufferSize = 0;
+		VkDeviceSize indexBufferSize = 0;
+		//post-transform cache efficiency of the index buffer before and after optimization
+		float acmrBefore = 0.0f;
+		float acmrAfter = 0.0f;
+		float atvrBefore = 0.0f;
+		float atvrAfter = 0.0f;
+	};
 
 	Mesh(const std::string& _name, MeshType _type, const glm::vec3& _position, const glm::vec3& _rotation, const glm::vec3& _scale);
 	~Mesh();
@@ -17,13 +56,51 @@ public:
 	VkBuffer GetObjectUniformBuffer() const;
 	VkBuffer GetVertexBuffer() const;
 	VkBuffer GetIndexBuffer() const;
+	//vertices and indices live in the geometry arena of the renderer, add these to the draws of this mesh
+	VkDeviceSize GetVertexBufferOffset() const;//where the vertex buffer binds, 0 unless the vertex streams are split
+	int32_t GetBaseVertex() const;
+	uint32_t GetFirstIndex() const;
 	VkDescriptorSet* GetObjectDescriptorSetPtr(int frame);
+	//rewrites the textures of the frame's descriptor set whose image view changed since they were bound, like Pass::UpdateTextureBindings
+	void UpdateTextureBindings(int frame);
 	int GetObjectDescriptorSetCount() const;
-	const std::vector<uint32_t>& GetIndexVec() const;
+	uint32_t GetIndexCount() const;
+	VkIndexType GetIndexType() const;
+	const std::vector<SubMesh>& GetSubMeshVec(uint32_t lod = 0) const;
+	uint32_t GetLodCount() const;
+	const Lod& GetLod(uint32_t lod) const;
+	const std::vector<MeshClusterizer::Cluster>& GetClusterVec() const;
+	glm::mat4 GetModelMatrix() const;
+	glm::vec3 GetBoundsMin() const;
+	glm::vec3 GetBoundsMax() const;
 	uint32_t GetTextureCount() const;
+	//false while the geometry or one of the textures is still on its way to the gpu, passes skip the mesh until then
+	bool IsUploadComplete() const;
 	uint32_t GetUboCount() const;
 	VkDescriptorSetLayout GetObjectDescriptorSetLayout() const;
 	void UpdateObjectUniformBuffer(int frame);
+	void SetIndexMode(IndexMode _indexMode);//call before InitMesh
+	void SetOptimize(bool _optimize);//call before InitMesh
+	void SetUseMeshCache(bool _useMeshCache);//call before InitMesh
+	//16 bit indices are picked whenever the vertices fit, a larger mesh is split into sub-meshes that fit unless that takes more than MAX_SUB_MESH_COUNT draws
+	//or a single triangle spans more than 16 bits on its own, such meshes keep 32 bit indices
+	void SetAllow16BitIndices(bool _allow16BitIndices);//call before InitMesh
+	//lod i is simplified to LOD_REDUCTION^i of the triangles of lod 0, only welded meshes from files are simplified
+	void SetLodCount(uint32_t _lodCount);//call before InitMesh
+	//every lod is split into clusters of about MeshClusterizer::CLUSTER_TRIANGLE_COUNT triangles that passes cull on their own
+	void SetBuildClusters(bool _buildClusters);//call before InitMesh
+	void SetVertexFormat(VERTEX_FORMAT _vertexFormat);//call before InitMesh, the vertex shaders drawing this mesh need the same format
+	VERTEX_FORMAT GetVertexFormat() const;
+	uint32_t GetVertexStride() const;
+	//split vertex streams store every position first, then every normal and then the other attributes in the same vertex buffer,
+	//so passes that only need positions(and normals) fetch tightly packed streams
+	void SetSplitVertexStreams(bool _splitVertexStreams);//call before InitMesh
+	bool IsVertexStreamSplit() const;
+	uint32_t GetPositionStride() const;
+	uint32_t GetNormalStride() const;
+	VkDeviceSize GetNormalStreamOffset() const;
+	VkDeviceSize GetAttributeStreamOffset() const;
+	const MeshStats& GetMeshStats() const;
 
 	void InitMesh(Renderer* _pRenderer, VkDescriptorPool descriptorPool);
 	void CleanUp();
@@ -39,10 +116,47 @@ private:
 		uint32_t NI;
 	};
 
+	//the part of an .obj file parsed by one worker thread
+	struct ObjChunk
+	{
+		std::vector<glm::vec3> vecPos;
+		std::vector<glm::vec2> vecUV;
+		std::vector<glm::vec3> vecNor;
+		std::vector<Point> vecPoint;
+		bool hasRelativeIndex = false;
+		size_t posOffset = 0;
+		size_t uvOffset = 0;
+		size_t norOffset = 0;
+		size_t pointOffset = 0;
+	};
+
+	//files smaller than 2 chunks are parsed on the calling thread
+	static const size_t OBJ_CHUNK_MIN_SIZE = 4 * 1024 * 1024;
+	static const uint32_t OBJ_TRIANGLE_GRAIN_SIZE = 64 * 1024;
+	static const uint32_t VERTEX_ENCODE_GRAIN_SIZE = 64 * 1024;
+	static const VkDeviceSize VERTEX_STREAM_ALIGNMENT = 16;
+	static const uint32_t MAX_16BIT_INDEX = 0xFFFF;//primitive restart is disabled, so 0xFFFF is a regular index
+	static const uint32_t MAX_SUB_MESH_COUNT = 64;
+	static const uint32_t INDEX_CONVERT_GRAIN_SIZE = 256 * 1024;
+	static constexpr float LOD_REDUCTION = 0.5f;
+
 	Renderer* pRenderer;
 	std::string name;
 	const uint32_t oUboCount = 1;
 	MeshType type;
+	IndexMode indexMode;
+	bool optimize;
+	bool useMeshCache;
+	VERTEX_FORMAT vertexFormat;
+	bool splitVertexStreams;
+	bool allow16BitIndices;
+	uint32_t lodCount;
+	bool buildClusters;
+	MeshStats stats;
+
+	//built meshes of .obj files are cached here, keyed by the content hash of the .obj file
+	const std::string MESH_CACHE_DIRECTORY = "MeshCache/";
+	MeshCache meshCache;
 
 	//assets
 	std::vector<Texture*> pTextureVec;
@@ -50,16 +164,25 @@ private:
 	//mesh properties
 	std::vector<Vertex> vertices;
 	std::vector<uint32_t> indices;
-	VkBuffer vertexBuffer;
-	VkDeviceMemory vertexBufferMemory;
-	VkBuffer indexBuffer;
-	VkDeviceMemory indexBufferMemory;
+	uint32_t indexCount;//indices can be empty when the mesh comes from the mesh cache
+	VkIndexType indexType;
+	std::vector<Lod> lodVec;
+	std::vector<std::vector<SubMesh>> lodSubMeshVec;//[lod][sub-mesh]
+	std::vector<MeshClusterizer::Cluster> clusterVec;//clusters of all lods, firstIndex is absolute
+	glm::vec3 boundsMin;
+	glm::vec3 boundsMax;
+	GeometryArena::Allocation vertexAllocation;
+	VkDeviceSize normalStreamOffset;//0 when the vertex streams are interleaved, relative to the vertex allocation
+	VkDeviceSize attributeStreamOffset;//0 when the vertex streams are interleaved, relative to the vertex allocation
+	GeometryArena::Allocation indexAllocation;
+	UploadTicket uploadTicket;
 
 	//object uniform
 	ObjectUniformBufferObject oUBO;
 	VkBuffer objectUniformBuffer;
-	VkDeviceMemory objectUniformBufferMemory;
+	DeviceMemoryAllocator::Allocation objectUniformBufferAllocation;
 	std::vector<VkDescriptorSet> objectDescriptorSetVec;
+	std::vector<std::vector<VkImageView>> boundImageViewVec;//[frame][texture], what the descriptor sets hold
 	VkDescriptorSetLayout objectDescriptorSetLayout;
 
 	//vulkan functions
@@ -73,9 +196,50 @@ private:
 	void InitFromFile(const std::string& fileName);
 
 	//mesh functions
-	void LoadObjMesh(const std::string& fileName);
-	void ParseObjFace(std::stringstream& ss, std::vector<Point>& tempVecPoint);
+	void BuildMesh();
+	void EncodeVertices(const Vertex* source, uint32_t vertexCount, void* destination) const;
+	void SplitVertexStreams(const void* source, uint32_t vertexCount, void* destination) const;
+	static VkDeviceSize AlignVertexStream(VkDeviceSize offset);
+	void OptimizeMesh();
+	void BuildLods();
+	void BuildClusters();
+	uint32_t GetMeshCacheBuildFlags() const;
+	bool LoadMeshCache(const std::string& cacheFileName, uint64_t sourceHash);
+	void SaveMeshCache(const std::string& cacheFileName, uint64_t sourceHash) const;
+	void LoadObjMesh(const char* begin, const char* end, ThreadPool* pThreadPool);
+	bool LoadObjChunks(
+		const char* begin,
+		const char* end,
+		uint32_t chunkCount,
+		ThreadPool* pThreadPool,
+		std::vector<glm::vec3>& vecPos,
+		std::vector<glm::vec2>& vecUV,
+		std::vector<glm::vec3>& vecNor,
+		std::vector<Point>& vecPoint);
+	bool ParseObjRange(
+		const char* begin,
+		const char* end,
+		std::vector<glm::vec3>& vecPos,
+		std::vector<glm::vec2>& vecUV,
+		std::vector<glm::vec3>& vecNor,
+		std::vector<Point>& vecPoint);
+	const char* ParseObjFace(const char* p, const char* end, size_t posCount, size_t uvCount, size_t norCount, std::vector<Point>& tempVecPoint, bool& hasRelativeIndex);
 	void AssembleObjMesh(
+		const std::vector<glm::vec3>& vecPos,
+		const std::vector<glm::vec2>& vecUV,
+		const std::vector<glm::vec3>& vecNor,
+		const std::vector<Point>& vecPoint,
+		ThreadPool* pThreadPool);
+	void AssembleObjMeshWelded(
+		const std::vector<glm::vec3>& vecPos,
+		const std::vector<glm::vec2>& vecUV,
+		const std::vector<glm::vec3>& vecNor,
+		const std::vector<Point>& vecPoint,
+		ThreadPool* pThreadPool);
+	void WeldObjPoints(const std::vector<Point>& vecPoint, std::vector<Point>& vecUniquePoint);
+	void AssembleObjTriangles(
+		uint32_t begin,
+		uint32_t end,
 		const std::vector<glm::vec3>& vecPos,
 		const std::vector<glm::vec2>& vecUV,
 		const std::vector<glm::vec3>& vecNor,
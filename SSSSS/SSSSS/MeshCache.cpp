@@ -0,0 +1,143 @@
+#include "MeshCache.h"
+
+#include <fstream>
+#include <filesystem>
+#include <cstring>
+
+MeshCache::MeshCache() :
+	pSectionArr(nullptr)
+{
+}
+
+MeshCache::~MeshCache()
+{
+	Close();
+}
+
+bool MeshCache::Open(const std::string& fileName, uint64_t sourceHash, uint32_t buildFlags)
+{
+	Close();
+
+	if (!file.Open(fileName))
+		return false;
+
+	const char* data = file.GetData();
+	uint64_t size = file.GetSize();
+	if (size < sizeof(Header))
+	{
+		Close();
+		return false;
+	}
+
+	memcpy(&header, data, sizeof(Header));
+	if (header.magic != MAGIC ||
+		header.version != VERSION ||
+		header.sourceHash != sourceHash ||
+		header.buildFlags != buildFlags ||
+		header.vertexStride != sizeof(Vertex) ||
+		sizeof(Header) + header.sectionCount * sizeof(Section) > size)
+	{
+		Close();
+		return false;
+	}
+
+	pSectionArr = reinterpret_cast<const Section*>(data + sizeof(Header));
+	for (uint32_t i = 0; i < header.sectionCount; i++)
+	{
+		const Section& section = pSectionArr[i];
+		if (section.offset > size || section.size > size - section.offset || section.offset % SECTION_ALIGNMENT != 0)
+		{
+			Close();
+			return false;
+		}
+	}
+
+	return true;
+}
+
+void MeshCache::Close()
+{
+	file.Close();
+	header = Header();
+	pSectionArr = nullptr;
+}
+
+bool MeshCache::IsOpen() const
+{
+	return pSectionArr != nullptr;
+}
+
+const MeshCache::Header& MeshCache::GetHeader() const
+{
+	return header;
+}
+
+const void* MeshCache::GetSection(SectionType type, uint64_t& size) const
+{
+	for (uint32_t i = 0; i < header.sectionCount && pSectionArr != nullptr; i++)
+	{
+		if (pSectionArr[i].type == static_cast<uint32_t>(type))
+		{
+			size = pSectionArr[i].size;
+			return file.GetData() + pSectionArr[i].offset;
+		}
+	}
+	size = 0;
+	return nullptr;
+}
+
+bool MeshCache::Write(const std::string& fileName, const Header& header, const std::vector<SectionData>& sectionDataVec)
+{
+	std::error_code error;
+	std::filesystem::path path(fileName);
+	if (path.has_parent_path())
+	{
+		std::filesystem::create_directories(path.parent_path(), error);
+	}
+
+	Header fileHeader = header;
+	fileHeader.magic = MAGIC;
+	fileHeader.version = VERSION;
+	fileHeader.vertexStride = sizeof(Vertex);
+	fileHeader.sectionCount = static_cast<uint32_t>(sectionDataVec.size());
+
+	std::vector<Section> sectionVec(sectionDataVec.size());
+	uint64_t offset = sizeof(Header) + sizeof(Section) * sectionVec.size();
+	for (size_t i = 0; i < sectionDataVec.size(); i++)
+	{
+		offset = (offset + SECTION_ALIGNMENT - 1) / SECTION_ALIGNMENT * SECTION_ALIGNMENT;
+		sectionVec[i] = { static_cast<uint32_t>(sectionDataVec[i].type), 0, offset, sectionDataVec[i].size };
+		offset += sectionDataVec[i].size;
+	}
+
+	std::string tempFileName = fileName + ".tmp";
+	{
+		std::ofstream out(tempFileName, std::ios::binary | std::ios::trunc);
+		if (!out.is_open())
+			return false;
+
+		out.write(reinterpret_cast<const char*>(&fileHeader), sizeof(Header));
+		out.write(reinterpret_cast<const char*>(sectionVec.data()), sizeof(Section) * sectionVec.size());
+		const char zeros[SECTION_ALIGNMENT] = {};
+		for (size_t i = 0; i < sectionDataVec.size(); i++)
+		{
+			uint64_t position = static_cast<uint64_t>(out.tellp());
+			out.write(zeros, sectionVec[i].offset - position);
+			out.write(static_cast<const char*>(sectionDataVec[i].data), sectionDataVec[i].size);
+		}
+		if (!out.good())
+		{
+			out.close();
+			std::filesystem::remove(tempFileName, error);
+			return false;
+		}
+	}
+
+	std::filesystem::rename(tempFileName, fileName, error);
+	if (error)
+	{
+		std::filesystem::remove(tempFileName, error);
+		return false;
+	}
+	return true;
+}
@@ -0,0 +1,68 @@
+#pragma once
+
+#include "GlobalInclude.h"
+#include "MappedFile.h"
+
+//versioned binary file holding a fully built mesh, so a mesh loads without parsing or recomputing anything
+class MeshCache
+{
+public:
+	static const uint32_t MAGIC = 0x48534D53;//"SMSH"
+	static const uint32_t VERSION = 3;//bump whenever the layout of the file or the content of a section changes
+
+	enum class SectionType : uint32_t { Vertices, Indices, Lods, Clusters, Count };
+
+	struct Header
+	{
+		uint32_t magic = MAGIC;
+		uint32_t version = VERSION;
+		uint64_t sourceHash = 0;//hash of the source file content
+		uint32_t buildFlags = 0;//options the mesh was built with, a different set of options is a cache miss
+		uint32_t sectionCount = 0;
+		uint32_t vertexCount = 0;
+		uint32_t indexCount = 0;
+		uint32_t vertexStride = sizeof(Vertex);
+		uint32_t PADDING0 = 0;
+		glm::vec4 boundsMin = glm::vec4(0);
+		glm::vec4 boundsMax = glm::vec4(0);
+		float acmrBefore = 0.0f;
+		float acmrAfter = 0.0f;
+		float atvrBefore = 0.0f;
+		float atvrAfter = 0.0f;
+	};
+
+	struct SectionData
+	{
+		SectionType type;
+		const void* data;
+		uint64_t size;
+	};
+
+	MeshCache();
+	~MeshCache();
+
+	//maps the file and validates it against the source hash and build flags, returns false on any mismatch
+	bool Open(const std::string& fileName, uint64_t sourceHash, uint32_t buildFlags);
+	void Close();
+	bool IsOpen() const;
+	const Header& GetHeader() const;
+	const void* GetSection(SectionType type, uint64_t& size) const;
+
+	//writes to a temporary file first and renames it, so an interrupted write never leaves a truncated cache behind
+	static bool Write(const std::string& fileName, const Header& header, const std::vector<SectionData>& sectionDataVec);
+
+private:
+	struct Section
+	{
+		uint32_t type;
+		uint32_t PADDING0;
+		uint64_t offset;
+		uint64_t size;
+	};
+
+	static const uint64_t SECTION_ALIGNMENT = 16;
+
+	MappedFile file;
+	Header header;
+	const Section* pSectionArr;
+};
@@ -0,0 +1,238 @@
+#include "MeshClusterizer.h"
+#include "MeshOptimizer.h"
+
+#include <algorithm>
+#include <cfloat>
+#include <cmath>
+
+void MeshClusterizer::BuildClusters(
+	std::vector<uint32_t>& indices,
+	const std::vector<Vertex>& vertices,
+	std::vector<Cluster>& clusterVec,
+	uint32_t maxTriangleCount)
+{
+	uint32_t triangleCount = static_cast<uint32_t>(indices.size() / 3);
+	uint32_t vertexCount = static_cast<uint32_t>(vertices.size());
+	clusterVec.clear();
+	if (triangleCount == 0)
+		return;
+
+	//vertex to triangle adjacency, stored as one flat array with an offset per vertex
+	std::vector<uint32_t> offsetVec(vertexCount + 1, 0);
+	for (uint32_t index : indices)
+	{
+		offsetVec[index + 1]++;
+	}
+	for (uint32_t v = 0; v < vertexCount; v++)
+	{
+		offsetVec[v + 1] += offsetVec[v];
+	}
+	std::vector<uint32_t> adjacencyVec(indices.size());
+	{
+		std::vector<uint32_t> fillVec(offsetVec.begin(), offsetVec.end() - 1);
+		for (uint32_t i = 0; i < indices.size(); i++)
+		{
+			adjacencyVec[fillVec[indices[i]]++] = i / 3;
+		}
+	}
+
+	std::vector<glm::vec3> centroidVec(triangleCount);
+	std::vector<glm::vec3> normalVec(triangleCount);
+	for (uint32_t t = 0; t < triangleCount; t++)
+	{
+		const glm::vec3& p0 = vertices[indices[t * 3]].pos;
+		const glm::vec3& p1 = vertices[indices[t * 3 + 1]].pos;
+		const glm::vec3& p2 = vertices[indices[t * 3 + 2]].pos;
+		centroidVec[t] = (p0 + p1 + p2) / 3.0f;
+		glm::vec3 normal = glm::cross(p1 - p0, p2 - p0);
+		float length = glm::length(normal);
+		normalVec[t] = length > 0.0f ? normal / length : glm::vec3(0);
+	}
+
+	std::vector<bool> emittedVec(triangleCount, false);
+	std::vector<uint32_t> candidateStampVec(triangleCount, UINT32_MAX);//the cluster a triangle was last a candidate of
+	std::vector<uint32_t> candidateVec;
+	std::vector<uint32_t> localIndexVec(vertexCount, UINT32_MAX);
+	std::vector<uint32_t> localToGlobalVec;
+	std::vector<uint32_t> localIndices;
+	std::vector<uint32_t> localClusterVec;
+	std::vector<uint32_t> output;
+	output.reserve(indices.size());
+
+	uint32_t cursor = 0;//next triangle for the linear scan when a cluster needs a seed
+	while (true)
+	{
+		while (cursor < triangleCount && emittedVec[cursor])
+		{
+			cursor++;
+		}
+		if (cursor == triangleCount)
+			break;
+
+		uint32_t clusterIndex = static_cast<uint32_t>(clusterVec.size());
+		uint32_t clusterFirstIndex = static_cast<uint32_t>(output.size());
+		uint32_t clusterTriangleCount = 0;
+		glm::vec3 clusterCenter(0);
+		glm::vec3 clusterNormal(0);
+		float clusterRadius = 0.0f;
+		candidateVec.clear();
+
+		uint32_t next = cursor;
+		while (true)
+		{
+			//emit
+			emittedVec[next] = true;
+			for (uint32_t j = next * 3; j < next * 3 + 3; j++)
+			{
+				output.push_back(indices[j]);
+			}
+			clusterTriangleCount++;
+			clusterCenter += (centroidVec[next] - clusterCenter) / static_cast<float>(clusterTriangleCount);
+			clusterNormal += normalVec[next];
+			clusterRadius = std::max(clusterRadius, glm::length(centroidVec[next] - clusterCenter));
+			if (clusterTriangleCount == maxTriangleCount)
+				break;
+
+			//every triangle sharing a vertex with the new one can join next
+			for (uint32_t j = next * 3; j < next * 3 + 3; j++)
+			{
+				uint32_t v = indices[j];
+				for (uint32_t a = offsetVec[v]; a < offsetVec[v + 1]; a++)
+				{
+					uint32_t t = adjacencyVec[a];
+					if (emittedVec[t] || candidateStampVec[t] == clusterIndex)
+						continue;
+					candidateStampVec[t] = clusterIndex;
+					candidateVec.push_back(t);
+				}
+			}
+
+			//the candidate that keeps the cluster compact and its normals together
+			glm::vec3 averageNormal = glm::length(clusterNormal) > 0.0f ? glm::normalize(clusterNormal) : glm::vec3(0);
+			float bestScore = FLT_MAX;
+			size_t bestSlot = 0;
+			for (size_t c = 0; c < candidateVec.size();)
+			{
+				uint32_t t = candidateVec[c];
+				if (emittedVec[t])
+				{
+					candidateVec[c] = candidateVec.back();
+					candidateVec.pop_back();
+					continue;
+				}
+				float distance = glm::length(centroidVec[t] - clusterCenter) / std::max(clusterRadius, FLT_EPSILON);
+				float score = distance + (1.0f - glm::dot(normalVec[t], averageNormal));
+				if (score < bestScore)
+				{
+					bestScore = score;
+					bestSlot = c;
+				}
+				c++;
+			}
+			if (candidateVec.empty())
+				break;
+
+			next = candidateVec[bestSlot];
+			candidateVec[bestSlot] = candidateVec.back();
+			candidateVec.pop_back();
+		}
+
+		//the growth order is poor for the post-transform cache, so optimize each cluster on its own,
+		//renumbered to local vertices so Tipsify only touches the few vertices of the cluster
+		localToGlobalVec.clear();
+		localIndices.clear();
+		for (size_t i = clusterFirstIndex; i < output.size(); i++)
+		{
+			uint32_t& local = localIndexVec[output[i]];
+			if (local == UINT32_MAX)
+			{
+				local = static_cast<uint32_t>(localToGlobalVec.size());
+				localToGlobalVec.push_back(output[i]);
+			}
+			localIndices.push_back(local);
+		}
+		MeshOptimizer::OptimizeVertexCache(localIndices, static_cast<uint32_t>(localToGlobalVec.size()), localClusterVec);
+		for (size_t i = 0; i < localIndices.size(); i++)
+		{
+			output[clusterFirstIndex + i] = localToGlobalVec[localIndices[i]];
+		}
+		for (uint32_t global : localToGlobalVec)
+		{
+			localIndexVec[global] = UINT32_MAX;
+		}
+
+		Cluster cluster = ComputeClusterBounds(output.data() + clusterFirstIndex, clusterTriangleCount * 3, vertices);
+		cluster.firstIndex = clusterFirstIndex;
+		cluster.indexCount = clusterTriangleCount * 3;
+		clusterVec.push_back(cluster);
+	}
+
+	indices.swap(output);
+}
+
+MeshClusterizer::Cluster MeshClusterizer::ComputeClusterBounds(const uint32_t* indices, uint32_t indexCount, const std::vector<Vertex>& vertices)
+{
+	Cluster cluster;
+
+	//bounding sphere around the center of the bounding box, not minimal but close for compact clusters
+	glm::vec3 boxMin = vertices[indices[0]].pos;
+	glm::vec3 boxMax = boxMin;
+	for (uint32_t i = 1; i < indexCount; i++)
+	{
+		boxMin = glm::min(boxMin, vertices[indices[i]].pos);
+		boxMax = glm::max(boxMax, vertices[indices[i]].pos);
+	}
+	cluster.center = (boxMin + boxMax) * 0.5f;
+	for (uint32_t i = 0; i < indexCount; i++)
+	{
+		cluster.radius = std::max(cluster.radius, glm::length(vertices[indices[i]].pos - cluster.center));
+	}
+
+	//normal cone, the axis is the area weighted average normal
+	glm::vec3 axis(0);
+	for (uint32_t i = 0; i < indexCount; i += 3)
+	{
+		const glm::vec3& p0 = vertices[indices[i]].pos;
+		axis += glm::cross(vertices[indices[i + 1]].pos - p0, vertices[indices[i + 2]].pos - p0);
+	}
+	float axisLength = glm::length(axis);
+	if (axisLength == 0.0f)
+		return cluster;
+	axis /= axisLength;
+
+	float minDot = 1.0f;
+	for (uint32_t i = 0; i < indexCount; i += 3)
+	{
+		const glm::vec3& p0 = vertices[indices[i]].pos;
+		glm::vec3 normal = glm::cross(vertices[indices[i + 1]].pos - p0, vertices[indices[i + 2]].pos - p0);
+		float length = glm::length(normal);
+		if (length > 0.0f)
+		{
+			minDot = std::min(minDot, glm::dot(normal / length, axis));
+		}
+	}
+
+	//wider than a hemisphere, some triangle always faces the viewer
+	if (minDot <= 0.0f)
+		return cluster;
+
+	//move the apex back along the axis until the cone contains every triangle plane in front of it,
+	//so the test stays conservative for viewers close to the cluster, not only far away ones
+	float maxT = 0.0f;
+	for (uint32_t i = 0; i < indexCount; i += 3)
+	{
+		const glm::vec3& p0 = vertices[indices[i]].pos;
+		glm::vec3 normal = glm::cross(vertices[indices[i + 1]].pos - p0, vertices[indices[i + 2]].pos - p0);
+		float length = glm::length(normal);
+		if (length == 0.0f)
+			continue;
+		normal /= length;
+		float t = glm::dot(cluster.center - p0, normal) / glm::dot(axis, normal);
+		maxT = std::max(maxT, t);
+	}
+
+	cluster.coneAxis = axis;
+	cluster.coneCutoff = std::sqrt(1.0f - minDot * minDot);
+	cluster.coneApex = cluster.center - axis * maxT;
+	return cluster;
+}
@@ -0,0 +1,39 @@
+#pragma once
+
+#include "GlobalInclude.h"
+
+//splits indexed triangle lists into small spatially coherent clusters that can be culled one by one
+class MeshClusterizer
+{
+public:
+	//a cluster is a range of the index buffer, bounds are in object space
+	struct Cluster
+	{
+		glm::vec3 center = glm::vec3(0);
+		float radius = 0.0f;
+		//all triangles face away from a viewer at p when dot(normalize(coneApex - p), coneAxis) > coneCutoff,
+		//coneCutoff is the sine of the angle between coneAxis and the normal farthest from it, 1 means the cone can not be culled
+		glm::vec3 coneApex = glm::vec3(0);
+		float coneCutoff = 1.0f;
+		glm::vec3 coneAxis = glm::vec3(0, 0, 1);
+		uint32_t firstIndex = 0;
+		uint32_t indexCount = 0;
+		uint32_t PADDING0 = 0;
+		uint32_t PADDING1 = 0;
+		uint32_t PADDING2 = 0;
+	};
+
+	static const uint32_t CLUSTER_TRIANGLE_COUNT = 128;
+
+	//reorders the triangles so every cluster is a contiguous range, clusters grow over shared vertices
+	//preferring triangles close to the cluster and facing the same way, so the normal cones stay narrow
+	//a cluster ends early where the surface it grows on runs out, triangles inside a cluster are ordered for the vertex cache
+	static void BuildClusters(
+		std::vector<uint32_t>& indices,
+		const std::vector<Vertex>& vertices,
+		std::vector<Cluster>& clusterVec,
+		uint32_t maxTriangleCount = CLUSTER_TRIANGLE_COUNT);
+
+private:
+	static Cluster ComputeClusterBounds(const uint32_t* indices, uint32_t indexCount, const std::vector<Vertex>& vertices);
+};
@@ -0,0 +1,309 @@
+#include "MeshOptimizer.h"
+
+#include <algorithm>
+#include <limits>
+
+void MeshOptimizer::OptimizeVertexCache(
+	std::vector<uint32_t>& indices,
+	uint32_t vertexCount,
+	std::vector<uint32_t>& clusterVec,
+	uint32_t cacheSize)
+{
+	uint32_t triangleCount = static_cast<uint32_t>(indices.size() / 3);
+	clusterVec.clear();
+	if (triangleCount == 0)
+		return;
+
+	//vertex to triangle adjacency, stored as one flat array with an offset per vertex
+	std::vector<uint32_t> liveVec(vertexCount, 0);//triangles not emitted yet, per vertex
+	for (uint32_t index : indices)
+	{
+		liveVec[index]++;
+	}
+	std::vector<uint32_t> offsetVec(vertexCount + 1, 0);
+	for (uint32_t v = 0; v < vertexCount; v++)
+	{
+		offsetVec[v + 1] = offsetVec[v] + liveVec[v];
+	}
+	std::vector<uint32_t> adjacencyVec(indices.size());
+	{
+		std::vector<uint32_t> fillVec(offsetVec.begin(), offsetVec.end() - 1);
+		for (uint32_t i = 0; i < indices.size(); i++)
+		{
+			adjacencyVec[fillVec[indices[i]]++] = i / 3;
+		}
+	}
+
+	std::vector<uint32_t> cacheTimeVec(vertexCount, 0);
+	std::vector<bool> emittedVec(triangleCount, false);
+	std::vector<uint32_t> deadEndVec;//stack of recently referenced vertices
+	std::vector<uint32_t> candidateVec;
+	std::vector<uint32_t> output;
+	output.reserve(indices.size());
+
+	uint32_t timeStamp = cacheSize + 1;
+	uint32_t cursor = 0;//next vertex for the linear scan when we run into a dead end
+	int64_t fanning = indices[0];
+	clusterVec.push_back(0);
+
+	while (fanning >= 0)
+	{
+		//emit all remaining triangles around the fanning vertex
+		candidateVec.clear();
+		uint32_t f = static_cast<uint32_t>(fanning);
+		for (uint32_t a = offsetVec[f]; a < offsetVec[f + 1]; a++)
+		{
+			uint32_t t = adjacencyVec[a];
+			if (emittedVec[t])
+				continue;
+			emittedVec[t] = true;
+			for (uint32_t j = t * 3; j < t * 3 + 3; j++)
+			{
+				uint32_t v = indices[j];
+				output.push_back(v);
+				deadEndVec.push_back(v);
+				candidateVec.push_back(v);
+				liveVec[v]--;
+				if (timeStamp - cacheTimeVec[v] > cacheSize)
+				{
+					cacheTimeVec[v] = timeStamp++;
+				}
+			}
+		}
+
+		//pick the candidate that will still be in the cache after its remaining triangles are emitted, the oldest one wins
+		int64_t next = -1;
+		uint32_t bestPriority = 0;
+		for (uint32_t v : candidateVec)
+		{
+			if (liveVec[v] == 0)
+				continue;
+			uint32_t priority = 1;
+			if (timeStamp - cacheTimeVec[v] + 2 * liveVec[v] <= cacheSize)
+				priority = timeStamp - cacheTimeVec[v];
+			if (next < 0 || priority > bestPriority)
+			{
+				next = v;
+				bestPriority = priority;
+			}
+		}
+
+		if (next < 0)
+		{
+			//dead end, fall back to a recently used vertex and then to the next vertex in input order
+			while (!deadEndVec.empty() && next < 0)
+			{
+				uint32_t v = deadEndVec.back();
+				deadEndVec.pop_back();
+				if (liveVec[v] > 0)
+					next = v;
+			}
+			while (next < 0 && cursor < vertexCount)
+			{
+				if (liveVec[cursor] > 0)
+					next = cursor;
+				cursor++;
+			}
+			if (next >= 0 && output.size() < indices.size())
+				clusterVec.push_back(static_cast<uint32_t>(output.size() / 3));
+		}
+		fanning = next;
+	}
+
+	indices.swap(output);
+}
+
+void MeshOptimizer::OptimizeOverdraw(
+	std::vector<uint32_t>& indices,
+	const std::vector<Vertex>& vertices,
+	const std::vector<uint32_t>& clusterVec,
+	float threshold,
+	uint32_t cacheSize)
+{
+	uint32_t triangleCount = static_cast<uint32_t>(indices.size() / 3);
+	if (triangleCount == 0 || clusterVec.empty())
+		return;
+
+	//soft boundaries, every cluster starts with a cold cache since the clusters are going to be shuffled
+	float maxAcmr = AnalyzeVertexCache(indices, static_cast<uint32_t>(vertices.size()), cacheSize).acmr * threshold;
+	std::vector<uint32_t> splitVec;
+	{
+		std::vector<uint32_t> cacheTimeVec(vertices.size(), 0);
+		uint32_t timeStamp = cacheSize + 1;
+		for (size_t c = 0; c < clusterVec.size(); c++)
+		{
+			uint32_t begin = clusterVec[c];
+			uint32_t end = c + 1 < clusterVec.size() ? clusterVec[c + 1] : triangleCount;
+			uint32_t start = begin;
+			uint32_t missCount = 0;
+			timeStamp += cacheSize + 1;//flush
+			splitVec.push_back(begin);
+			for (uint32_t t = begin; t < end; t++)
+			{
+				for (uint32_t j = t * 3; j < t * 3 + 3; j++)
+				{
+					if (timeStamp - cacheTimeVec[indices[j]] > cacheSize)
+					{
+						cacheTimeVec[indices[j]] = timeStamp++;
+						missCount++;
+					}
+				}
+				if (t + 1 < end && missCount <= maxAcmr * (t + 1 - start))
+				{
+					start = t + 1;
+					missCount = 0;
+					timeStamp += cacheSize + 1;//flush
+					splitVec.push_back(start);
+				}
+			}
+		}
+	}
+
+	glm::dvec3 meshCentroid(0.0);
+	for (const Vertex& vertex : vertices)
+	{
+		meshCentroid += glm::dvec3(vertex.pos);
+	}
+	meshCentroid /= static_cast<double>(std::max<size_t>(vertices.size(), 1));
+
+	//occlusion potential of a cluster, (C - Cmesh) . N, high values face away from the rest of the mesh
+	//and tend to occlude it from most view directions, so they are drawn first
+	struct Cluster
+	{
+		uint32_t begin;
+		uint32_t end;
+		float sortKey;
+	};
+	std::vector<Cluster> clusters(splitVec.size());
+	for (size_t c = 0; c < splitVec.size(); c++)
+	{
+		Cluster& cluster = clusters[c];
+		cluster.begin = splitVec[c];
+		cluster.end = c + 1 < splitVec.size() ? splitVec[c + 1] : triangleCount;
+
+		glm::dvec3 centroid(0.0);
+		glm::dvec3 normal(0.0);
+		double area = 0.0;
+		for (uint32_t t = cluster.begin; t < cluster.end; t++)
+		{
+			glm::dvec3 p0 = vertices[indices[t * 3]].pos;
+			glm::dvec3 p1 = vertices[indices[t * 3 + 1]].pos;
+			glm::dvec3 p2 = vertices[indices[t * 3 + 2]].pos;
+			glm::dvec3 n = glm::cross(p1 - p0, p2 - p0);//length is twice the area
+			double a = glm::length(n);
+			centroid += (p0 + p1 + p2) * (a / 3.0);
+			normal += n;
+			area += a;
+		}
+		if (area > 0.0)
+			centroid /= area;
+		double normalLength = glm::length(normal);
+		if (normalLength > 0.0)
+			normal /= normalLength;
+		cluster.sortKey = static_cast<float>(glm::dot(centroid - meshCentroid, normal));
+	}
+
+	std::stable_sort(clusters.begin(), clusters.end(), [](const Cluster& a, const Cluster& b)
+	{
+		return a.sortKey > b.sortKey;
+	});
+
+	std::vector<uint32_t> output;
+	output.reserve(indices.size());
+	for (const Cluster& cluster : clusters)
+	{
+		output.insert(output.end(), indices.begin() + cluster.begin * 3, indices.begin() + cluster.end * 3);
+	}
+	indices.swap(output);
+}
+
+void MeshOptimizer::OptimizeVertexFetch(std::vector<uint32_t>& indices, std::vector<Vertex>& vertices)
+{
+	const uint32_t unused = ~0u;
+	std::vector<uint32_t> remapVec(vertices.size(), unused);
+	std::vector<Vertex> output;
+	output.reserve(vertices.size());
+
+	for (uint32_t& index : indices)
+	{
+		if (remapVec[index] == unused)
+		{
+			remapVec[index] = static_cast<uint32_t>(output.size());
+			output.push_back(vertices[index]);
+		}
+		index = remapVec[index];
+	}
+
+	//unreferenced vertices are dropped
+	vertices.swap(output);
+}
+
+MeshOptimizer::VertexCacheStats MeshOptimizer::AnalyzeVertexCache(
+	const std::vector<uint32_t>& indices,
+	uint32_t vertexCount,
+	uint32_t cacheSize)
+{
+	VertexCacheStats stats;
+	if (indices.empty() || vertexCount == 0)
+		return stats;
+
+	std::vector<uint32_t> cacheTimeVec(vertexCount, 0);
+	uint32_t timeStamp = cacheSize + 1;
+	uint64_t missCount = 0;
+	for (uint32_t index : indices)
+	{
+		if (timeStamp - cacheTimeVec[index] > cacheSize)
+		{
+			cacheTimeVec[index] = timeStamp++;
+			missCount++;
+		}
+	}
+
+	stats.acmr = static_cast<float>(static_cast<double>(missCount) / (indices.size() / 3));
+	stats.atvr = static_cast<float>(static_cast<double>(missCount) / vertexCount);
+	return stats;
+}
+
+bool MeshOptimizer::SplitIndexRanges(const uint32_t* indexData, uint32_t count, uint32_t maxIndex, uint32_t maxRangeCount, std::vector<IndexRange>& rangeVec)
+{
+	std::vector<IndexRange> rangeVecTemp;
+	IndexRange range;
+	uint32_t minVertex = std::numeric_limits<uint32_t>::max();
+	uint32_t maxVertex = 0;
+	for (uint32_t i = 0; i + 2 < count; i += 3)
+	{
+		uint32_t triangleMin = std::min({ indexData[i], indexData[i + 1], indexData[i + 2] });
+		uint32_t triangleMax = std::max({ indexData[i], indexData[i + 1], indexData[i + 2] });
+		//no cut helps a triangle that does not fit on its own
+		if (triangleMax - triangleMin > maxIndex)
+			return false;
+
+		uint32_t newMin = std::min(minVertex, triangleMin);
+		uint32_t newMax = std::max(maxVertex, triangleMax);
+		if (newMax - newMin > maxIndex)
+		{
+			//the range holds at least one triangle here, the first triangle of a range always fits
+			range.indexCount = i - range.firstIndex;
+			range.vertexOffset = static_cast<int32_t>(minVertex);
+			rangeVecTemp.push_back(range);
+			if (rangeVecTemp.size() >= maxRangeCount)
+				return false;
+
+			range.firstIndex = i;
+			newMin = triangleMin;
+			newMax = triangleMax;
+		}
+		minVertex = newMin;
+		maxVertex = newMax;
+	}
+
+	//an empty list has no ranges at all
+	range.indexCount = count - range.firstIndex;
+	if (range.indexCount > 0)
+	{
+		range.vertexOffset = static_cast<int32_t>(minVertex);
+		rangeVecTemp.push_back(range);
+	}
+	rangeVec = std::move(rangeVecTemp);
+	return true;
+}
@@ -0,0 +1,61 @@
+#pragma once
+
+#include "GlobalInclude.h"
+
+//triangle and vertex reordering for indexed triangle lists
+class MeshOptimizer
+{
+public:
+	struct VertexCacheStats
+	{
+		float acmr = 0.0f;//average cache miss ratio, vertex shader invocations per triangle, 0.5 is the ideal for a regular grid
+		float atvr = 0.0f;//average transformed vertex ratio, vertex shader invocations per vertex, 1.0 is the ideal
+	};
+
+	//a range of an index list drawn with one draw call, its indices are relative to vertexOffset
+	struct IndexRange
+	{
+		uint32_t firstIndex = 0;
+		uint32_t indexCount = 0;
+		int32_t vertexOffset = 0;
+	};
+
+	//the fifo size we optimize and report for, a conservative guess for current hardware
+	static const uint32_t VERTEX_CACHE_SIZE = 16;
+
+	//Tipsify (Sander, Nehab and Barczak 2007), reorders triangles for post-transform cache locality in linear time
+	//clusterVec receives the first triangle of every cluster, a new cluster starts wherever the walk had to jump
+	static void OptimizeVertexCache(
+		std::vector<uint32_t>& indices,
+		uint32_t vertexCount,
+		std::vector<uint32_t>& clusterVec,
+		uint32_t cacheSize = VERTEX_CACHE_SIZE);
+
+	//splits the clusters from OptimizeVertexCache further wherever the acmr of a cluster(with a cold cache) is within threshold of the whole mesh,
+	//then sorts the clusters so that outward facing clusters come first, triangles inside a cluster keep their order
+	static void OptimizeOverdraw(
+		std::vector<uint32_t>& indices,
+		const std::vector<Vertex>& vertices,
+		const std::vector<uint32_t>& clusterVec,
+		float threshold = 1.05f,
+		uint32_t cacheSize = VERTEX_CACHE_SIZE);
+
+	//renumbers vertices in the order they are first referenced so vertex fetch walks memory linearly
+	static void OptimizeVertexFetch(std::vector<uint32_t>& indices, std::vector<Vertex>& vertices);
+
+	//greedily cuts the triangle list wherever the vertices referenced since the last cut would span more than maxIndex,
+	//vertex fetch optimization numbers vertices in the order they are first used, so consecutive triangles reference nearby vertices,
+	//returns false when a single triangle spans more than maxIndex or the list would need more than maxRangeCount ranges
+	static bool SplitIndexRanges(
+		const uint32_t* indexData,
+		uint32_t count,
+		uint32_t maxIndex,
+		uint32_t maxRangeCount,
+		std::vector<IndexRange>& rangeVec);
+
+	//simulates a fifo post-transform cache
+	static VertexCacheStats AnalyzeVertexCache(
+		const std::vector<uint32_t>& indices,
+		uint32_t vertexCount,
+		uint32_t cacheSize = VERTEX_CACHE_SIZE);
+};
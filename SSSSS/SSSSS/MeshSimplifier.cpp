@@ -0,0 +1,304 @@
+#include "MeshSimplifier.h"
+
+#include <algorithm>
+#include <numeric>
+#include <limits>
+#include <cmath>
+#include <tuple>
+
+void MeshSimplifier::Quadric::AddPlane(const glm::dvec3& normal, double distance, double planeWeight)
+{
+	a00 += planeWeight * normal.x * normal.x;
+	a01 += planeWeight * normal.x * normal.y;
+	a02 += planeWeight * normal.x * normal.z;
+	a11 += planeWeight * normal.y * normal.y;
+	a12 += planeWeight * normal.y * normal.z;
+	a22 += planeWeight * normal.z * normal.z;
+	b0 += planeWeight * normal.x * distance;
+	b1 += planeWeight * normal.y * distance;
+	b2 += planeWeight * normal.z * distance;
+	c += planeWeight * distance * distance;
+	weight += planeWeight;
+}
+
+void MeshSimplifier::Quadric::Add(const Quadric& other)
+{
+	a00 += other.a00;
+	a01 += other.a01;
+	a02 += other.a02;
+	a11 += other.a11;
+	a12 += other.a12;
+	a22 += other.a22;
+	b0 += other.b0;
+	b1 += other.b1;
+	b2 += other.b2;
+	c += other.c;
+	weight += other.weight;
+}
+
+double MeshSimplifier::Quadric::Evaluate(const glm::dvec3& p) const
+{
+	double rx = a00 * p.x + a01 * p.y + a02 * p.z;
+	double ry = a01 * p.x + a11 * p.y + a12 * p.z;
+	double rz = a02 * p.x + a12 * p.y + a22 * p.z;
+	return rx * p.x + ry * p.y + rz * p.z + 2.0 * (b0 * p.x + b1 * p.y + b2 * p.z) + c;
+}
+
+static inline uint64_t EdgeKey(uint32_t a, uint32_t b)
+{
+	return a < b ? (static_cast<uint64_t>(a) << 32) | b : (static_cast<uint64_t>(b) << 32) | a;
+}
+
+float MeshSimplifier::Simplify(
+	const std::vector<uint32_t>& indices,
+	const std::vector<Vertex>& vertices,
+	uint32_t targetIndexCount,
+	float maxError,
+	std::vector<uint32_t>& result)
+{
+	uint32_t vertexCount = static_cast<uint32_t>(vertices.size());
+
+	//vertices with the same position are one point of the surface, they only differ in their attributes(a uv or normal seam)
+	std::vector<uint32_t> pointVec(vertexCount);
+	std::vector<glm::dvec3> pointPositionVec;
+	std::vector<uint32_t> wedgeCountVec;
+	{
+		std::vector<uint32_t> order(vertexCount);
+		std::iota(order.begin(), order.end(), 0);
+		std::sort(order.begin(), order.end(), [&](uint32_t a, uint32_t b)
+		{
+			const glm::vec3& pa = vertices[a].pos;
+			const glm::vec3& pb = vertices[b].pos;
+			return std::tie(pa.x, pa.y, pa.z) < std::tie(pb.x, pb.y, pb.z);
+		});
+		for (uint32_t i = 0; i < vertexCount; i++)
+		{
+			if (i == 0 || vertices[order[i]].pos != vertices[order[i - 1]].pos)
+			{
+				pointPositionVec.push_back(glm::dvec3(vertices[order[i]].pos));
+				wedgeCountVec.push_back(0);
+			}
+			pointVec[order[i]] = static_cast<uint32_t>(pointPositionVec.size() - 1);
+			wedgeCountVec.back()++;
+		}
+	}
+	uint32_t pointCount = static_cast<uint32_t>(pointPositionVec.size());
+
+	//quadrics of the planes of all triangles around a point, weighted by area
+	std::vector<Quadric> quadricVec(pointCount);
+	for (size_t i = 0; i + 2 < indices.size(); i += 3)
+	{
+		const glm::dvec3& p0 = pointPositionVec[pointVec[indices[i]]];
+		const glm::dvec3& p1 = pointPositionVec[pointVec[indices[i + 1]]];
+		const glm::dvec3& p2 = pointPositionVec[pointVec[indices[i + 2]]];
+		glm::dvec3 normal = glm::cross(p1 - p0, p2 - p0);
+		double length = glm::length(normal);
+		if (length == 0.0)
+			continue;
+		normal /= length;
+		for (size_t j = i; j < i + 3; j++)
+		{
+			quadricVec[pointVec[indices[j]]].AddPlane(normal, -glm::dot(normal, p0), length * 0.5);
+		}
+	}
+
+	//an edge used by one triangle is a border, one used by more than two is non-manifold,
+	//border points only slide along borders and points on seams or non-manifold edges are never removed
+	std::vector<uint64_t> borderEdgeVec;
+	std::vector<bool> borderVec(pointCount, false);
+	std::vector<bool> lockedVec(pointCount, false);
+	for (uint32_t p = 0; p < pointCount; p++)
+	{
+		lockedVec[p] = wedgeCountVec[p] > 1;
+	}
+	{
+		std::vector<std::pair<uint64_t, uint32_t>> edgeVec;//edge key and the corner the edge starts at
+		edgeVec.reserve(indices.size());
+		for (uint32_t i = 0; i + 2 < indices.size(); i += 3)
+		{
+			for (uint32_t k = 0; k < 3; k++)
+			{
+				uint32_t a = pointVec[indices[i + k]];
+				uint32_t b = pointVec[indices[i + (k + 1) % 3]];
+				if (a != b)
+					edgeVec.push_back({ EdgeKey(a, b), i + k });
+			}
+		}
+		std::sort(edgeVec.begin(), edgeVec.end());
+
+		for (size_t begin = 0, end = 0; begin < edgeVec.size(); begin = end)
+		{
+			while (end < edgeVec.size() && edgeVec[end].first == edgeVec[begin].first)
+				end++;
+
+			uint32_t a = static_cast<uint32_t>(edgeVec[begin].first >> 32);
+			uint32_t b = static_cast<uint32_t>(edgeVec[begin].first & 0xFFFFFFFF);
+			if (end - begin > 2)
+			{
+				lockedVec[a] = lockedVec[b] = true;
+			}
+			else if (end - begin == 1)
+			{
+				//a plane through the edge, perpendicular to its triangle
+				uint32_t corner = edgeVec[begin].second;
+				uint32_t triangle = corner - corner % 3;
+				const glm::dvec3& p0 = pointPositionVec[pointVec[indices[triangle]]];
+				const glm::dvec3& p1 = pointPositionVec[pointVec[indices[triangle + 1]]];
+				const glm::dvec3& p2 = pointPositionVec[pointVec[indices[triangle + 2]]];
+				glm::dvec3 edge = pointPositionVec[b] - pointPositionVec[a];
+				glm::dvec3 normal = glm::cross(glm::cross(p1 - p0, p2 - p0), edge);
+				double length = glm::length(normal);
+				if (length > 0.0)
+				{
+					normal /= length;
+					double planeWeight = glm::dot(edge, edge) * BORDER_WEIGHT;
+					quadricVec[a].AddPlane(normal, -glm::dot(normal, pointPositionVec[a]), planeWeight);
+					quadricVec[b].AddPlane(normal, -glm::dot(normal, pointPositionVec[a]), planeWeight);
+				}
+				borderEdgeVec.push_back(edgeVec[begin].first);
+				borderVec[a] = borderVec[b] = true;
+			}
+		}
+	}
+
+	auto GetCollapseError = [&](uint32_t fromPoint, uint32_t toPoint)
+	{
+		Quadric quadric = quadricVec[fromPoint];
+		quadric.Add(quadricVec[toPoint]);
+		double error = quadric.weight > 0.0 ? quadric.Evaluate(pointPositionVec[toPoint]) / quadric.weight : 0.0;
+		return static_cast<float>(std::sqrt(std::max(error, 0.0)));
+	};
+
+	auto CanCollapse = [&](uint32_t fromPoint, uint32_t toPoint)
+	{
+		if (lockedVec[fromPoint])
+			return false;
+		return !borderVec[fromPoint] || std::binary_search(borderEdgeVec.begin(), borderEdgeVec.end(), EdgeKey(fromPoint, toPoint));
+	};
+
+	std::vector<uint32_t> triangleVec(indices.begin(), indices.end());
+	std::vector<uint32_t> collapseVec(vertexCount);
+	std::vector<bool> touchedVec(pointCount);
+	std::vector<uint32_t> adjacencyOffsetVec(pointCount + 1);
+	std::vector<uint32_t> adjacencyVec;
+	std::vector<Collapse> candidateVec;
+	float worstError = 0.0f;
+
+	//every pass collapses the cheapest edges whose fans were not touched by an earlier collapse of the same pass
+	while (triangleVec.size() > targetIndexCount)
+	{
+		//point to triangle adjacency
+		std::fill(adjacencyOffsetVec.begin(), adjacencyOffsetVec.end(), 0);
+		for (uint32_t index : triangleVec)
+		{
+			adjacencyOffsetVec[pointVec[index] + 1]++;
+		}
+		for (uint32_t p = 0; p < pointCount; p++)
+		{
+			adjacencyOffsetVec[p + 1] += adjacencyOffsetVec[p];
+		}
+		adjacencyVec.resize(triangleVec.size());
+		{
+			std::vector<uint32_t> fillVec(adjacencyOffsetVec.begin(), adjacencyOffsetVec.end() - 1);
+			for (uint32_t i = 0; i < triangleVec.size(); i++)
+			{
+				adjacencyVec[fillVec[pointVec[triangleVec[i]]]++] = i / 3;
+			}
+		}
+
+		candidateVec.clear();
+		for (uint32_t i = 0; i < triangleVec.size(); i++)
+		{
+			uint32_t a = triangleVec[i];
+			uint32_t b = triangleVec[i - i % 3 + (i % 3 + 1) % 3];
+			uint32_t pa = pointVec[a];
+			uint32_t pb = pointVec[b];
+			bool forward = CanCollapse(pa, pb);
+			bool backward = CanCollapse(pb, pa);
+			float forwardError = forward ? GetCollapseError(pa, pb) : 0.0f;
+			float backwardError = backward ? GetCollapseError(pb, pa) : 0.0f;
+			if (forward && (!backward || forwardError <= backwardError))
+				candidateVec.push_back({ a, b, forwardError });
+			else if (backward)
+				candidateVec.push_back({ b, a, backwardError });
+		}
+		if (candidateVec.empty())
+			break;
+
+		std::sort(candidateVec.begin(), candidateVec.end(), [](const Collapse& a, const Collapse& b) { return a.cost < b.cost; });
+
+		std::iota(collapseVec.begin(), collapseVec.end(), 0);
+		std::fill(touchedVec.begin(), touchedVec.end(), false);
+		size_t triangleRemoveCount = (triangleVec.size() - targetIndexCount + 2) / 3;
+		size_t triangleRemovedCount = 0;
+		for (const Collapse& collapse : candidateVec)
+		{
+			if (collapse.cost > maxError || triangleRemovedCount >= triangleRemoveCount)
+				break;
+
+			uint32_t fromPoint = pointVec[collapse.from];
+			uint32_t toPoint = pointVec[collapse.to];
+			if (touchedVec[fromPoint] || touchedVec[toPoint])
+				continue;
+
+			//reject collapses that flip a triangle around the removed point
+			size_t degenerateCount = 0;
+			bool flipped = false;
+			for (uint32_t a = adjacencyOffsetVec[fromPoint]; a < adjacencyOffsetVec[fromPoint + 1] && !flipped; a++)
+			{
+				uint32_t t = adjacencyVec[a] * 3;
+				glm::dvec3 before[3];
+				glm::dvec3 after[3];
+				bool degenerate = false;
+				for (uint32_t k = 0; k < 3; k++)
+				{
+					uint32_t p = pointVec[triangleVec[t + k]];
+					degenerate = degenerate || p == toPoint;
+					before[k] = pointPositionVec[p];
+					after[k] = p == fromPoint ? pointPositionVec[toPoint] : before[k];
+				}
+				if (degenerate)
+				{
+					degenerateCount++;
+					continue;
+				}
+				glm::dvec3 normalBefore = glm::cross(before[1] - before[0], before[2] - before[0]);
+				glm::dvec3 normalAfter = glm::cross(after[1] - after[0], after[2] - after[0]);
+				flipped = glm::dot(normalBefore, normalAfter) <= 0.0;
+			}
+			if (flipped)
+				continue;
+
+			collapseVec[collapse.from] = collapse.to;
+			quadricVec[toPoint].Add(quadricVec[fromPoint]);
+			//the flip test above assumed the other points of the fan stay where they are
+			for (uint32_t a = adjacencyOffsetVec[fromPoint]; a < adjacencyOffsetVec[fromPoint + 1]; a++)
+			{
+				uint32_t t = adjacencyVec[a] * 3;
+				touchedVec[pointVec[triangleVec[t]]] = touchedVec[pointVec[triangleVec[t + 1]]] = touchedVec[pointVec[triangleVec[t + 2]]] = true;
+			}
+			worstError = std::max(worstError, collapse.cost);
+			triangleRemovedCount += degenerateCount;
+		}
+		if (triangleRemovedCount == 0)
+			break;
+
+		//apply the collapses and drop the triangles that became degenerate
+		size_t writeOffset = 0;
+		for (size_t i = 0; i + 2 < triangleVec.size(); i += 3)
+		{
+			uint32_t v0 = collapseVec[triangleVec[i]];
+			uint32_t v1 = collapseVec[triangleVec[i + 1]];
+			uint32_t v2 = collapseVec[triangleVec[i + 2]];
+			if (pointVec[v0] == pointVec[v1] || pointVec[v1] == pointVec[v2] || pointVec[v2] == pointVec[v0])
+				continue;
+			triangleVec[writeOffset++] = v0;
+			triangleVec[writeOffset++] = v1;
+			triangleVec[writeOffset++] = v2;
+		}
+		triangleVec.resize(writeOffset);
+	}
+
+	result = std::move(triangleVec);
+	return worstError;
+}
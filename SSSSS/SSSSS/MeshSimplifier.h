@@ -0,0 +1,42 @@
+#pragma once
+
+#include "GlobalInclude.h"
+
+//edge collapse simplification of indexed triangle lists driven by quadric error metrics (Garland and Heckbert 1997)
+class MeshSimplifier
+{
+public:
+	//collapses edges until the triangle list has at most targetIndexCount indices or the next collapse would exceed maxError,
+	//vertices are never moved or added, so the result indexes the same vertex array as the source,
+	//returns the error of the worst collapse as a distance in the units of the vertex positions
+	static float Simplify(
+		const std::vector<uint32_t>& indices,
+		const std::vector<Vertex>& vertices,
+		uint32_t targetIndexCount,
+		float maxError,
+		std::vector<uint32_t>& result);
+
+private:
+	//symmetric 4x4 matrix, the error of a position p is p^T A p + 2 b^T p + c
+	struct Quadric
+	{
+		double a00 = 0.0, a01 = 0.0, a02 = 0.0, a11 = 0.0, a12 = 0.0, a22 = 0.0;
+		double b0 = 0.0, b1 = 0.0, b2 = 0.0;
+		double c = 0.0;
+		double weight = 0.0;
+
+		void AddPlane(const glm::dvec3& normal, double distance, double planeWeight);
+		void Add(const Quadric& other);
+		double Evaluate(const glm::dvec3& p) const;
+	};
+
+	struct Collapse
+	{
+		uint32_t from;//position of the removed vertex
+		uint32_t to;//vertex index the removed vertex is replaced with
+		float cost;
+	};
+
+	//border vertices are weighted this much stronger so open boundaries keep their shape
+	static constexpr double BORDER_WEIGHT = 10.0;
+};
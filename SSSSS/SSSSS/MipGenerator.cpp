@@ -0,0 +1,214 @@
+#include "MipGenerator.h"
+
+#include <cmath>
+#include <cstring>
+#include <algorithm>
+#include <emmintrin.h>
+
+uint64_t MipGenerator::GetLevelLayout(uint32_t width, uint32_t height, uint32_t mipLevels, std::vector<Level>& levelVec)
+{
+	levelVec.resize(mipLevels);
+	uint64_t offset = 0;
+	for (uint32_t i = 0; i < mipLevels; i++)
+	{
+		levelVec[i].offset = offset;
+		levelVec[i].width = std::max(1u, width >> i);
+		levelVec[i].height = std::max(1u, height >> i);
+		offset += static_cast<uint64_t>(levelVec[i].width) * levelVec[i].height * 4;
+	}
+	return offset;
+}
+
+void MipGenerator::GenerateMips(uint8_t* data, const std::vector<Level>& levelVec, Filter filter, Wrap wrap)
+{
+	for (size_t i = 1; i < levelVec.size(); i++)
+	{
+		const Level& sourceLevel = levelVec[i - 1];
+		const Level& destinationLevel = levelVec[i];
+		//the common case of a box filter halving both sides has a fast path
+		if (filter == Filter::Box && sourceLevel.width == destinationLevel.width * 2 && sourceLevel.height == destinationLevel.height * 2)
+		{
+			Downsample2x2(data + sourceLevel.offset, sourceLevel, data + destinationLevel.offset, destinationLevel);
+		}
+		else
+		{
+			DownsampleSeparable(data + sourceLevel.offset, sourceLevel, data + destinationLevel.offset, destinationLevel, filter, wrap);
+		}
+	}
+}
+
+//averages 2x2 blocks in 16 bit lanes, 4 destination pixels per iteration
+void MipGenerator::Downsample2x2(const uint8_t* source, const Level& sourceLevel, uint8_t* destination, const Level& destinationLevel)
+{
+	const __m128i zero = _mm_setzero_si128();
+	const __m128i rounding = _mm_set1_epi16(2);
+	size_t sourcePitch = static_cast<size_t>(sourceLevel.width) * 4;
+	for (uint32_t y = 0; y < destinationLevel.height; y++)
+	{
+		const uint8_t* row0 = source + sourcePitch * (y * 2);
+		const uint8_t* row1 = row0 + sourcePitch;
+		uint8_t* out = destination + static_cast<size_t>(destinationLevel.width) * 4 * y;
+		uint32_t x = 0;
+		for (; x + 4 <= destinationLevel.width; x += 4)
+		{
+			//8 source pixels per row
+			__m128i a0 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(row0 + x * 8));
+			__m128i a1 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(row0 + x * 8 + 16));
+			__m128i b0 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(row1 + x * 8));
+			__m128i b1 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(row1 + x * 8 + 16));
+
+			//vertical sums, low and high pixel pairs of each register
+			__m128i sum0 = _mm_add_epi16(_mm_unpacklo_epi8(a0, zero), _mm_unpacklo_epi8(b0, zero));
+			__m128i sum1 = _mm_add_epi16(_mm_unpackhi_epi8(a0, zero), _mm_unpackhi_epi8(b0, zero));
+			__m128i sum2 = _mm_add_epi16(_mm_unpacklo_epi8(a1, zero), _mm_unpacklo_epi8(b1, zero));
+			__m128i sum3 = _mm_add_epi16(_mm_unpackhi_epi8(a1, zero), _mm_unpackhi_epi8(b1, zero));
+
+			//horizontal sums, each register holds two neighbouring pixels as 2x4 16 bit lanes
+			__m128i pair0 = _mm_add_epi16(_mm_unpacklo_epi64(sum0, sum1), _mm_unpackhi_epi64(sum0, sum1));
+			__m128i pair1 = _mm_add_epi16(_mm_unpacklo_epi64(sum2, sum3), _mm_unpackhi_epi64(sum2, sum3));
+			pair0 = _mm_srli_epi16(_mm_add_epi16(pair0, rounding), 2);
+			pair1 = _mm_srli_epi16(_mm_add_epi16(pair1, rounding), 2);
+			_mm_storeu_si128(reinterpret_cast<__m128i*>(out + x * 4), _mm_packus_epi16(pair0, pair1));
+		}
+		for (; x < destinationLevel.width; x++)
+		{
+			for (uint32_t c = 0; c < 4; c++)
+			{
+				uint32_t sum = row0[x * 8 + c] + row0[x * 8 + 4 + c] + row1[x * 8 + c] + row1[x * 8 + 4 + c];
+				out[x * 4 + c] = static_cast<uint8_t>((sum + 2) >> 2);
+			}
+		}
+	}
+}
+
+//horizontal then vertical pass through a float image, one rgba pixel per sse register
+void MipGenerator::DownsampleSeparable(const uint8_t* source, const Level& sourceLevel, uint8_t* destination, const Level& destinationLevel, Filter filter, Wrap wrap)
+{
+	std::vector<Taps> horizontalTapsVec;
+	std::vector<float> horizontalWeightVec;
+	std::vector<Taps> verticalTapsVec;
+	std::vector<float> verticalWeightVec;
+	BuildTaps(sourceLevel.width, destinationLevel.width, filter, horizontalTapsVec, horizontalWeightVec);
+	BuildTaps(sourceLevel.height, destinationLevel.height, filter, verticalTapsVec, verticalWeightVec);
+
+	auto address = [wrap](int32_t i, uint32_t size)
+	{
+		int32_t n = static_cast<int32_t>(size);
+		if (wrap == Wrap::Repeat)
+			return static_cast<uint32_t>(((i % n) + n) % n);
+		return static_cast<uint32_t>(std::min(std::max(i, 0), n - 1));
+	};
+
+	//horizontal pass, sourceHeight rows of destinationWidth pixels with 4 float channels each
+	std::vector<float> horizontal(static_cast<size_t>(destinationLevel.width) * sourceLevel.height * 4);
+	const __m128i zero = _mm_setzero_si128();
+	for (uint32_t y = 0; y < sourceLevel.height; y++)
+	{
+		const uint8_t* row = source + static_cast<size_t>(sourceLevel.width) * 4 * y;
+		for (uint32_t x = 0; x < destinationLevel.width; x++)
+		{
+			const Taps& taps = horizontalTapsVec[x];
+			__m128 sum = _mm_setzero_ps();
+			for (uint32_t t = 0; t < taps.count; t++)
+			{
+				uint32_t sx = address(taps.source + static_cast<int32_t>(t), sourceLevel.width);
+				int32_t packed;
+				memcpy(&packed, row + sx * 4, sizeof(packed));
+				__m128i pixel = _mm_unpacklo_epi16(_mm_unpacklo_epi8(_mm_cvtsi32_si128(packed), zero), zero);
+				sum = _mm_add_ps(sum, _mm_mul_ps(_mm_cvtepi32_ps(pixel), _mm_set1_ps(horizontalWeightVec[taps.first + t])));
+			}
+			_mm_storeu_ps(horizontal.data() + (static_cast<size_t>(destinationLevel.width) * y + x) * 4, sum);
+		}
+	}
+
+	//vertical pass, negative lobes of the kaiser filter can leave the 0-255 range, packing saturates
+	const __m128 half = _mm_set1_ps(0.5f);
+	for (uint32_t y = 0; y < destinationLevel.height; y++)
+	{
+		const Taps& taps = verticalTapsVec[y];
+		uint8_t* out = destination + static_cast<size_t>(destinationLevel.width) * 4 * y;
+		for (uint32_t x = 0; x < destinationLevel.width; x++)
+		{
+			__m128 sum = _mm_setzero_ps();
+			for (uint32_t t = 0; t < taps.count; t++)
+			{
+				uint32_t sy = address(taps.source + static_cast<int32_t>(t), sourceLevel.height);
+				__m128 pixel = _mm_loadu_ps(horizontal.data() + (static_cast<size_t>(destinationLevel.width) * sy + x) * 4);
+				sum = _mm_add_ps(sum, _mm_mul_ps(pixel, _mm_set1_ps(verticalWeightVec[taps.first + t])));
+			}
+			__m128i pixel = _mm_cvttps_epi32(_mm_add_ps(_mm_max_ps(sum, _mm_setzero_ps()), half));
+			pixel = _mm_packs_epi32(pixel, pixel);
+			pixel = _mm_packus_epi16(pixel, pixel);
+			int32_t packed = _mm_cvtsi128_si32(pixel);
+			memcpy(out + x * 4, &packed, sizeof(packed));
+		}
+	}
+}
+
+//weights are normalized per destination pixel, so the filters keep the average brightness at every size
+void MipGenerator::BuildTaps(uint32_t sourceSize, uint32_t destinationSize, Filter filter, std::vector<Taps>& tapsVec, std::vector<float>& weightVec)
+{
+	float scale = static_cast<float>(sourceSize) / static_cast<float>(destinationSize);
+	tapsVec.resize(destinationSize);
+	weightVec.clear();
+	for (uint32_t i = 0; i < destinationSize; i++)
+	{
+		Taps& taps = tapsVec[i];
+		taps.first = static_cast<uint32_t>(weightVec.size());
+		float begin = i * scale;
+		float end = (i + 1) * scale;
+		if (filter == Filter::Box)
+		{
+			//area coverage of every source pixel under the destination pixel
+			taps.source = static_cast<int32_t>(std::floor(begin));
+			int32_t last = std::min(static_cast<int32_t>(std::ceil(end)), static_cast<int32_t>(sourceSize)) - 1;
+			for (int32_t s = taps.source; s <= last; s++)
+			{
+				weightVec.push_back(std::min(end, s + 1.0f) - std::max(begin, static_cast<float>(s)));
+			}
+		}
+		else
+		{
+			float center = (begin + end) * 0.5f;
+			float radius = KAISER_WIDTH * scale;
+			taps.source = static_cast<int32_t>(std::floor(center - radius));
+			int32_t last = static_cast<int32_t>(std::ceil(center + radius));
+			for (int32_t s = taps.source; s <= last; s++)
+			{
+				weightVec.push_back(Kaiser((s + 0.5f - center) / scale));
+			}
+		}
+		taps.count = static_cast<uint32_t>(weightVec.size()) - taps.first;
+
+		float total = 0.0f;
+		for (uint32_t t = 0; t < taps.count; t++)
+			total += weightVec[taps.first + t];
+		for (uint32_t t = 0; t < taps.count; t++)
+			weightVec[taps.first + t] /= total;
+	}
+}
+
+//sinc(x) times a kaiser window of KAISER_WIDTH, x in destination pixels
+float MipGenerator::Kaiser(float x)
+{
+	auto besselI0 = [](float value)
+	{
+		//power series, converges fast for the arguments of the window
+		float sum = 1.0f;
+		float term = 1.0f;
+		float quarter = value * value * 0.25f;
+		for (int k = 1; k < 20; k++)
+		{
+			term *= quarter / static_cast<float>(k * k);
+			sum += term;
+		}
+		return sum;
+	};
+
+	float t = x / KAISER_WIDTH;
+	if (std::abs(t) >= 1.0f)
+		return 0.0f;
+
+	float sinc = std::abs(x) < 1e-6f ? 1.0f : std::sin(glm::pi<float>() * x) / (glm::pi<float>() * x);
+	return sinc * besselI0(KAISER_ALPHA * std::sqrt(1.0f - t * t)) / besselI0(KAISER_ALPHA);
+}
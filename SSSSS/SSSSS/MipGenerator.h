@@ -0,0 +1,43 @@
+#pragma once
+
+#include "GlobalInclude.h"
+
+//cpu mip chains for rgba8 images, every level is filtered from the level above it with sse2,
+//level sizes follow vulkan(max(1, size >> level)) so the levels can be copied straight into a mipmapped image
+class MipGenerator
+{
+public:
+	enum class Filter { Box, Kaiser };
+	enum class Wrap { Clamp, Repeat };//how the kaiser filter reads beyond the edges
+
+	struct Level
+	{
+		uint64_t offset;//in bytes from level 0
+		uint32_t width;
+		uint32_t height;
+	};
+
+	//where each level starts when all levels are packed one after another, returns the size of all levels together
+	static uint64_t GetLevelLayout(uint32_t width, uint32_t height, uint32_t mipLevels, std::vector<Level>& levelVec);
+
+	//level 0 must already be in data, the other levels of levelVec are written after it
+	static void GenerateMips(uint8_t* data, const std::vector<Level>& levelVec, Filter filter, Wrap wrap);
+
+private:
+	//kaiser windowed sinc, the settings of most offline texture tools
+	static constexpr float KAISER_WIDTH = 3.0f;//in destination pixels
+	static constexpr float KAISER_ALPHA = 4.0f;
+
+	//taps of one destination pixel along one axis
+	struct Taps
+	{
+		uint32_t first;//index into the weight array
+		uint32_t count;
+		int32_t source;//first source pixel, may lie outside the image
+	};
+
+	static void Downsample2x2(const uint8_t* source, const Level& sourceLevel, uint8_t* destination, const Level& destinationLevel);
+	static void DownsampleSeparable(const uint8_t* source, const Level& sourceLevel, uint8_t* destination, const Level& destinationLevel, Filter filter, Wrap wrap);
+	static void BuildTaps(uint32_t sourceSize, uint32_t destinationSize, Filter filter, std::vector<Taps>& tapsVec, std::vector<float>& weightVec);
+	static float Kaiser(float x);
+};
@@ -4,6 +4,7 @@
 #include "Texture.h"
 #include "Mesh.h"
 #include "Renderer.h"
+#include "ThreadPool.h"
 
 Pass::Pass(const std::string& _name, 
 	bool _clearColor, 
@@ -25,7 +26,11 @@ Pass::Pass(const std::string& _name,
 	depthFailOp(_depthFailOp),
 	stencilFailOp(_stencilFailOp),
 	stencilPassOp(_stencilPassOp),
-	stencilReference(_stencilReference)
+	stencilReference(_stencilReference),
+	lodPolicy(LodPolicy::Fixed),
+	fixedLod(0),
+	maxPixelError(1.0f),
+	clusterCulling(ClusterCulling::FrustumAndCone)
 {
 	for (auto& pShader : pShaderArr)
 		pShader = nullptr;
@@ -159,6 +164,16 @@ uint32_t Pass::GetTextureCount() const
 	return static_cast<uint32_t>(pTextureVec.size());
 }
 
+bool Pass::IsUploadComplete() const
+{
+	for (const Texture* pTexture : pTextureVec)
+	{
+		if (!pTexture->IsUploadComplete())
+			return false;
+	}
+	return true;
+}
+
 uint32_t Pass::GetUboCount() const
 {
 	return pUboCount;
@@ -174,11 +189,179 @@ const std::vector<Mesh*>& Pass::GetMeshVec() const
 	return pMeshVec;
 }
 
+VERTEX_FORMAT Pass::GetVertexFormat() const
+{
+	if (pMeshVec.empty())
+		return VERTEX_FORMAT::Standard;
+
+	VERTEX_FORMAT vertexFormat = pMeshVec[0]->GetVertexFormat();
+	for (auto pMesh : pMeshVec)
+	{
+		if (pMesh->GetVertexFormat() != vertexFormat)
+			throw std::runtime_error("pass " + name + " : meshes with different vertex formats!");
+	}
+	return vertexFormat;
+}
+
+bool Pass::IsVertexStreamSplit() const
+{
+	if (pMeshVec.empty())
+		return false;
+
+	bool splitVertexStreams = pMeshVec[0]->IsVertexStreamSplit();
+	for (auto pMesh : pMeshVec)
+	{
+		if (pMesh->IsVertexStreamSplit() != splitVertexStreams)
+			throw std::runtime_error("pass " + name + " : meshes with different vertex stream layouts!");
+	}
+	return splitVertexStreams;
+}
+
 const std::vector<Texture*>& Pass::GetTextureVec() const
 {
 	return pTextureVec;
 }
 
+void Pass::SetLodPolicy(LodPolicy _lodPolicy, uint32_t _fixedLod, float _maxPixelError)
+{
+	lodPolicy = _lodPolicy;
+	fixedLod = _fixedLod;
+	maxPixelError = _maxPixelError;
+}
+
+uint32_t Pass::SelectLod(const Mesh& mesh) const
+{
+	uint32_t lastLod = mesh.GetLodCount() - 1;
+	if (lodPolicy == LodPolicy::Fixed)
+		return std::min(fixedLod, lastLod);
+
+	if (pCamera == nullptr)
+		return 0;
+
+	//bounding sphere in world space, the center goes through the whole model transform, the radius grows with the largest axis scale
+	float maxScale = std::max(std::abs(mesh.scale.x), std::max(std::abs(mesh.scale.y), std::abs(mesh.scale.z)));
+	glm::vec3 center = glm::vec3(mesh.GetModelMatrix() * glm::vec4((mesh.GetBoundsMin() + mesh.GetBoundsMax()) * 0.5f, 1.0f));
+	float radius = glm::length(mesh.GetBoundsMax() - mesh.GetBoundsMin()) * 0.5f * maxScale;
+	float distance = std::max(glm::length(center - pCamera->position) - radius, pCamera->GetNear());
+
+	//pixels covered by one world space unit at that distance
+	float pixelsPerUnit = static_cast<float>(pCamera->GetHeight()) / (2.0f * distance * std::tan(glm::radians(pCamera->GetFov()) * 0.5f));
+	uint32_t lod = 0;
+	while (lod < lastLod && mesh.GetLod(lod + 1).error * maxScale * pixelsPerUnit <= maxPixelError)
+	{
+		lod++;
+	}
+	return lod;
+}
+
+void Pass::SetClusterCulling(ClusterCulling _clusterCulling)
+{
+	clusterCulling = _clusterCulling;
+}
+
+void Pass::CullMesh(const Mesh& mesh, uint32_t lod, std::vector<Mesh::SubMesh>& drawVec)
+{
+	const std::vector<Mesh::SubMesh>& subMeshVec = mesh.GetSubMeshVec(lod);
+	const Mesh::Lod& meshLod = mesh.GetLod(lod);
+	cullStats.triangleCount += meshLod.indexCount / 3;
+	if (clusterCulling == ClusterCulling::Disabled || pCamera == nullptr || meshLod.clusterCount == 0)
+	{
+		drawVec.insert(drawVec.end(), subMeshVec.begin(), subMeshVec.end());
+		cullStats.drawCount += static_cast<uint32_t>(subMeshVec.size());
+		return;
+	}
+
+	//cull in object space, the frustum planes of projection * view * model are the object space planes,
+	//and whether a triangle faces the camera does not change under the model transform
+	glm::mat4 model = mesh.GetModelMatrix();
+	glm::mat4 m = glm::transpose(pCamera->GetProjectionMatrix() * pCamera->GetViewMatrix() * model);
+	std::array<glm::vec4, 6> planeArr = { m[3] + m[0], m[3] - m[0], m[3] + m[1], m[3] - m[1], m[2], m[3] - m[2] };//depth is zero to one
+	for (glm::vec4& plane : planeArr)
+	{
+		plane /= glm::length(glm::vec3(plane));
+	}
+	glm::vec3 cameraPosition = glm::vec3(glm::inverse(model) * glm::vec4(pCamera->position, 1.0f));
+	bool coneCulling = clusterCulling == ClusterCulling::FrustumAndCone;
+
+	const MeshClusterizer::Cluster* pClusterArr = mesh.GetClusterVec().data() + meshLod.firstCluster;
+	clusterResultVec.resize(meshLod.clusterCount);
+	pRenderer->GetThreadPool()->ParallelFor(meshLod.clusterCount, CLUSTER_CULL_GRAIN_SIZE, [&](uint32_t begin, uint32_t end)
+	{
+		for (uint32_t i = begin; i < end; i++)
+		{
+			const MeshClusterizer::Cluster& cluster = pClusterArr[i];
+			ClusterResult result = ClusterResult::Visible;
+			for (const glm::vec4& plane : planeArr)
+			{
+				if (glm::dot(glm::vec3(plane), cluster.center) + plane.w < -cluster.radius)
+				{
+					result = ClusterResult::FrustumCulled;
+					break;
+				}
+			}
+			if (result == ClusterResult::Visible && coneCulling &&
+				glm::dot(glm::normalize(cluster.coneApex - cameraPosition), cluster.coneAxis) > cluster.coneCutoff)
+			{
+				result = ClusterResult::ConeCulled;
+			}
+			clusterResultVec[i] = result;
+		}
+	});
+
+	//neighbouring visible clusters are neighbouring index ranges, merge them and cut the ranges where sub-meshes change
+	size_t subMesh = 0;
+	uint32_t i = 0;
+	while (i < meshLod.clusterCount)
+	{
+		const MeshClusterizer::Cluster& cluster = pClusterArr[i];
+		if (clusterResultVec[i] != ClusterResult::Visible)
+		{
+			if (clusterResultVec[i] == ClusterResult::FrustumCulled)
+				cullStats.frustumCulledTriangleCount += cluster.indexCount / 3;
+			else
+				cullStats.coneCulledTriangleCount += cluster.indexCount / 3;
+			i++;
+			continue;
+		}
+
+		uint32_t begin = cluster.firstIndex;
+		uint32_t end = begin;
+		while (i < meshLod.clusterCount && clusterResultVec[i] == ClusterResult::Visible)
+		{
+			end = pClusterArr[i].firstIndex + pClusterArr[i].indexCount;
+			cullStats.visibleClusterCount++;
+			i++;
+		}
+		while (begin < end)
+		{
+			while (subMeshVec[subMesh].firstIndex + subMeshVec[subMesh].indexCount <= begin)
+			{
+				subMesh++;
+			}
+			uint32_t rangeEnd = std::min(end, subMeshVec[subMesh].firstIndex + subMeshVec[subMesh].indexCount);
+			drawVec.push_back({ begin, rangeEnd - begin, subMeshVec[subMesh].vertexOffset });
+			cullStats.drawCount++;
+			begin = rangeEnd;
+		}
+	}
+	cullStats.clusterCount += meshLod.clusterCount;
+}
+
+void Pass::CountPendingMesh()
+{
+	cullStats.pendingMeshCount++;
+}
+
+void Pass::ResetCullStats()
+{
+	cullStats = CullStats();
+}
+
+const Pass::CullStats& Pass::GetCullStats() const
+{
+	return cullStats;
+}
+
 Camera* Pass::GetCamera() const
 {
 	return pCamera;
@@ -204,6 +387,19 @@ VkDescriptorSet* Pass::GetPassDescriptorSetPtr(int frame)
 	return passDescriptorSetVec.data() + frame;
 }
 
+void Pass::UpdateTextureBindings(int frame)
+{
+	for (size_t j = 0; j < pTextureVec.size(); j++)
+	{
+		VkImageView imageView = pTextureVec[j]->GetTextureImageView();
+		if (boundImageViewVec[frame][j] == imageView)
+			continue;
+
+		pRenderer->BindTextureToDescriptorSets(imageView, pTextureVec[j]->GetSampler(), { passDescriptorSetVec[frame] }, pUboCount + static_cast<uint32_t>(j));
+		boundImageViewVec[frame][j] = imageView;
+	}
+}
+
 int Pass::GetPassDescriptorSetCount() const
 {
 	return passDescriptorSetVec.size();
@@ -290,6 +486,7 @@ void Pass::InitPass(
 		passDescriptorSetLayout);
 
 	VkDeviceSize uboSize = sizeof(pUBO);
+	boundImageViewVec.assign(passDescriptorSetVec.size(), std::vector<VkImageView>(pTextureVec.size()));
 	for (int i = 0; i < passDescriptorSetVec.size(); i++)
 	{
 		//bind ubo
@@ -300,6 +497,7 @@ void Pass::InitPass(
 		for (int j = 0; j < pTextureVec.size(); j++)
 		{
 			pRenderer->BindTextureToDescriptorSets(pTextureVec[j]->GetTextureImageView(), pTextureVec[j]->GetSampler(), { passDescriptorSetVec[i] }, pUboCount + j);//only 1 pUBO, so offset is 1
+			boundImageViewVec[i][j] = pTextureVec[j]->GetTextureImageView();
 		}
 	}
 
@@ -362,7 +560,7 @@ void Pass::CreatePassUniformBuffer(int frameCount)
 		VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT,
 		VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
 		passUniformBuffer,
-		passUniformBufferMemory);
+		passUniformBufferAllocation);
 
 	//initial update
 	for (int i = 0; i < frameCount; i++)
@@ -378,8 +576,7 @@ void Pass::CleanUp()
 		vkDestroyDescriptorSetLayout(pRenderer->GetDevice(), passDescriptorSetLayout, nullptr);
 		vkDestroyFramebuffer(pRenderer->GetDevice(), framebuffer, nullptr);
 		vkDestroyRenderPass(pRenderer->GetDevice(), renderPass, nullptr);
-		vkDestroyBuffer(pRenderer->GetDevice(), passUniformBuffer, nullptr);
-		vkFreeMemory(pRenderer->GetDevice(), passUniformBufferMemory, nullptr);
+		pRenderer->DestroyBuffer(passUniformBuffer, passUniformBufferAllocation);
 		pRenderer = nullptr;
 	}
 }
@@ -398,7 +595,6 @@ void Pass::UpdatePassUniformBuffer(int frame, Camera* _pCamera)
 	void* data;
 	VkDeviceSize size = sizeof(pUBO);
 	VkDeviceSize offset = pRenderer->GetAlignedUboOffset(size, frame);
-	vkMapMemory(pRenderer->GetDevice(), passUniformBufferMemory, offset, size, 0, &data);
+	data = static_cast<uint8_t*>(passUniformBufferAllocation.pMapped) + offset;
 	memcpy(data, &pUBO, sizeof(pUBO));
-	vkUnmapMemory(pRenderer->GetDevice(), passUniformBufferMemory);
 }
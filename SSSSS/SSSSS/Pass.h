@@ -2,10 +2,10 @@
 
 #include "GlobalInclude.h"
 #include "Shader.h"
+#include "Mesh.h"
 
 class Renderer;
 class Scene;
-class Mesh;
 class Camera;
 class Texture;
 class RenderTexture;
@@ -13,6 +13,23 @@ class RenderTexture;
 class Pass
 {
 public:
+	//how a pass picks the level of detail of its meshes
+	enum class LodPolicy { Fixed, ScreenSpaceError, Count };
+	//what the clusters of a mesh are culled against, cone culling is only valid while the pipeline culls back faces
+	enum class ClusterCulling { Disabled, Frustum, FrustumAndCone, Count };
+
+	//instrumentation, reset by ResetCullStats and summed over the meshes of the pass
+	struct CullStats
+	{
+		uint32_t clusterCount = 0;
+		uint32_t visibleClusterCount = 0;
+		uint32_t triangleCount = 0;
+		uint32_t frustumCulledTriangleCount = 0;
+		uint32_t coneCulledTriangleCount = 0;
+		uint32_t drawCount = 0;
+		uint32_t pendingMeshCount = 0;//skipped because their uploads or the pass textures' have not completed
+	};
+
 	Pass(const std::string& _name, 
 		bool _clearColor = true, 
 		bool _clearDepth = true, 
@@ -33,6 +50,10 @@ public:
 	void SetCamera(Camera* _pCamera);
 	void AddShader(Shader* pShader);
 	void SetScene(Scene* _pScene);
+	//Fixed draws fixedLod(or the coarsest lod a mesh has),
+	//ScreenSpaceError draws the coarsest lod whose error projects to at most maxPixelError pixels through the pass camera
+	void SetLodPolicy(LodPolicy _lodPolicy, uint32_t _fixedLod = 0, float _maxPixelError = 1.0f);
+	void SetClusterCulling(ClusterCulling _clusterCulling);
 
 	bool IsClearColorEnabled() const;
 	bool IsClearDepthStencilEnabled() const;
@@ -45,6 +66,8 @@ public:
 	VkStencilOp GetStencilFailOp() const;
 	uint32_t GetStencilReference() const;
 	uint32_t GetTextureCount() const;
+	//false while one of the pass textures is still on its way to the gpu, the pass draws nothing until then
+	bool IsUploadComplete() const;
 	int GetColorRenderTextureCount() const;
 	int GetRenderTextureCount() const;
 	bool HasRenderTexture() const;
@@ -52,9 +75,23 @@ public:
 	uint32_t GetUboCount() const;
 	Shader* GetShader(Shader::ShaderType type) const;
 	const std::vector<Mesh*>& GetMeshVec() const;
+	//one pipeline per pass, so all meshes of a pass must share a vertex format
+	VERTEX_FORMAT GetVertexFormat() const;
+	//same for the vertex stream layout
+	bool IsVertexStreamSplit() const;
+	uint32_t SelectLod(const Mesh& mesh) const;
+	//appends the draws of lod that survive culling against the pass camera, on the worker threads of the renderer,
+	//meshes without clusters append all sub-meshes of lod
+	void CullMesh(const Mesh& mesh, uint32_t lod, std::vector<Mesh::SubMesh>& drawVec);
+	void CountPendingMesh();
+	void ResetCullStats();
+	const CullStats& GetCullStats() const;
 	const std::vector<Texture*>& GetTextureVec() const;
 	const PassUniformBufferObject& GetPassUniformBufferObject() const;
 	VkDescriptorSet* GetPassDescriptorSetPtr(int frame);
+	//rewrites the textures of the frame's descriptor set whose image view changed since they were bound, streaming textures change it as levels land,
+	//call while recording the frame's command buffer before the set is bound
+	void UpdateTextureBindings(int frame);
 	int GetPassDescriptorSetCount() const;
 	VkBuffer GetPassUniformBuffer() const;
 	Camera* GetCamera() const;
@@ -111,11 +148,24 @@ private:
 	std::vector<RenderTexture*> pRenderTextureVec;
 	Camera* pCamera;
 
+	//level of detail
+	LodPolicy lodPolicy;
+	uint32_t fixedLod;
+	float maxPixelError;
+
+	//cluster culling
+	static const uint32_t CLUSTER_CULL_GRAIN_SIZE = 256;
+	ClusterCulling clusterCulling;
+	CullStats cullStats;
+	enum class ClusterResult : uint8_t { Visible, FrustumCulled, ConeCulled };
+	std::vector<ClusterResult> clusterResultVec;//per cluster of the mesh being culled
+
 	//pass uniform
 	PassUniformBufferObject pUBO;
 	VkBuffer passUniformBuffer;
-	VkDeviceMemory passUniformBufferMemory;
+	DeviceMemoryAllocator::Allocation passUniformBufferAllocation;
 	std::vector<VkDescriptorSet> passDescriptorSetVec;
+	std::vector<std::vector<VkImageView>> boundImageViewVec;//[frame][texture], what the descriptor sets hold
 	VkDescriptorSetLayout passDescriptorSetLayout;
 
 	//render texture property
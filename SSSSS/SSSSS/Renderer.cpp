@@ -5,7 +5,10 @@
 #include <set>
 #include <chrono>
 #include <fstream>
+#include <filesystem>
+#include <cstring>
 
+#include "Hash.h"
 #include "Frame.h"
 #include "Shader.h"
 #include "Mesh.h"
@@ -34,12 +37,22 @@ void Renderer::AddLevel(Level* pLevel)
 
 void Renderer::InitVulkan() 
 {
+	//cpu workers for asset loading
+	threadPool.InitThreadPool();
+
 	//general initialization
 	CreateInstance();
 	SetupDebugMessenger();
 	CreateSurface();
 	PickPhysicalDevice();
 	CreateLogicalDevice();
+	CreatePipelineCache();
+	deviceMemoryAllocator.InitDeviceMemoryAllocator(this);
+	geometryArena.InitGeometryArena(this);
+	samplerCache.InitSamplerCache(this);
+	imageCache.InitImageCache(this);
+	stagingRing.InitStagingRing(this, STAGING_RING_SIZE);
+	uploadManager.InitUploadManager(this, &stagingRing, queueFamilyIndices.transferFamily.value(), transferQueue, queueFamilyIndices.graphicsFamily.value(), graphicsQueue);
 	CreateSwapChain();
 	//this is the image views for frame buffer
 	CreateImageViews();
@@ -102,6 +115,9 @@ void Renderer::InitAssets()
 		fTextureCount += frame.GetTextureCount();
 	}
 
+	auto startTime = std::chrono::high_resolution_clock::now();
+	uploadStats = UploadStats();
+
 	//create descriptor pool
 	CreateDescriptorPool(
 		defaultDescriptorPool,
@@ -109,6 +125,11 @@ void Renderer::InitAssets()
 		sUboCount + pUboCount + oUboCount + fUboCount,
 		sTextureCount + pTextureCount + oTextureCount + fTextureCount);
 
+	if (batchUploads)
+	{
+		BeginUploadBatch();
+	}
+
 	for (auto level : pLevelVec)
 	{
 		//create descriptor sets & bind ubo and textures for other assets
@@ -120,6 +141,14 @@ void Renderer::InitAssets()
 	{
 		frame.InitFrame(this, defaultDescriptorPool);
 	}
+
+	//without a batch nothing waits here, the first frames render while the tickets complete and passes skip what is still uploading
+	if (batchUploads)
+	{
+		EndUploadBatch();
+	}
+
+	uploadStats.initAssetsMs = std::chrono::duration<float, std::chrono::milliseconds::period>(std::chrono::high_resolution_clock::now() - startTime).count();
 }
 
 
@@ -178,9 +207,83 @@ VkSampleCountFlagBits Renderer::GetSwapChainMsaaSamples() const
 	return swapChainMsaaSamples;
 }
 
+bool Renderer::SupportsBlockCompression() const
+{
+	return textureCompressionBC;
+}
+
+bool Renderer::IsUnifiedMemory() const
+{
+	return unifiedMemory;
+}
+
+bool Renderer::SupportsLinearImage(VkFormat format, uint32_t width, uint32_t height, uint32_t mipLevels) const
+{
+	VkFormatProperties formatProperties;
+	vkGetPhysicalDeviceFormatProperties(physicalDevice, format, &formatProperties);
+	VkFormatFeatureFlags features = VK_FORMAT_FEATURE_SAMPLED_IMAGE_BIT | VK_FORMAT_FEATURE_SAMPLED_IMAGE_FILTER_LINEAR_BIT;
+	if ((formatProperties.linearTilingFeatures & features) != features)
+		return false;
+
+	//most drivers only allow a single level with linear tiling, mip chains then take the staged path
+	VkImageFormatProperties imageFormatProperties;
+	if (vkGetPhysicalDeviceImageFormatProperties(physicalDevice, format, VK_IMAGE_TYPE_2D, VK_IMAGE_TILING_LINEAR, VK_IMAGE_USAGE_SAMPLED_BIT, 0, &imageFormatProperties) != VK_SUCCESS)
+		return false;
+
+	return mipLevels <= imageFormatProperties.maxMipLevels && width <= imageFormatProperties.maxExtent.width && height <= imageFormatProperties.maxExtent.height;
+}
+
+bool Renderer::SupportsSampledImage(VkFormat format) const
+{
+	VkFormatProperties formatProperties;
+	vkGetPhysicalDeviceFormatProperties(physicalDevice, format, &formatProperties);
+	VkFormatFeatureFlags features = VK_FORMAT_FEATURE_SAMPLED_IMAGE_BIT | VK_FORMAT_FEATURE_SAMPLED_IMAGE_FILTER_LINEAR_BIT;
+	return (formatProperties.optimalTilingFeatures & features) == features;
+}
+
+ThreadPool* Renderer::GetThreadPool()
+{
+	return &threadPool;
+}
+
+GeometryArena* Renderer::GetGeometryArena()
+{
+	return &geometryArena;
+}
+
+SamplerCache* Renderer::GetSamplerCache()
+{
+	return &samplerCache;
+}
+
+ImageCache* Renderer::GetImageCache()
+{
+	return &imageCache;
+}
+
+VkPipelineCache Renderer::GetPipelineCache() const
+{
+	return pipelineCache;
+}
+
+const Renderer::PipelineCacheStats& Renderer::GetPipelineCacheStats() const
+{
+	return pipelineCacheStats;
+}
+
+const DeviceMemoryAllocator::MemoryStats& Renderer::GetMemoryStats() const
+{
+	return deviceMemoryAllocator.GetMemoryStats();
+}
+
+UploadManager* Renderer::GetUploadManager()
+{
+	return &uploadManager;
+}
+
 // ~ general gpu resource operations ~
 
-void Renderer::CreateBuffer(VkDeviceSize size, VkBufferUsageFlags usage, VkMemoryPropertyFlags properties, VkBuffer& buffer, VkDeviceMemory& bufferMemory)
+void Renderer::CreateBuffer(VkDeviceSize size, VkBufferUsageFlags usage, VkMemoryPropertyFlags properties, VkBuffer& buffer, DeviceMemoryAllocator::Allocation& bufferAllocation, DeviceMemoryAllocator::MemoryUsage memoryUsage)
 {
 	VkBufferCreateInfo bufferInfo = {};
 	bufferInfo.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
@@ -195,23 +298,29 @@ void Renderer::CreateBuffer(VkDeviceSize size, VkBufferUsageFlags usage, VkMemor
 	VkMemoryRequirements memRequirements;
 	vkGetBufferMemoryRequirements(device, buffer, &memRequirements);
 
-	VkMemoryAllocateInfo allocInfo = {};
-	allocInfo.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
-	allocInfo.allocationSize = memRequirements.size;
-	allocInfo.memoryTypeIndex = FindMemoryType(memRequirements.memoryTypeBits, properties);
+	bufferAllocation = deviceMemoryAllocator.Allocate(
+		memRequirements,
+		FindMemoryType(memRequirements.memoryTypeBits, properties),
+		DeviceMemoryAllocator::ResourceType::Buffer,
+		memoryUsage);
 
-	if (vkAllocateMemory(device, &allocInfo, nullptr, &bufferMemory) != VK_SUCCESS) {
-		throw std::runtime_error("failed to allocate buffer memory!");
-	}
+	vkBindBufferMemory(device, buffer, bufferAllocation.memory, bufferAllocation.offset);
+}
 
-	vkBindBufferMemory(device, buffer, bufferMemory, 0);
+void Renderer::DestroyBuffer(VkBuffer& buffer, DeviceMemoryAllocator::Allocation& bufferAllocation)
+{
+	vkDestroyBuffer(device, buffer, nullptr);
+	deviceMemoryAllocator.Free(bufferAllocation);
+	buffer = VK_NULL_HANDLE;
 }
 
-void Renderer::CopyBuffer(VkCommandPool commandPool, VkBuffer srcBuffer, VkBuffer dstBuffer, VkDeviceSize size) 
+void Renderer::CopyBuffer(VkCommandPool commandPool, VkBuffer srcBuffer, VkBuffer dstBuffer, VkDeviceSize size, VkDeviceSize dstOffset, VkDeviceSize srcOffset) 
 {
 	VkCommandBuffer commandBuffer = BeginSingleTimeCommands(commandPool);
 
 	VkBufferCopy copyRegion = {};
+	copyRegion.srcOffset = srcOffset;
+	copyRegion.dstOffset = dstOffset;
 	copyRegion.size = size;
 	vkCmdCopyBuffer(commandBuffer, srcBuffer, dstBuffer, 1, &copyRegion);
 
@@ -228,7 +337,8 @@ void Renderer::CreateImage(
 	VkImageUsageFlags usage,
 	VkMemoryPropertyFlags properties,
 	VkImage& image, 
-	VkDeviceMemory& imageMemory)
+	DeviceMemoryAllocator::Allocation& imageAllocation,
+	VkImageLayout initialLayout)
 {
 	VkImageCreateInfo imageInfo = {};
 	imageInfo.sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO;
@@ -240,7 +350,7 @@ void Renderer::CreateImage(
 	imageInfo.arrayLayers = 1;
 	imageInfo.format = format;
 	imageInfo.tiling = tiling;
-	imageInfo.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+	imageInfo.initialLayout = initialLayout;//VK_IMAGE_LAYOUT_PREINITIALIZED keeps what the cpu wrote to a linear image through the first transition
 	imageInfo.usage = usage;
 	imageInfo.samples = numSamples;
 	imageInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
@@ -252,19 +362,24 @@ void Renderer::CreateImage(
 	VkMemoryRequirements memRequirements;
 	vkGetImageMemoryRequirements(device, image, &memRequirements);
 
-	VkMemoryAllocateInfo allocInfo = {};
-	allocInfo.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
-	allocInfo.allocationSize = memRequirements.size;
-	allocInfo.memoryTypeIndex = FindMemoryType(memRequirements.memoryTypeBits, properties);
+	//very large images end up with device memory of their own, linear images are linear resources like buffers
+	imageAllocation = deviceMemoryAllocator.Allocate(
+		memRequirements,
+		FindMemoryType(memRequirements.memoryTypeBits, properties),
+		tiling == VK_IMAGE_TILING_LINEAR ? DeviceMemoryAllocator::ResourceType::Buffer : DeviceMemoryAllocator::ResourceType::Image,
+		DeviceMemoryAllocator::MemoryUsage::Pooled);
 
-	if (vkAllocateMemory(device, &allocInfo, nullptr, &imageMemory) != VK_SUCCESS) {
-		throw std::runtime_error("failed to allocate image memory!");
-	}
+	vkBindImageMemory(device, image, imageAllocation.memory, imageAllocation.offset);
+}
 
-	vkBindImageMemory(device, image, imageMemory, 0);
+void Renderer::DestroyImage(VkImage& image, DeviceMemoryAllocator::Allocation& imageAllocation)
+{
+	vkDestroyImage(device, image, nullptr);
+	deviceMemoryAllocator.Free(imageAllocation);
+	image = VK_NULL_HANDLE;
 }
 
-void Renderer::TransitionImageLayout(VkCommandPool commandPool, VkImage image, VkFormat format, VkImageLayout oldLayout, VkImageLayout newLayout, uint32_t mipLevels)
+void Renderer::TransitionImageLayout(VkCommandPool commandPool, VkImage image, VkFormat format, VkImageLayout oldLayout, VkImageLayout newLayout, uint32_t mipLevels, uint32_t baseMipLevel)
 {
 	VkCommandBuffer commandBuffer = BeginSingleTimeCommands(commandPool);
 
@@ -279,7 +394,7 @@ void Renderer::TransitionImageLayout(VkCommandPool commandPool, VkImage image, V
 	barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
 	barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
 	barrier.image = image;
-	barrier.subresourceRange.baseMipLevel = 0;
+	barrier.subresourceRange.baseMipLevel = baseMipLevel;
 	barrier.subresourceRange.levelCount = mipLevels;
 	barrier.subresourceRange.baseArrayLayer = 0;
 	barrier.subresourceRange.layerCount = 1;
@@ -325,6 +440,16 @@ void Renderer::TransitionImageLayout(VkCommandPool commandPool, VkImage image, V
 		sourceStage = VK_PIPELINE_STAGE_TRANSFER_BIT;
 		destinationStage = VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT;
 	}
+	else if (oldLayout == VK_IMAGE_LAYOUT_PREINITIALIZED && newLayout == VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL)
+	{
+		// ~ this is for textures the cpu wrote in place on unified memory ~
+
+		//the host writes happened before the submission, which makes them visible without a host access in the barrier
+		barrier.srcAccessMask = 0;
+		barrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
+		sourceStage = VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT;
+		destinationStage = VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT;
+	}
 	else if (oldLayout == VK_IMAGE_LAYOUT_UNDEFINED && newLayout == VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL) 
 	{
 		// ~ this is for depth stencil buffer ~
@@ -363,12 +488,10 @@ void Renderer::TransitionImageLayout(VkCommandPool commandPool, VkImage image, V
 	EndSingleTimeCommands(commandBuffer, commandPool);
 }
 
-void Renderer::CopyBufferToImage(VkCommandPool commandPool, VkBuffer buffer, VkImage image, uint32_t width, uint32_t height)
+void Renderer::CopyBufferToImage(VkCommandPool commandPool, VkBuffer buffer, VkImage image, uint32_t width, uint32_t height, VkDeviceSize bufferOffset)
 {
-	VkCommandBuffer commandBuffer = BeginSingleTimeCommands(commandPool);
-
 	VkBufferImageCopy region = {};
-	region.bufferOffset = 0;
+	region.bufferOffset = bufferOffset;
 	region.bufferRowLength = 0;
 	region.bufferImageHeight = 0;
 	region.imageSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
@@ -382,7 +505,14 @@ void Renderer::CopyBufferToImage(VkCommandPool commandPool, VkBuffer buffer, VkI
 		1
 	};
 
-	vkCmdCopyBufferToImage(commandBuffer, buffer, image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, 1, &region);
+	CopyBufferToImage(commandPool, buffer, image, { region });
+}
+
+void Renderer::CopyBufferToImage(VkCommandPool commandPool, VkBuffer buffer, VkImage image, const std::vector<VkBufferImageCopy>& regionVec)
+{
+	VkCommandBuffer commandBuffer = BeginSingleTimeCommands(commandPool);
+
+	vkCmdCopyBufferToImage(commandBuffer, buffer, image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, static_cast<uint32_t>(regionVec.size()), regionVec.data());
 
 	EndSingleTimeCommands(commandBuffer, commandPool);
 }
@@ -604,15 +734,16 @@ void Renderer::GenerateMipmaps(
 		1, &barrier);
 }
 
-VkImageView Renderer::CreateImageView(VkImage image, VkFormat format, VkImageAspectFlags aspectFlags, uint32_t mipLevels)
+VkImageView Renderer::CreateImageView(VkImage image, VkFormat format, VkImageAspectFlags aspectFlags, uint32_t mipLevels, VkComponentMapping components, uint32_t baseMipLevel)
 {
 	VkImageViewCreateInfo viewInfo = {};
 	viewInfo.sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO;
 	viewInfo.image = image;
 	viewInfo.viewType = VK_IMAGE_VIEW_TYPE_2D;
 	viewInfo.format = format;
+	viewInfo.components = components;
 	viewInfo.subresourceRange.aspectMask = aspectFlags;
-	viewInfo.subresourceRange.baseMipLevel = 0;
+	viewInfo.subresourceRange.baseMipLevel = baseMipLevel;
 	viewInfo.subresourceRange.levelCount = mipLevels;
 	viewInfo.subresourceRange.baseArrayLayer = 0;
 	viewInfo.subresourceRange.layerCount = 1;
@@ -1044,13 +1175,17 @@ void Renderer::CreatePipeline(
 	VkStencilOp depthFailOp,
 	VkStencilOp stencilPassOp,
 	VkStencilOp stencilFailOp,
-	uint32_t stencilReference)
+	uint32_t stencilReference,
+	VERTEX_FORMAT vertexFormat,
+	bool splitVertexStreams)
 {
 	std::vector<VkPipelineShaderStageCreateInfo> shaderStages;
 
 	//~ shader load begin ~
 	//use shaderc to compile vulkan shader in run time
 	if (pVertShader != nullptr) {
+		if (pVertShader->GetVertexFormat() != vertexFormat)
+			throw std::runtime_error("shader " + pVertShader->GetFileName() + " : compiled for a different vertex format than the meshes it draws!");
 		shaderStages.push_back(pVertShader->GetShaderStageInfo());
 	}
 
@@ -1073,13 +1208,59 @@ void Renderer::CreatePipeline(
 
 	auto bindingDescription = Vertex::getBindingDescription();
 	auto attributeDescriptions = Vertex::getAttributeDescriptions();
+	if (vertexFormat == VERTEX_FORMAT::Compact)
+	{
+		bindingDescription = CompactVertex::getBindingDescription();
+		attributeDescriptions = CompactVertex::getAttributeDescriptions();
+	}
+	else if (vertexFormat == VERTEX_FORMAT::CompactQuantized)
+	{
+		bindingDescription = QuantizedVertex::getBindingDescription();
+		attributeDescriptions = QuantizedVertex::getAttributeDescriptions();
+	}
+
+	//the position is the first attribute of every vertex format, the normal the second and the other attributes follow them,
+	//split vertex streams move the position to binding 0, the normal to binding 1 and the rest to binding 2
+	std::vector<VkVertexInputBindingDescription> bindingDescriptionVec = { bindingDescription };
+	std::vector<VkVertexInputAttributeDescription> attributeDescriptionVec(attributeDescriptions.begin(), attributeDescriptions.end());
+	if (splitVertexStreams)
+	{
+		uint32_t positionStride = attributeDescriptions[1].offset;
+		uint32_t normalStride = attributeDescriptions[2].offset - positionStride;
+		bindingDescriptionVec.resize(3, bindingDescription);
+		bindingDescriptionVec[0].stride = positionStride;
+		bindingDescriptionVec[1].binding = 1;
+		bindingDescriptionVec[1].stride = normalStride;
+		bindingDescriptionVec[2].binding = 2;
+		bindingDescriptionVec[2].stride = bindingDescription.stride - positionStride - normalStride;
+		attributeDescriptionVec[1].binding = 1;
+		attributeDescriptionVec[1].offset = 0;
+		for (size_t i = 2; i < attributeDescriptionVec.size(); i++)
+		{
+			attributeDescriptionVec[i].binding = 2;
+			attributeDescriptionVec[i].offset -= positionStride + normalStride;
+		}
+	}
+
+	//vertex shaders reading only part of the vertex leave the other attributes(and their streams) unbound
+	VERTEX_INPUT vertexInput = pVertShader != nullptr ? pVertShader->GetVertexInput() : VERTEX_INPUT::All;
+	if (vertexInput == VERTEX_INPUT::PositionOnly)
+	{
+		attributeDescriptionVec.resize(1);
+		bindingDescriptionVec.resize(1);
+	}
+	else if (vertexInput == VERTEX_INPUT::PositionNormal)
+	{
+		attributeDescriptionVec.resize(2);
+		bindingDescriptionVec.resize(splitVertexStreams ? 2 : 1);
+	}
 
 	VkPipelineVertexInputStateCreateInfo vertexInputInfo = {};
 	vertexInputInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_VERTEX_INPUT_STATE_CREATE_INFO;
-	vertexInputInfo.vertexBindingDescriptionCount = 1;
-	vertexInputInfo.vertexAttributeDescriptionCount = static_cast<uint32_t>(attributeDescriptions.size());
-	vertexInputInfo.pVertexBindingDescriptions = &bindingDescription;
-	vertexInputInfo.pVertexAttributeDescriptions = attributeDescriptions.data();
+	vertexInputInfo.vertexBindingDescriptionCount = static_cast<uint32_t>(bindingDescriptionVec.size());
+	vertexInputInfo.vertexAttributeDescriptionCount = static_cast<uint32_t>(attributeDescriptionVec.size());
+	vertexInputInfo.pVertexBindingDescriptions = bindingDescriptionVec.data();
+	vertexInputInfo.pVertexAttributeDescriptions = attributeDescriptionVec.data();
 
 	VkPipelineInputAssemblyStateCreateInfo inputAssembly = {};
 	inputAssembly.sType = VK_STRUCTURE_TYPE_PIPELINE_INPUT_ASSEMBLY_STATE_CREATE_INFO;
@@ -1198,9 +1379,14 @@ void Renderer::CreatePipeline(
 	pipelineInfo.subpass = 0;
 	pipelineInfo.basePipelineHandle = VK_NULL_HANDLE;
 
-	if (vkCreateGraphicsPipelines(device, VK_NULL_HANDLE, 1, &pipelineInfo, nullptr, &pipeline) != VK_SUCCESS) {
+	auto startTime = std::chrono::high_resolution_clock::now();
+
+	if (vkCreateGraphicsPipelines(device, pipelineCache, 1, &pipelineInfo, nullptr, &pipeline) != VK_SUCCESS) {
 		throw std::runtime_error("failed to create graphics pipeline!");
 	}
+
+	pipelineCacheStats.pipelineCount++;
+	pipelineCacheStats.createPipelinesMs += std::chrono::duration<float, std::chrono::milliseconds::period>(std::chrono::high_resolution_clock::now() - startTime).count();
 }
 
 void Renderer::CreatePipeline(
@@ -1238,7 +1424,9 @@ void Renderer::CreatePipeline(
 		pass.GetDepthFailOp(),
 		pass.GetStencilPassOp(),
 		pass.GetStencilFailOp(),
-		pass.GetStencilReference()
+		pass.GetStencilReference(),
+		pass.GetVertexFormat(),
+		pass.IsVertexStreamSplit()
 	);
 }
 
@@ -1315,6 +1503,7 @@ void Renderer::RecordCommandNoEnd(
 	}
 
 	//bind pass descriptor set
+	pass.UpdateTextureBindings(frameIndex);
 	vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, pipelineLayout, static_cast<int>(UNIFORM_SLOT::Pass), 1, pass.GetPassDescriptorSetPtr(frameIndex), 0, nullptr);
 
 	VkRenderPassBeginInfo renderPassInfo = {};
@@ -1330,19 +1519,65 @@ void Renderer::RecordCommandNoEnd(
 	vkCmdBeginRenderPass(commandBuffer, &renderPassInfo, VK_SUBPASS_CONTENTS_INLINE);
 	vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, pipeline);
 
+	//only bind the vertex streams the vertex shader reads
+	Shader* pVertShader = pass.GetShader(Shader::ShaderType::VertexShader);
+	VERTEX_INPUT vertexInput = pVertShader != nullptr ? pVertShader->GetVertexInput() : VERTEX_INPUT::All;
+	uint32_t splitVertexBufferCount = vertexInput == VERTEX_INPUT::PositionOnly ? 1 : vertexInput == VERTEX_INPUT::PositionNormal ? 2 : 3;
+
 	//loop over meshes
+	pass.ResetCullStats();
+	std::vector<Mesh::SubMesh> drawVec;
+	VkBuffer boundVertexBuffers[] = { VK_NULL_HANDLE, VK_NULL_HANDLE, VK_NULL_HANDLE };
+	VkDeviceSize boundOffsets[] = { 0, 0, 0 };
+	VkBuffer boundIndexBuffer = VK_NULL_HANDLE;
+	VkIndexType boundIndexType = VK_INDEX_TYPE_MAX_ENUM;
+	bool passUploadComplete = pass.IsUploadComplete();
 	for (auto mesh : pass.GetMeshVec())
 	{
-		VkBuffer vertexBuffers[] = { mesh->GetVertexBuffer() };
-		VkDeviceSize offsets[] = { 0 };
+		//assets still uploading in the background are left out until their ticket completes
+		if (!passUploadComplete || !mesh->IsUploadComplete())
+		{
+			pass.CountPendingMesh();
+			continue;
+		}
+
+		VkBuffer vertexBuffers[] = { mesh->GetVertexBuffer(), mesh->GetVertexBuffer(), mesh->GetVertexBuffer() };
+		VkDeviceSize offsets[] = { mesh->GetVertexBufferOffset(), mesh->GetVertexBufferOffset() + mesh->GetNormalStreamOffset(), mesh->GetVertexBufferOffset() + mesh->GetAttributeStreamOffset() };
+		uint32_t vertexBufferCount = mesh->IsVertexStreamSplit() ? splitVertexBufferCount : 1;
 		//bind object descriptor set
+		mesh->UpdateTextureBindings(frameIndex);
 		vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, pipelineLayout, static_cast<int>(UNIFORM_SLOT::Object), 1, mesh->GetObjectDescriptorSetPtr(frameIndex), 0, nullptr);
 
-		//bind vbo
-		vkCmdBindVertexBuffers(commandBuffer, 0, 1, vertexBuffers, offsets);
-		vkCmdBindIndexBuffer(commandBuffer, mesh->GetIndexBuffer(), 0, VK_INDEX_TYPE_UINT32);
-		//draw call
-		vkCmdDrawIndexed(commandBuffer, static_cast<uint32_t>(mesh->GetIndexVec().size()), 1, 0, 0, 0);
+		//bind vbo, meshes sharing a block of the geometry arena share the bindings
+		bool vertexBuffersBound = true;
+		for (uint32_t i = 0; i < vertexBufferCount; i++)
+		{
+			vertexBuffersBound = vertexBuffersBound && boundVertexBuffers[i] == vertexBuffers[i] && boundOffsets[i] == offsets[i];
+		}
+		if (!vertexBuffersBound)
+		{
+			vkCmdBindVertexBuffers(commandBuffer, 0, vertexBufferCount, vertexBuffers, offsets);
+			for (uint32_t i = 0; i < vertexBufferCount; i++)
+			{
+				boundVertexBuffers[i] = vertexBuffers[i];
+				boundOffsets[i] = offsets[i];
+			}
+		}
+		if (boundIndexBuffer != mesh->GetIndexBuffer() || boundIndexType != mesh->GetIndexType())
+		{
+			vkCmdBindIndexBuffer(commandBuffer, mesh->GetIndexBuffer(), 0, mesh->GetIndexType());
+			boundIndexBuffer = mesh->GetIndexBuffer();
+			boundIndexType = mesh->GetIndexType();
+		}
+
+		//draw call, one per visible range of the lod the pass picks
+		uint32_t lod = pass.SelectLod(*mesh);
+		drawVec.clear();
+		pass.CullMesh(*mesh, lod, drawVec);
+		for (const Mesh::SubMesh& subMesh : drawVec)
+		{
+			vkCmdDrawIndexed(commandBuffer, subMesh.indexCount, 1, mesh->GetFirstIndex() + subMesh.firstIndex, mesh->GetBaseVertex() + subMesh.vertexOffset, 0);
+		}
 	}
 }
 
@@ -1506,6 +1741,30 @@ void Renderer::PickPhysicalDevice()
 	VkPhysicalDeviceProperties physicalDeviceProperties;
 	vkGetPhysicalDeviceProperties(physicalDevice, &physicalDeviceProperties);
 	physicalDeviceLimits = physicalDeviceProperties.limits;
+
+	//unified memory when the largest device local heap, the one that holds the assets, is host visible as well,
+	//a small host visible window into the memory of a discrete gpu does not count
+	VkPhysicalDeviceMemoryProperties memoryProperties;
+	vkGetPhysicalDeviceMemoryProperties(physicalDevice, &memoryProperties);
+	uint32_t largestHeap = UINT32_MAX;
+	for (uint32_t i = 0; i < memoryProperties.memoryHeapCount; i++)
+	{
+		if ((memoryProperties.memoryHeaps[i].flags & VK_MEMORY_HEAP_DEVICE_LOCAL_BIT) &&
+			(largestHeap == UINT32_MAX || memoryProperties.memoryHeaps[i].size > memoryProperties.memoryHeaps[largestHeap].size))
+		{
+			largestHeap = i;
+		}
+	}
+	VkMemoryPropertyFlags unifiedProperties = VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT | VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT;
+	bool integrated = physicalDeviceProperties.deviceType == VK_PHYSICAL_DEVICE_TYPE_INTEGRATED_GPU || physicalDeviceProperties.deviceType == VK_PHYSICAL_DEVICE_TYPE_CPU;
+	unifiedMemory = false;
+	for (uint32_t i = 0; integrated && i < memoryProperties.memoryTypeCount; i++)
+	{
+		if (memoryProperties.memoryTypes[i].heapIndex == largestHeap && (memoryProperties.memoryTypes[i].propertyFlags & unifiedProperties) == unifiedProperties)
+		{
+			unifiedMemory = true;
+		}
+	}
 }
 
 void Renderer::CreateLogicalDevice()
@@ -1513,7 +1772,7 @@ void Renderer::CreateLogicalDevice()
 	queueFamilyIndices = FindQueueFamilies(physicalDevice);
 
 	std::vector<VkDeviceQueueCreateInfo> queueCreateInfos;
-	std::set<uint32_t> uniqueQueueFamilies = { queueFamilyIndices.graphicsFamily.value(), queueFamilyIndices.presentFamily.value() };
+	std::set<uint32_t> uniqueQueueFamilies = { queueFamilyIndices.graphicsFamily.value(), queueFamilyIndices.presentFamily.value(), queueFamilyIndices.transferFamily.value() };
 
 	float queuePriority = 1.0f;
 	for (uint32_t queueFamily : uniqueQueueFamilies) {
@@ -1530,6 +1789,11 @@ void Renderer::CreateLogicalDevice()
 	deviceFeatures.samplerAnisotropy = VK_TRUE;
 	//TEXTURE ARRRAY RELATED
 	deviceFeatures.shaderSampledImageArrayDynamicIndexing = VK_TRUE;//seems unnecessary, not sure why
+	//COMPRESSED TEXTURE RELATED
+	VkPhysicalDeviceFeatures supportedFeatures;
+	vkGetPhysicalDeviceFeatures(physicalDevice, &supportedFeatures);
+	deviceFeatures.textureCompressionBC = supportedFeatures.textureCompressionBC;
+	textureCompressionBC = supportedFeatures.textureCompressionBC == VK_TRUE;
 
 	VkDeviceCreateInfo createInfo = {};
 	createInfo.sType = VK_STRUCTURE_TYPE_DEVICE_CREATE_INFO;
@@ -1556,6 +1820,141 @@ void Renderer::CreateLogicalDevice()
 
 	vkGetDeviceQueue(device, queueFamilyIndices.graphicsFamily.value(), 0, &graphicsQueue);
 	vkGetDeviceQueue(device, queueFamilyIndices.presentFamily.value(), 0, &presentQueue);
+	vkGetDeviceQueue(device, queueFamilyIndices.transferFamily.value(), 0, &transferQueue);
+}
+
+void Renderer::CreatePipelineCache()
+{
+	VkPhysicalDeviceProperties physicalDeviceProperties;
+	vkGetPhysicalDeviceProperties(physicalDevice, &physicalDeviceProperties);
+
+	pipelineCacheStats = PipelineCacheStats();
+	std::vector<char> data;
+	std::ifstream file(PIPELINE_CACHE_FILE, std::ios::binary | std::ios::ate);
+	if (file.is_open())
+	{
+		size_t fileSize = static_cast<size_t>(file.tellg());
+		PipelineCacheHeader header = {};
+		if (fileSize >= sizeof(PipelineCacheHeader))
+		{
+			file.seekg(0);
+			file.read(reinterpret_cast<char*>(&header), sizeof(PipelineCacheHeader));
+		}
+
+		//the uuid alone does not change with every driver update on all vendors, so the driver version is checked too
+		if (file.good() &&
+			header.magic == PIPELINE_CACHE_MAGIC &&
+			header.version == PIPELINE_CACHE_VERSION &&
+			header.vendorID == physicalDeviceProperties.vendorID &&
+			header.deviceID == physicalDeviceProperties.deviceID &&
+			header.driverVersion == physicalDeviceProperties.driverVersion &&
+			memcmp(header.pipelineCacheUUID, physicalDeviceProperties.pipelineCacheUUID, VK_UUID_SIZE) == 0 &&
+			header.dataSize == fileSize - sizeof(PipelineCacheHeader))
+		{
+			data.resize(static_cast<size_t>(header.dataSize));
+			file.read(data.data(), data.size());
+			if (!file.good() || Hash64(data.data(), data.size()) != header.dataHash)
+			{
+				data.clear();
+			}
+		}
+	}
+
+	//the data begins with the VkPipelineCacheHeaderVersionOne layout of the driver, checked as well before it is trusted
+	const size_t VULKAN_HEADER_SIZE = 16 + VK_UUID_SIZE;
+	if (data.size() >= VULKAN_HEADER_SIZE)
+	{
+		uint32_t vulkanHeader[4];
+		memcpy(vulkanHeader, data.data(), sizeof(vulkanHeader));
+		if (vulkanHeader[0] < VULKAN_HEADER_SIZE ||
+			vulkanHeader[1] != VK_PIPELINE_CACHE_HEADER_VERSION_ONE ||
+			vulkanHeader[2] != physicalDeviceProperties.vendorID ||
+			vulkanHeader[3] != physicalDeviceProperties.deviceID ||
+			memcmp(data.data() + 16, physicalDeviceProperties.pipelineCacheUUID, VK_UUID_SIZE) != 0)
+		{
+			data.clear();
+		}
+	}
+	else
+	{
+		data.clear();
+	}
+
+	VkPipelineCacheCreateInfo cacheInfo = {};
+	cacheInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_CACHE_CREATE_INFO;
+	cacheInfo.initialDataSize = data.size();
+	cacheInfo.pInitialData = data.empty() ? nullptr : data.data();
+
+	if (vkCreatePipelineCache(device, &cacheInfo, nullptr, &pipelineCache) == VK_SUCCESS)
+	{
+		pipelineCacheStats.warm = !data.empty();
+		pipelineCacheStats.loadedSize = data.size();
+		return;
+	}
+
+	//drivers may still turn down data that passed the checks, start empty then
+	cacheInfo.initialDataSize = 0;
+	cacheInfo.pInitialData = nullptr;
+	if (vkCreatePipelineCache(device, &cacheInfo, nullptr, &pipelineCache) != VK_SUCCESS) {
+		throw std::runtime_error("failed to create pipeline cache!");
+	}
+}
+
+void Renderer::SavePipelineCache()
+{
+	size_t dataSize = 0;
+	if (vkGetPipelineCacheData(device, pipelineCache, &dataSize, nullptr) != VK_SUCCESS || dataSize == 0)
+		return;
+
+	std::vector<char> data(dataSize);
+	if (vkGetPipelineCacheData(device, pipelineCache, &dataSize, data.data()) != VK_SUCCESS)
+		return;
+	data.resize(dataSize);
+
+	VkPhysicalDeviceProperties physicalDeviceProperties;
+	vkGetPhysicalDeviceProperties(physicalDevice, &physicalDeviceProperties);
+
+	PipelineCacheHeader header = {};
+	header.magic = PIPELINE_CACHE_MAGIC;
+	header.version = PIPELINE_CACHE_VERSION;
+	header.vendorID = physicalDeviceProperties.vendorID;
+	header.deviceID = physicalDeviceProperties.deviceID;
+	header.driverVersion = physicalDeviceProperties.driverVersion;
+	memcpy(header.pipelineCacheUUID, physicalDeviceProperties.pipelineCacheUUID, VK_UUID_SIZE);
+	header.dataSize = data.size();
+	header.dataHash = Hash64(data.data(), data.size());
+
+	//a failed save only costs the next start its warm cache
+	std::error_code error;
+	std::filesystem::path path(PIPELINE_CACHE_FILE);
+	if (path.has_parent_path())
+	{
+		std::filesystem::create_directories(path.parent_path(), error);
+	}
+
+	std::string tempFileName = PIPELINE_CACHE_FILE + ".tmp";
+	{
+		std::ofstream out(tempFileName, std::ios::binary | std::ios::trunc);
+		if (!out.is_open())
+			return;
+
+		out.write(reinterpret_cast<const char*>(&header), sizeof(PipelineCacheHeader));
+		out.write(data.data(), data.size());
+		if (!out.good())
+		{
+			out.close();
+			std::filesystem::remove(tempFileName, error);
+			return;
+		}
+	}
+
+	std::filesystem::rename(tempFileName, PIPELINE_CACHE_FILE, error);
+	if (error)
+	{
+		std::filesystem::remove(tempFileName, error);
+		return;
+	}
+	pipelineCacheStats.savedSize = data.size();
 }
 
 bool Renderer::IsDeviceSuitable(VkPhysicalDevice device) {
@@ -1622,6 +2021,24 @@ Renderer::QueueFamilyIndices Renderer::FindQueueFamilies(VkPhysicalDevice device
 		i++;
 	}
 
+	//uploads prefer a family that only copies, then one without graphics, so they run beside rendering
+	int transferScore = -1;
+	for (uint32_t j = 0; j < queueFamilyCount; j++) {
+		VkQueueFlags flags = queueFamilies[j].queueFlags;
+		if (queueFamilies[j].queueCount == 0 || !(flags & VK_QUEUE_TRANSFER_BIT) || (flags & VK_QUEUE_GRAPHICS_BIT)) {
+			continue;
+		}
+
+		int score = flags & VK_QUEUE_COMPUTE_BIT ? 0 : 1;
+		if (score > transferScore) {
+			indices.transferFamily = j;
+			transferScore = score;
+		}
+	}
+	if (!indices.transferFamily.has_value()) {
+		indices.transferFamily = indices.graphicsFamily;
+	}
+
 	return indices;
 }
 
@@ -1704,13 +2121,11 @@ void Renderer::CleanUpSwapChain()
 {
 	//msaa
 	vkDestroyImageView(device, colorImageView, nullptr);
-	vkDestroyImage(device, colorImage, nullptr);
-	vkFreeMemory(device, colorImageMemory, nullptr);
+	DestroyImage(colorImage, colorImageAllocation);
 
 	//depth
 	vkDestroyImageView(device, depthImageView, nullptr);
-	vkDestroyImage(device, depthImage, nullptr);
-	vkFreeMemory(device, depthImageMemory, nullptr);
+	DestroyImage(depthImage, depthImageAllocation);
 
 	//swap chain related
 	for (auto framebuffer : swapChainFramebuffers) 
@@ -1801,7 +2216,7 @@ void Renderer::CreateColorResources() {
 		VK_IMAGE_USAGE_TRANSIENT_ATTACHMENT_BIT | VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT,
 		VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
 		colorImage, 
-		colorImageMemory);
+		colorImageAllocation);
 
 	colorImageView = CreateImageView(colorImage, colorFormat, VK_IMAGE_ASPECT_COLOR_BIT, 1);
 
@@ -1822,7 +2237,7 @@ void Renderer::CreateDepthResources()
 		VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT,
 		VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
 		depthImage, 
-		depthImageMemory);
+		depthImageAllocation);
 
 	VkImageAspectFlags aspectFlags = VK_IMAGE_ASPECT_DEPTH_BIT;
 	if (HasStencilComponent(depthFormat))
@@ -1849,9 +2264,15 @@ void Renderer::IdleWait()
 
 void Renderer::CleanUp()
 {
+	uploadManager.CleanUp();
+	stagingRing.CleanUp();
 	CleanUpLevels();
+	imageCache.CleanUp();
+	samplerCache.CleanUp();
+	geometryArena.CleanUp();
 
 	CleanUpSwapChain();
+	deviceMemoryAllocator.CleanUp();
 
 	vkDestroyCommandPool(device, defaultCommandPool, nullptr);
 
@@ -1861,6 +2282,9 @@ void Renderer::CleanUp()
 		vkDestroyFence(device, inFlightFences[i], nullptr);
 	}
 
+	SavePipelineCache();
+	vkDestroyPipelineCache(device, pipelineCache, nullptr);
+
 	vkDestroyDevice(device, nullptr);
 
 	if (enableValidationLayers) {
@@ -1870,6 +2294,8 @@ void Renderer::CleanUp()
 	vkDestroySurfaceKHR(instance, surface, nullptr);
 	vkDestroyInstance(instance, nullptr);
 
+	threadPool.CleanUp();
+
 }
 
 VkSampleCountFlagBits Renderer::FindMaxUsableSampleCount() 
@@ -2270,10 +2696,310 @@ void Renderer::BindTextureArrayToDescriptorSets(const std::vector<Texture*>& pTe
 	}
 }
 
+// ~ upload batch ~
+
+void Renderer::SetBatchUploads(bool _batchUploads)
+{
+	batchUploads = _batchUploads;
+}
+
+void Renderer::BeginUploadBatch()
+{
+	if (uploadCommandBuffer != VK_NULL_HANDLE)
+	{
+		throw std::runtime_error("upload batch is already open!");
+	}
+
+	//the batch takes the whole staging ring, so nothing of the upload manager may still use it
+	uploadManager.WaitIdle();
+	uploadCommandBuffer = BeginSingleTimeCommands(defaultCommandPool);
+}
+
+void Renderer::EndUploadBatch()
+{
+	if (uploadCommandBuffer == VK_NULL_HANDLE)
+	{
+		throw std::runtime_error("no upload batch is open!");
+	}
+
+	SubmitUploadBatch();
+}
+
+bool Renderer::IsUploadBatchOpen() const
+{
+	return uploadCommandBuffer != VK_NULL_HANDLE;
+}
+
+void Renderer::DestroyStagingBuffer(VkBuffer buffer, DeviceMemoryAllocator::Allocation& bufferAllocation)
+{
+	uploadStats.stagingBufferCount++;
+	uploadStats.stagingSize += bufferAllocation.size;
+
+	if (IsUploadBatchOpen())
+	{
+		pendingStagingBufferVec.emplace_back(buffer, bufferAllocation);
+		bufferAllocation = DeviceMemoryAllocator::Allocation();
+		return;
+	}
+
+	DestroyBuffer(buffer, bufferAllocation);
+}
+
+const Renderer::UploadStats& Renderer::GetUploadStats() const
+{
+	return uploadStats;
+}
+
+void Renderer::SubmitUploadBatch()
+{
+	//the helpers order their own commands with barriers, this one makes every transfer write visible to whatever reads it later
+	VkMemoryBarrier barrier = {};
+	barrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+	barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+	barrier.dstAccessMask = VK_ACCESS_VERTEX_ATTRIBUTE_READ_BIT | VK_ACCESS_INDEX_READ_BIT | VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_UNIFORM_READ_BIT;
+	vkCmdPipelineBarrier(
+		uploadCommandBuffer,
+		VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_ALL_GRAPHICS_BIT,
+		0,
+		1, &barrier,
+		0, nullptr,
+		0, nullptr);
+
+	vkEndCommandBuffer(uploadCommandBuffer);
+
+	VkFenceCreateInfo fenceInfo = {};
+	fenceInfo.sType = VK_STRUCTURE_TYPE_FENCE_CREATE_INFO;
+	VkFence fence;
+	if (vkCreateFence(device, &fenceInfo, nullptr, &fence) != VK_SUCCESS) {
+		throw std::runtime_error("failed to create upload fence!");
+	}
+
+	VkSubmitInfo submitInfo = {};
+	submitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+	submitInfo.commandBufferCount = 1;
+	submitInfo.pCommandBuffers = &uploadCommandBuffer;
+
+	if (vkQueueSubmit(graphicsQueue, 1, &submitInfo, fence) != VK_SUCCESS) {
+		throw std::runtime_error("failed to submit upload batch!");
+	}
+	vkWaitForFences(device, 1, &fence, VK_TRUE, UINT64_MAX);
+	uploadStats.submitCount++;
+
+	vkDestroyFence(device, fence, nullptr);
+	vkFreeCommandBuffers(device, defaultCommandPool, 1, &uploadCommandBuffer);
+	uploadCommandBuffer = VK_NULL_HANDLE;
+
+	for (auto& stagingBuffer : pendingStagingBufferVec)
+	{
+		DestroyBuffer(stagingBuffer.first, stagingBuffer.second);
+	}
+	pendingStagingBufferVec.clear();
+
+	//the batch was the only user of the ring
+	stagingRing.ReclaimAll();
+}
+
+// ~ staged uploads ~
+
+StagingRing::Region Renderer::AllocateStaging(VkDeviceSize size)
+{
+	if (!IsUploadBatchOpen())
+	{
+		return uploadManager.AllocateStaging(size);
+	}
+
+	//a full ring is emptied by submitting what the batch has recorded so far
+	StagingRing::Region staging;
+	if (!TryAllocateStaging(size, staging))
+	{
+		SubmitUploadBatch();
+		uploadCommandBuffer = BeginSingleTimeCommands(defaultCommandPool);
+		if (!TryAllocateStaging(size, staging))
+		{
+			throw std::runtime_error("staging ring : out of space in an empty ring!");
+		}
+	}
+	return staging;
+}
+
+bool Renderer::TryAllocateStaging(VkDeviceSize size, StagingRing::Region& staging)
+{
+	if (!IsUploadBatchOpen())
+	{
+		return uploadManager.TryAllocateStaging(size, staging);
+	}
+
+	if (size > stagingRing.GetMaxAllocationSize())
+	{
+		CreateBuffer(size, VK_BUFFER_USAGE_TRANSFER_SRC_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, staging.buffer, staging.dedicatedAllocation, DeviceMemoryAllocator::MemoryUsage::Transient);
+		staging.pData = staging.dedicatedAllocation.pMapped;
+		staging.size = size;
+		return true;
+	}
+
+	if (!stagingRing.Allocate(size, StagingRing::ALIGNMENT, staging))
+		return false;
+
+	uploadStats.stagingRingAllocationCount++;
+	uploadStats.stagingSize += size;
+	return true;
+}
+
+void Renderer::UploadBuffer(StagingRing::Region& staging, VkBuffer dstBuffer, VkDeviceSize dstOffset, VkDeviceSize size)
+{
+	if (!IsUploadBatchOpen())
+	{
+		uploadManager.CopyBuffer(staging, dstBuffer, dstOffset, size);
+		return;
+	}
+
+	CopyBuffer(defaultCommandPool, staging.buffer, dstBuffer, size, dstOffset, staging.offset);
+	ReleaseStaging(staging);
+}
+
+void Renderer::UploadImage(StagingRing::Region& staging, VkImage image, VkFormat format, uint32_t width, uint32_t height, uint32_t mipLevels, bool generateMipmaps)
+{
+	if (!IsUploadBatchOpen())
+	{
+		uploadManager.CopyBufferToImage(staging, image, format, width, height, mipLevels, generateMipmaps);
+		return;
+	}
+
+	TransitionImageLayout(defaultCommandPool, image, format, VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, mipLevels);
+	CopyBufferToImage(defaultCommandPool, staging.buffer, image, width, height, staging.offset);
+	ReleaseStaging(staging);
+
+	if (generateMipmaps)
+	{
+		GenerateMipmaps(defaultCommandPool, image, format, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL, width, height, mipLevels);
+	}
+	else
+	{
+		TransitionImageLayout(defaultCommandPool, image, format, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL, mipLevels);
+	}
+}
+
+void Renderer::UploadImageLevels(StagingRing::Region& staging, VkImage image, VkFormat format, uint32_t width, uint32_t height, const std::vector<VkDeviceSize>& levelOffsetVec, uint32_t baseMipLevel, uint32_t levelCount)
+{
+	std::vector<VkBufferImageCopy> regionVec;
+	for (uint32_t i = 0; i < levelOffsetVec.size(); i++)
+	{
+		if (levelOffsetVec[i] == SKIP_LEVEL)
+			continue;
+
+		VkBufferImageCopy region = {};
+		region.bufferOffset = staging.offset + levelOffsetVec[i];
+		region.imageSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+		region.imageSubresource.mipLevel = i;
+		region.imageSubresource.baseArrayLayer = 0;
+		region.imageSubresource.layerCount = 1;
+		region.imageOffset = { 0, 0, 0 };
+		region.imageExtent = { std::max(1u, width >> i), std::max(1u, height >> i), 1 };
+		regionVec.push_back(region);
+	}
+	if (levelCount == 0)
+	{
+		levelCount = static_cast<uint32_t>(levelOffsetVec.size()) - baseMipLevel;
+	}
+
+	if (!IsUploadBatchOpen())
+	{
+		uploadManager.CopyBufferToImageLevels(staging, image, format, regionVec, baseMipLevel, levelCount);
+		return;
+	}
+
+	TransitionImageLayout(defaultCommandPool, image, format, VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, levelCount, baseMipLevel);
+	CopyBufferToImage(defaultCommandPool, staging.buffer, image, regionVec);
+	ReleaseStaging(staging);
+	TransitionImageLayout(defaultCommandPool, image, format, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL, levelCount, baseMipLevel);
+}
+
+void Renderer::RegisterStreamingTexture(Texture* pTexture)
+{
+	pStreamingTextureVec.push_back(pTexture);
+}
+
+void Renderer::UnregisterStreamingTexture(Texture* pTexture)
+{
+	pStreamingTextureVec.erase(std::remove(pStreamingTextureVec.begin(), pStreamingTextureVec.end(), pTexture), pStreamingTextureVec.end());
+}
+
+void Renderer::UpdateTextureStreaming()
+{
+	if (pStreamingTextureVec.empty() || IsUploadBatchOpen())
+		return;
+
+	//every texture records at most one level, all of them go out with one flush
+	VkDeviceSize budget = TEXTURE_STREAMING_BUDGET;
+	std::vector<Texture*> pRecordedTextureVec;
+	for (Texture* pTexture : pStreamingTextureVec)
+	{
+		if (pTexture->UpdateStreaming(budget))
+		{
+			pRecordedTextureVec.push_back(pTexture);
+		}
+	}
+	pStreamingTextureVec.erase(std::remove_if(pStreamingTextureVec.begin(), pStreamingTextureVec.end(), [](Texture* pTexture) { return !pTexture->IsStreaming(); }), pStreamingTextureVec.end());
+	if (pRecordedTextureVec.empty())
+		return;
+
+	UploadTicket ticket = FlushUploads();
+	for (Texture* pTexture : pRecordedTextureVec)
+	{
+		pTexture->SetStreamingTicket(ticket);
+	}
+}
+
+void Renderer::TransitionHostWrittenImage(VkImage image, VkFormat format, uint32_t mipLevels)
+{
+	if (!IsUploadBatchOpen())
+	{
+		uploadManager.TransitionHostWrittenImage(image, mipLevels);
+		return;
+	}
+
+	TransitionImageLayout(defaultCommandPool, image, format, VK_IMAGE_LAYOUT_PREINITIALIZED, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL, mipLevels);
+}
+
+void Renderer::CountDirectWrite(VkDeviceSize size)
+{
+	uploadStats.directWriteCount++;
+	uploadStats.directWriteSize += size;
+}
+
+void Renderer::ReleaseStaging(StagingRing::Region& staging)
+{
+	//ring regions come back when the batch is submitted
+	if (staging.dedicatedAllocation.memory != VK_NULL_HANDLE)
+	{
+		DestroyStagingBuffer(staging.buffer, staging.dedicatedAllocation);
+	}
+	staging = StagingRing::Region();
+}
+
+UploadTicket Renderer::FlushUploads()
+{
+	//a batch has finished on the gpu before anything renders
+	if (IsUploadBatchOpen())
+		return UploadTicket();
+
+	return uploadManager.Flush();
+}
+
+bool Renderer::IsUploadComplete(UploadTicket ticket)
+{
+	return uploadManager.IsComplete(ticket);
+}
+
 // ~ utility ~
 
 VkCommandBuffer Renderer::BeginSingleTimeCommands(VkCommandPool commandPool) 
 {
+	if (uploadCommandBuffer != VK_NULL_HANDLE)
+	{
+		return uploadCommandBuffer;
+	}
+
 	VkCommandBufferAllocateInfo allocInfo = {};
 	allocInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
 	allocInfo.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
@@ -2295,6 +3021,11 @@ VkCommandBuffer Renderer::BeginSingleTimeCommands(VkCommandPool commandPool)
 //contains idle wait
 void Renderer::EndSingleTimeCommands(VkCommandBuffer& commandBuffer, VkCommandPool commandPool) 
 {
+	if (commandBuffer == uploadCommandBuffer)
+	{
+		return;
+	}
+
 	vkEndCommandBuffer(commandBuffer);
 
 	VkSubmitInfo submitInfo = {};
@@ -2304,6 +3035,7 @@ void Renderer::EndSingleTimeCommands(VkCommandBuffer& commandBuffer, VkCommandPo
 
 	vkQueueSubmit(graphicsQueue, 1, &submitInfo, VK_NULL_HANDLE);
 	vkQueueWaitIdle(graphicsQueue);
+	uploadStats.submitCount++;
 
 	vkFreeCommandBuffers(device, commandPool, 1, &commandBuffer);
 }
@@ -7,6 +7,12 @@
 #include <optional>
 
 #include "GlobalInclude.h"
+#include "ThreadPool.h"
+#include "DeviceMemoryAllocator.h"
+#include "GeometryArena.h"
+#include "UploadManager.h"
+#include "SamplerCache.h"
+#include "ImageCache.h"
 
 class Level;
 class Pass;
@@ -36,6 +42,96 @@ public:
 	uint32_t GetGraphicsQueueFamilyIndex() const;
 	GLFWwindow* GetWindow() const;
 	VkSampleCountFlagBits GetSwapChainMsaaSamples() const;
+	//bc1-7 formats can be sampled, the feature is enabled whenever the device has it
+	bool SupportsBlockCompression() const;
+	//integrated gpus whose device local memory is also host visible, resources there are written by the cpu in place instead of through staging
+	bool IsUnifiedMemory() const;
+	//whether an image of the format and size can be sampled with linear tiling, which lets the cpu write its texels directly
+	bool SupportsLinearImage(VkFormat format, uint32_t width, uint32_t height, uint32_t mipLevels) const;
+	//whether an optimal tiling image of the format can be sampled with linear filtering, optional for formats like r8 srgb
+	bool SupportsSampledImage(VkFormat format) const;
+	ThreadPool* GetThreadPool();
+	GeometryArena* GetGeometryArena();
+	const DeviceMemoryAllocator::MemoryStats& GetMemoryStats() const;
+	UploadManager* GetUploadManager();
+	SamplerCache* GetSamplerCache();
+	ImageCache* GetImageCache();
+
+	// ~ pipeline cache ~
+
+	struct PipelineCacheStats
+	{
+		bool warm = false;//a cache of this device and driver was loaded
+		VkDeviceSize loadedSize = 0;
+		VkDeviceSize savedSize = 0;//at the last CleanUp
+		uint32_t pipelineCount = 0;
+		float createPipelinesMs = 0.0f;//all CreatePipeline calls together
+	};
+
+	//kept on disk between runs, loaded at InitVulkan and written back at CleanUp,
+	//every pipeline is created with it, pass it to ImGui as well
+	VkPipelineCache GetPipelineCache() const;
+	const PipelineCacheStats& GetPipelineCacheStats() const;
+
+	// ~ upload batch ~
+
+	//instrumentation of the last InitAssets
+	struct UploadStats
+	{
+		uint32_t submitCount = 0;//queue submissions that waited for the gpu
+		uint32_t stagingRingAllocationCount = 0;
+		uint32_t stagingBufferCount = 0;//uploads too large for the staging ring
+		VkDeviceSize stagingSize = 0;
+		uint32_t directWriteCount = 0;//resources written in place on unified memory, nothing staged or copied
+		VkDeviceSize directWriteSize = 0;
+		float initAssetsMs = 0.0f;
+	};
+
+	static const VkDeviceSize STAGING_RING_SIZE = 64 * 1024 * 1024;
+
+	//while a batch is open every upload helper(CopyBuffer, TransitionImageLayout, CopyBufferToImage, GenerateMipmaps)
+	//records into one command buffer and staging buffers are kept alive, EndUploadBatch submits it with one fence and waits once,
+	//a batch that fills the staging ring is submitted early and continues in a new command buffer,
+	//InitAssets opens one for all levels unless batching is turned off, then the assets go through the upload manager instead
+	void SetBatchUploads(bool _batchUploads);//call before InitAssets
+	void BeginUploadBatch();
+	void EndUploadBatch();
+	bool IsUploadBatchOpen() const;
+	//destroys now, or when the open upload batch has finished on the gpu
+	void DestroyStagingBuffer(VkBuffer buffer, DeviceMemoryAllocator::Allocation& bufferAllocation);
+	const UploadStats& GetUploadStats() const;
+
+	// ~ staged uploads ~
+
+	//these go into the open upload batch, or to the upload manager when no batch is open,
+	//staging memory is carved from one persistently mapped staging ring, only uploads too large for it get a buffer of their own,
+	//write the data to pData of the staging region before handing it to UploadBuffer/UploadImage
+	StagingRing::Region AllocateStaging(VkDeviceSize size);
+	//never submits or waits to make room, regions handed out before stay valid until their uploads are recorded
+	bool TryAllocateStaging(VkDeviceSize size, StagingRing::Region& staging);
+	void UploadBuffer(StagingRing::Region& staging, VkBuffer dstBuffer, VkDeviceSize dstOffset, VkDeviceSize size);
+	//leaves all levels in VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL
+	void UploadImage(StagingRing::Region& staging, VkImage image, VkFormat format, uint32_t width, uint32_t height, uint32_t mipLevels, bool generateMipmaps);
+	//copies prebuilt levels with one copy command, level i of width >> i by height >> i starts at levelOffsetVec[i] of the staging region,
+	//levels at SKIP_LEVEL have no data, the levels from baseMipLevel on(levelCount 0 for all of levelOffsetVec) go from undefined to shader read
+	static const VkDeviceSize SKIP_LEVEL = VK_WHOLE_SIZE;
+	void UploadImageLevels(StagingRing::Region& staging, VkImage image, VkFormat format, uint32_t width, uint32_t height, const std::vector<VkDeviceSize>& levelOffsetVec, uint32_t baseMipLevel = 0, uint32_t levelCount = 0);
+	//a linear image the cpu has written in VK_IMAGE_LAYOUT_PREINITIALIZED goes to VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL, no copy is recorded
+	void TransitionHostWrittenImage(VkImage image, VkFormat format, uint32_t mipLevels);
+	void CountDirectWrite(VkDeviceSize size);
+	// ~ texture streaming ~
+
+	//streaming textures upload their mip tail with the other assets and their larger levels one at a time while rendering,
+	//each frame spends about TEXTURE_STREAMING_BUDGET of staging memory on them, through the upload manager
+	static const VkDeviceSize TEXTURE_STREAMING_BUDGET = 16 * 1024 * 1024;
+	void RegisterStreamingTexture(Texture* pTexture);
+	void UnregisterStreamingTexture(Texture* pTexture);
+	//call once per frame outside of upload batches
+	void UpdateTextureStreaming();
+
+	//the ticket of everything uploaded so far, complete right away for uploads in a batch
+	UploadTicket FlushUploads();
+	bool IsUploadComplete(UploadTicket ticket);
 
 	// ~ utility ~
 
@@ -49,18 +145,24 @@ public:
 
 	// ~ general gpu resource operations ~
 
+	//memory comes from the device memory allocator, host visible memory is mapped at allocation.pMapped
 	void CreateBuffer(
 		VkDeviceSize size, 
 		VkBufferUsageFlags usage, 
 		VkMemoryPropertyFlags properties, 
 		VkBuffer& buffer, 
-		VkDeviceMemory& bufferMemory);
+		DeviceMemoryAllocator::Allocation& bufferAllocation,
+		DeviceMemoryAllocator::MemoryUsage memoryUsage = DeviceMemoryAllocator::MemoryUsage::Pooled);
+
+	void DestroyBuffer(VkBuffer& buffer, DeviceMemoryAllocator::Allocation& bufferAllocation);
 
 	void CopyBuffer(
 		VkCommandPool commandPool, 
 		VkBuffer srcBuffer, 
 		VkBuffer dstBuffer, 
-		VkDeviceSize size);
+		VkDeviceSize size,
+		VkDeviceSize dstOffset = 0,
+		VkDeviceSize srcOffset = 0);
 
 	void CreateImage(
 		uint32_t width, 
@@ -72,7 +174,10 @@ public:
 		VkImageUsageFlags usage,
 		VkMemoryPropertyFlags properties,
 		VkImage& image, 
-		VkDeviceMemory& imageMemory);
+		DeviceMemoryAllocator::Allocation& imageAllocation,
+		VkImageLayout initialLayout = VK_IMAGE_LAYOUT_UNDEFINED);
+
+	void DestroyImage(VkImage& image, DeviceMemoryAllocator::Allocation& imageAllocation);
 
 	void TransitionImageLayout(
 		VkCommandPool commandPool, 
@@ -80,14 +185,22 @@ public:
 		VkFormat format, 
 		VkImageLayout oldLayout, 
 		VkImageLayout newLayout, 
-		uint32_t mipLevels);
+		uint32_t mipLevels,
+		uint32_t baseMipLevel = 0);
 
 	void CopyBufferToImage(
 		VkCommandPool commandPool, 
 		VkBuffer buffer, 
 		VkImage image, 
 		uint32_t width, 
-		uint32_t height);
+		uint32_t height,
+		VkDeviceSize bufferOffset = 0);
+
+	void CopyBufferToImage(
+		VkCommandPool commandPool,
+		VkBuffer buffer,
+		VkImage image,
+		const std::vector<VkBufferImageCopy>& regionVec);
 
 	void GenerateMipmaps(
 		VkCommandPool commandPool, 
@@ -111,7 +224,9 @@ public:
 		VkImage image, 
 		VkFormat format, 
 		VkImageAspectFlags aspectFlags, 
-		uint32_t mipLevels);
+		uint32_t mipLevels,
+		VkComponentMapping components = {},//identity by default
+		uint32_t baseMipLevel = 0);
 
 	// ~ bind descriptors ~
 
@@ -200,7 +315,9 @@ public:
 		VkStencilOp depthFailOp = VK_STENCIL_OP_KEEP,
 		VkStencilOp stencilPassOp = VK_STENCIL_OP_KEEP,
 		VkStencilOp stencilFailOp = VK_STENCIL_OP_KEEP,
-		uint32_t stencilReference = 0);
+		uint32_t stencilReference = 0,
+		VERTEX_FORMAT vertexFormat = VERTEX_FORMAT::Standard,
+		bool splitVertexStreams = false);
 
 	void CreatePipeline(
 		VkPipeline& pipeline,
@@ -293,6 +410,7 @@ private:
 	struct QueueFamilyIndices {
 		std::optional<uint32_t> graphicsFamily;
 		std::optional<uint32_t> presentFamily;
+		std::optional<uint32_t> transferFamily;//graphics family when there is no transfer only family
 
 		bool isComplete() {
 			return graphicsFamily.has_value() && presentFamily.has_value();
@@ -325,6 +443,58 @@ private:
 
 	std::vector<Level*> pLevelVec;
 
+	// ~ cpu workers ~
+
+	ThreadPool threadPool;
+
+	// ~ upload batch ~
+
+	bool batchUploads = true;
+	VkCommandBuffer uploadCommandBuffer = VK_NULL_HANDLE;
+	std::vector<std::pair<VkBuffer, DeviceMemoryAllocator::Allocation>> pendingStagingBufferVec;
+	UploadStats uploadStats;
+
+	// ~ memory of all buffers and images ~
+
+	DeviceMemoryAllocator deviceMemoryAllocator;
+
+	// ~ geometry of all meshes ~
+
+	GeometryArena geometryArena;
+
+	// ~ resources shared between textures ~
+
+	SamplerCache samplerCache;
+	ImageCache imageCache;
+	std::vector<Texture*> pStreamingTextureVec;//textures with levels still to stream
+
+	// ~ pipeline cache ~
+
+	//our header in front of the data of vkGetPipelineCacheData, the driver version is not part of the vulkan header of the data
+	struct PipelineCacheHeader
+	{
+		uint32_t magic;
+		uint32_t version;
+		uint32_t vendorID;
+		uint32_t deviceID;
+		uint32_t driverVersion;
+		uint8_t pipelineCacheUUID[VK_UUID_SIZE];
+		uint32_t PADDING0;
+		uint64_t dataSize;
+		uint64_t dataHash;
+	};
+
+	static const uint32_t PIPELINE_CACHE_MAGIC = 0x43505353;//"SSPC"
+	static const uint32_t PIPELINE_CACHE_VERSION = 1;
+	const std::string PIPELINE_CACHE_FILE = "PipelineCache/pipeline.cache";
+	VkPipelineCache pipelineCache = VK_NULL_HANDLE;
+	PipelineCacheStats pipelineCacheStats;
+
+	// ~ uploads while rendering ~
+
+	StagingRing stagingRing;//shared by upload batches and the upload manager
+	UploadManager uploadManager;
+
 	// ~ app ~
 
 	VkInstance instance;
@@ -336,12 +506,15 @@ private:
 	VkPhysicalDevice physicalDevice = VK_NULL_HANDLE;
 	VkPhysicalDeviceLimits physicalDeviceLimits;
 	VkDevice device;
+	bool textureCompressionBC = false;
+	bool unifiedMemory = false;
 
 	// ~ gpu queue ~ 
 
 	QueueFamilyIndices queueFamilyIndices;
 	VkQueue graphicsQueue;
 	VkQueue presentQueue;
+	VkQueue transferQueue;
 
 	// ~ swap chain resources ~
 
@@ -358,13 +531,13 @@ private:
 	//extracted from VkPhysicalDeviceProperties associated with our selected physical device.
 	VkSampleCountFlagBits swapChainMsaaSamples;
 	VkImage colorImage;
-	VkDeviceMemory colorImageMemory;
+	DeviceMemoryAllocator::Allocation colorImageAllocation;
 	VkImageView colorImageView;
 
 	// ~ depth buffer ~
 
 	VkImage depthImage;
-	VkDeviceMemory depthImageMemory;
+	DeviceMemoryAllocator::Allocation depthImageAllocation;
 	VkImageView depthImageView;
 
 	// ~ barriers ~
@@ -377,6 +550,13 @@ private:
 
 	void CleanUpLevels();
 
+	// ~ upload batch ~
+
+	//submits the open batch, waits for it and frees its staging memory, the batch command buffer is gone afterwards
+	void SubmitUploadBatch();
+	//after the copy out of a staging region of the batch is recorded
+	void ReleaseStaging(StagingRing::Region& staging);
+
 	// ~ debug layer ~
 
 	static VKAPI_ATTR VkBool32 VKAPI_CALL DebugCallback(VkDebugUtilsMessageSeverityFlagBitsEXT messageSeverity, VkDebugUtilsMessageTypeFlagsEXT messageType, const VkDebugUtilsMessengerCallbackDataEXT* pCallbackData, void* pUserData);
@@ -396,6 +576,13 @@ private:
 	QueueFamilyIndices FindQueueFamilies(VkPhysicalDevice device);
 	std::vector<const char*> GetRequiredExtensions();
 
+	// ~ pipeline cache ~
+
+	//a missing file, another device or driver and damaged data all start with an empty cache
+	void CreatePipelineCache();
+	//written to a temporary file and renamed, a crash while saving leaves the old cache
+	void SavePipelineCache();
+
 	// ~ swap chain ~
 
 	void CreateSwapChain();
@@ -416,6 +603,7 @@ private:
 
 	void CreateCommandPool(VkCommandPool& _commandPool);
 	void CreateCommandBuffers(VkCommandPool commandPool, std::vector<VkCommandBuffer>& commandBuffers);
+	//while an upload batch is open these hand out the batch command buffer and do not submit
 	VkCommandBuffer BeginSingleTimeCommands(VkCommandPool commandPool);
 	void EndSingleTimeCommands(VkCommandBuffer& commandBuffer, VkCommandPool commandPool);//contains idle wait
 	uint32_t FindMemoryType(uint32_t typeFilter, VkMemoryPropertyFlags properties);
@@ -0,0 +1,112 @@
+#include "SamplerCache.h"
+
+#include "Renderer.h"
+
+SamplerCache::SamplerCache() :
+	pRenderer(nullptr)
+{
+}
+
+SamplerCache::~SamplerCache()
+{
+	CleanUp();
+}
+
+void SamplerCache::InitSamplerCache(Renderer* _pRenderer)
+{
+	if (_pRenderer == nullptr)
+	{
+		throw std::runtime_error("sampler cache : pRenderer is null!");
+	}
+
+	pRenderer = _pRenderer;
+}
+
+void SamplerCache::CleanUp()
+{
+	if (pRenderer != nullptr)
+	{
+		for (Entry& entry : entryVec)
+		{
+			vkDestroySampler(pRenderer->GetDevice(), entry.sampler, nullptr);
+		}
+		entryVec.clear();
+		stats = SamplerCacheStats();
+		pRenderer = nullptr;
+	}
+}
+
+VkSampler SamplerCache::Acquire(const VkSamplerCreateInfo& samplerInfo)
+{
+	if (pRenderer == nullptr)
+	{
+		throw std::runtime_error("sampler cache : not initialized!");
+	}
+
+	stats.referenceCount++;
+	for (Entry& entry : entryVec)
+	{
+		if (IsEqual(entry.samplerInfo, samplerInfo))
+		{
+			entry.referenceCount++;
+			return entry.sampler;
+		}
+	}
+
+	Entry entry = { samplerInfo, VK_NULL_HANDLE, 1 };
+	entry.samplerInfo.pNext = nullptr;
+	if (vkCreateSampler(pRenderer->GetDevice(), &samplerInfo, nullptr, &entry.sampler) != VK_SUCCESS) {
+		throw std::runtime_error("failed to create texture sampler!");
+	}
+	entryVec.push_back(entry);
+	stats.samplerCount++;
+	return entry.sampler;
+}
+
+void SamplerCache::Release(VkSampler sampler)
+{
+	if (pRenderer == nullptr || sampler == VK_NULL_HANDLE)
+		return;
+
+	for (size_t i = 0; i < entryVec.size(); i++)
+	{
+		if (entryVec[i].sampler != sampler)
+			continue;
+
+		stats.referenceCount--;
+		if (--entryVec[i].referenceCount == 0)
+		{
+			vkDestroySampler(pRenderer->GetDevice(), sampler, nullptr);
+			entryVec[i] = entryVec.back();
+			entryVec.pop_back();
+			stats.samplerCount--;
+		}
+		return;
+	}
+}
+
+const SamplerCache::SamplerCacheStats& SamplerCache::GetSamplerCacheStats() const
+{
+	return stats;
+}
+
+//field by field, the padding inside the create info is not guaranteed to be zero
+bool SamplerCache::IsEqual(const VkSamplerCreateInfo& a, const VkSamplerCreateInfo& b)
+{
+	return a.flags == b.flags &&
+		a.magFilter == b.magFilter &&
+		a.minFilter == b.minFilter &&
+		a.mipmapMode == b.mipmapMode &&
+		a.addressModeU == b.addressModeU &&
+		a.addressModeV == b.addressModeV &&
+		a.addressModeW == b.addressModeW &&
+		a.mipLodBias == b.mipLodBias &&
+		a.anisotropyEnable == b.anisotropyEnable &&
+		a.maxAnisotropy == b.maxAnisotropy &&
+		a.compareEnable == b.compareEnable &&
+		a.compareOp == b.compareOp &&
+		a.minLod == b.minLod &&
+		a.maxLod == b.maxLod &&
+		a.borderColor == b.borderColor &&
+		a.unnormalizedCoordinates == b.unnormalizedCoordinates;
+}
@@ -0,0 +1,43 @@
+#pragma once
+
+#include "GlobalInclude.h"
+
+class Renderer;
+
+//samplers shared by every texture with the same create info, textures mostly differ in their images and not in how they are sampled,
+//a sampler is destroyed once the last texture using it has released it
+class SamplerCache
+{
+public:
+	//instrumentation
+	struct SamplerCacheStats
+	{
+		uint32_t samplerCount = 0;
+		uint32_t referenceCount = 0;
+	};
+
+	SamplerCache();
+	~SamplerCache();
+
+	void InitSamplerCache(Renderer* _pRenderer);
+	void CleanUp();
+
+	//creates the sampler on the first request of its create info, pNext chains are not compared
+	VkSampler Acquire(const VkSamplerCreateInfo& samplerInfo);
+	void Release(VkSampler sampler);
+	const SamplerCacheStats& GetSamplerCacheStats() const;
+
+private:
+	struct Entry
+	{
+		VkSamplerCreateInfo samplerInfo;
+		VkSampler sampler;
+		uint32_t referenceCount;
+	};
+
+	Renderer* pRenderer;
+	std::vector<Entry> entryVec;//a handful of samplers, searched linearly
+	SamplerCacheStats stats;
+
+	static bool IsEqual(const VkSamplerCreateInfo& a, const VkSamplerCreateInfo& b);
+};
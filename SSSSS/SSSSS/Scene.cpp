@@ -64,8 +64,7 @@ void Scene::CleanUp()
 	if (pRenderer != nullptr)
 	{
 		vkDestroyDescriptorSetLayout(pRenderer->GetDevice(), sceneDescriptorSetLayout, nullptr);
-		vkDestroyBuffer(pRenderer->GetDevice(), sceneUniformBuffer, nullptr);
-		vkFreeMemory(pRenderer->GetDevice(), sceneUniformBufferMemory, nullptr);
+		pRenderer->DestroyBuffer(sceneUniformBuffer, sceneUniformBufferAllocation);
 		pRenderer = nullptr;
 	}
 }
@@ -151,9 +150,8 @@ void Scene::UpdateSceneUniformBuffer(int frame)
 	void* data;
 	VkDeviceSize size = sizeof(sUBO);
 	VkDeviceSize offset = pRenderer->GetAlignedUboOffset(size, frame);
-	vkMapMemory(pRenderer->GetDevice(), sceneUniformBufferMemory, offset, size, 0, &data);
+	data = static_cast<uint8_t*>(sceneUniformBufferAllocation.pMapped) + offset;
 	memcpy(data, &sUBO, sizeof(sUBO));
-	vkUnmapMemory(pRenderer->GetDevice(), sceneUniformBufferMemory);
 }
 
 void Scene::CreateSceneUniformBuffer(int frameCount)
@@ -164,7 +162,7 @@ void Scene::CreateSceneUniformBuffer(int frameCount)
 		VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT, 
 		VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, 
 		sceneUniformBuffer, 
-		sceneUniformBufferMemory);
+		sceneUniformBufferAllocation);
 
 	for (int i = 0; i < frameCount; i++)
 	{
@@ -1,6 +1,7 @@
 #pragma once
 
 #include "GlobalInclude.h"
+#include "DeviceMemoryAllocator.h"
 
 class Renderer;
 class Pass;
@@ -48,7 +49,7 @@ private:
 
 	//scene uniform
 	VkBuffer sceneUniformBuffer;
-	VkDeviceMemory sceneUniformBufferMemory;
+	DeviceMemoryAllocator::Allocation sceneUniformBufferAllocation;
 	std::vector<VkDescriptorSet> sceneDescriptorSetVec;
 	VkDescriptorSetLayout sceneDescriptorSetLayout;
 
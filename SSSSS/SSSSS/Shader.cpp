@@ -1,7 +1,12 @@
 #include "Shader.h"
 #include "ShaderIncluder.h"
+#include "ShaderCache.h"
+
+#include <chrono>
+#include <filesystem>
 
 #include "Renderer.h"
+#include "Hash.h"
 
 Shader::Shader() : Shader(ShaderType::Count, "no_file")
 {
@@ -10,8 +15,11 @@ Shader::Shader() : Shader(ShaderType::Count, "no_file")
 Shader::Shader(const ShaderType& _type, const std::string& _fileName) :
 	type(_type),
 	fileName(_fileName),
+	vertexFormat(VERTEX_FORMAT::Standard),
+	vertexInput(VERTEX_INPUT::All),
 	shaderBytecode(0),
-	shaderString("no file")
+	shaderString("no file"),
+	useShaderCache(true)
 {
 	shaderStageInfo = {};
 }
@@ -29,43 +37,81 @@ void Shader::InitShader(Renderer* _pRenderer)
 		throw std::runtime_error("shader " + fileName + " : pRenderer is null!");
 	}
 
+	shaderc::Compiler compiler;
+	CompileShader(compiler, nullptr);
+
 	pRenderer = _pRenderer;
+	CreateShaderStage();
+}
+
+void Shader::InitShaders(Renderer* pRenderer, const std::vector<Shader*>& pShaderVec)
+{
+	if (pRenderer == nullptr)
+	{
+		throw std::runtime_error("shaders : pRenderer is null!");
+	}
+
+	//one compiler for all threads, its compile functions do not change it,
+	//the include cache reads every include once, however many shaders pull it in
+	shaderc::Compiler compiler;
+	ShaderIncludeCache includeCache;
+	pRenderer->GetThreadPool()->ParallelFor(static_cast<uint32_t>(pShaderVec.size()), 1, [&](uint32_t begin, uint32_t end)
+	{
+		for (uint32_t i = begin; i < end; i++)
+		{
+			pShaderVec[i]->CompileShader(compiler, &includeCache);
+		}
+	});
+
+	//shader modules are created on the calling thread
+	for (auto pShader : pShaderVec)
+	{
+		pShader->pRenderer = pRenderer;
+		pShader->CreateShaderStage();
+	}
+}
+
+void Shader::CompileShader(const shaderc::Compiler& compiler, ShaderIncludeCache* pIncludeCache)
+{
 	if (type == ShaderType::VertexShader)
 	{
-		if(!CreateShaderFromFile(shaderc_vertex_shader, false))
+		if(!CreateShaderFromFile(shaderc_vertex_shader, false, compiler, pIncludeCache))
 			throw std::runtime_error("shader " + fileName + " : create shader failed!");
 
 		shaderStageInfo.stage = VK_SHADER_STAGE_VERTEX_BIT;
 	}
 	else if (type == ShaderType::TessellationControlShader)
 	{
-		if(!CreateShaderFromFile(shaderc_tess_control_shader, false))
+		if(!CreateShaderFromFile(shaderc_tess_control_shader, false, compiler, pIncludeCache))
 			throw std::runtime_error("shader " + fileName + " : create shader failed!");
 
 		shaderStageInfo.stage = VK_SHADER_STAGE_TESSELLATION_CONTROL_BIT;
 	}
 	else if (type == ShaderType::TessellationEvaluationShader)
 	{
-		if(!CreateShaderFromFile(shaderc_tess_evaluation_shader, false))
+		if(!CreateShaderFromFile(shaderc_tess_evaluation_shader, false, compiler, pIncludeCache))
 			throw std::runtime_error("shader " + fileName + " : create shader failed!");
 
 		shaderStageInfo.stage = VK_SHADER_STAGE_TESSELLATION_EVALUATION_BIT;
 	}
 	else if (type == ShaderType::GeometryShader)
 	{
-		if(!CreateShaderFromFile(shaderc_geometry_shader, false))
+		if(!CreateShaderFromFile(shaderc_geometry_shader, false, compiler, pIncludeCache))
 			throw std::runtime_error("shader " + fileName + " : create shader failed!");
 
 		shaderStageInfo.stage = VK_SHADER_STAGE_GEOMETRY_BIT;
 	}
 	else if (type == ShaderType::FragmentShader)
 	{
-		if(!CreateShaderFromFile(shaderc_fragment_shader, false))
+		if(!CreateShaderFromFile(shaderc_fragment_shader, false, compiler, pIncludeCache))
 			throw std::runtime_error("shader " + fileName + " : create shader failed!");
 
 		shaderStageInfo.stage = VK_SHADER_STAGE_FRAGMENT_BIT;
 	}
+}
 
+void Shader::CreateShaderStage()
+{
 	CreateShaderModule(pRenderer->GetDevice());
 	shaderStageInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
 	shaderStageInfo.module = shaderModule;
@@ -100,6 +146,36 @@ const std::string Shader::GetFileName() const
 	return fileName;
 }
 
+void Shader::SetVertexFormat(VERTEX_FORMAT _vertexFormat)
+{
+	vertexFormat = _vertexFormat;
+}
+
+VERTEX_FORMAT Shader::GetVertexFormat() const
+{
+	return vertexFormat;
+}
+
+void Shader::SetVertexInput(VERTEX_INPUT _vertexInput)
+{
+	vertexInput = _vertexInput;
+}
+
+VERTEX_INPUT Shader::GetVertexInput() const
+{
+	return vertexInput;
+}
+
+void Shader::SetUseShaderCache(bool _useShaderCache)
+{
+	useShaderCache = _useShaderCache;
+}
+
+const Shader::ShaderStats& Shader::GetShaderStats() const
+{
+	return shaderStats;
+}
+
 void Shader::ResetShaderBytecode()
 {
 	shaderBytecode.clear();
@@ -126,19 +202,70 @@ bool Shader::ReadShaderFromFile()
 	return true;
 }
 
-bool Shader::CreateShaderFromFile(shaderc_shader_kind kind, bool optimize)
+std::vector<std::pair<std::string, std::string>> Shader::GetMacroDefinitions(shaderc_shader_kind kind) const
+{
+	std::vector<std::pair<std::string, std::string>> macroVec;
+	// like -DMY_DEFINE=1
+	//macroVec.push_back({ "MY_DEFINE", "1" });
+	//selects the vertex inputs in GlobalIncludeVert.glsl
+	if (kind == shaderc_vertex_shader && vertexFormat == VERTEX_FORMAT::Compact)
+		macroVec.push_back({ "VERTEX_FORMAT_COMPACT", "1" });
+	else if (kind == shaderc_vertex_shader && vertexFormat == VERTEX_FORMAT::CompactQuantized)
+		macroVec.push_back({ "VERTEX_FORMAT_COMPACT_QUANTIZED", "1" });
+	if (kind == shaderc_vertex_shader && vertexInput == VERTEX_INPUT::PositionOnly)
+		macroVec.push_back({ "VERTEX_INPUT_POSITION_ONLY", "1" });
+	else if (kind == shaderc_vertex_shader && vertexInput == VERTEX_INPUT::PositionNormal)
+		macroVec.push_back({ "VERTEX_INPUT_POSITION_NORMAL", "1" });
+	return macroVec;
+}
+
+std::string Shader::GetCompileOptionsKey(shaderc_shader_kind kind, bool optimize) const
+{
+	//shaderc has no version of its own, the spir-v version and revision of its glslang change with every release
+	unsigned int spvVersion = 0;
+	unsigned int spvRevision = 0;
+	shaderc_get_spv_version(&spvVersion, &spvRevision);
+
+	std::string key = "kind=" + std::to_string(kind) + ";optimize=" + std::to_string(optimize) + ";spv=" + std::to_string(spvVersion) + "." + std::to_string(spvRevision);
+	for (const auto& macro : GetMacroDefinitions(kind))
+	{
+		key += ";" + macro.first + "=" + macro.second;
+	}
+	return key;
+}
+
+bool Shader::CreateShaderFromFile(shaderc_shader_kind kind, bool optimize, const shaderc::Compiler& compiler, ShaderIncludeCache* pIncludeCache)
 {
+	auto startTime = std::chrono::high_resolution_clock::now();
+	shaderStats = ShaderStats();
+
 	// read shader string
 	if (!ReadShaderFromFile())
 		return false;
 
-	shaderc::Compiler compiler;
+	//a warm cache reads the spir-v after hashing the source and the includes, nothing is parsed
+	std::string optionsKey = GetCompileOptionsKey(kind, optimize);
+	uint64_t optionsHash = Hash64(optionsKey.data(), optionsKey.size());
+	uint64_t sourceHash = Hash64(shaderString.data(), shaderString.size(), optionsHash);
+	std::string cacheFileName = SHADER_CACHE_DIRECTORY + std::filesystem::path(fileName).filename().string() + "." + HashToString(sourceHash) + ".spv";
+	ShaderCache shaderCache;
+	if (useShaderCache && shaderCache.Open(cacheFileName, sourceHash) && shaderCache.AreDependenciesCurrent(pIncludeCache))
+	{
+		const uint32_t* code = shaderCache.GetCode();
+		shaderBytecode.assign(code, code + shaderCache.GetHeader().codeSize / sizeof(uint32_t));
+		shaderStats.fromShaderCache = true;
+		shaderStats.createMs = std::chrono::duration<float, std::chrono::milliseconds::period>(std::chrono::high_resolution_clock::now() - startTime).count();
+		return true;
+	}
+
 	shaderc::CompileOptions options;
 
-	// like -DMY_DEFINE=1
-	//options.AddMacroDefinition("MY_DEFINE", "1");
+	for (const auto& macro : GetMacroDefinitions(kind))
+		options.AddMacroDefinition(macro.first, macro.second);
 	if (optimize) options.SetOptimizationLevel(shaderc_optimization_level_size);
-	std::unique_ptr<ShaderIncluder> includer(new ShaderIncluder(&shaderc_util::FileFinder()));
+	shaderc_util::FileFinder fileFinder;//referenced by the includer, has to outlive the compile
+	std::unique_ptr<ShaderIncluder> includer(new ShaderIncluder(&fileFinder, pIncludeCache));
+	const ShaderIncluder* pIncluder = includer.get();//owned by options from here on
 	options.SetIncluder(std::move(includer));
 
 	//std::cout << "output 1:" << shaderString << std::endl;
@@ -153,20 +280,52 @@ bool Shader::CreateShaderFromFile(shaderc_shader_kind kind, bool optimize)
 	}
 
 	shaderString = { preprocessed.cbegin(), preprocessed.cend() };
+	shaderStats.preprocessed = true;
 
 	//std::cout << "output 2:" << shaderString << std::endl;
 
-	// compile
-	shaderc::SpvCompilationResult module = compiler.CompileGlslToSpv(shaderString, kind, fileName.c_str(), options);
+	//the includes of the source, with their content as it is now
+	ShaderCache::Header header;
+	header.sourceHash = sourceHash;
+	header.preprocessedHash = Hash64(shaderString.data(), shaderString.size(), optionsHash);
+	std::vector<ShaderCache::Dependency> dependencyVec;
+	bool dependenciesHashed = true;
+	for (const auto& includePath : pIncluder->file_path_trace())
+	{
+		ShaderCache::Dependency dependency = { includePath, 0 };
+		dependenciesHashed &= ShaderCache::HashFile(includePath, dependency.contentHash, pIncludeCache);
+		dependencyVec.push_back(dependency);
+	}
 
-	if (module.GetCompilationStatus() != shaderc_compilation_status_success)
+	//an include changed in a way the preprocessor drops(comments, unused macros), the cached spir-v is still right
+	if (shaderCache.IsOpen() && shaderCache.GetHeader().preprocessedHash == header.preprocessedHash)
 	{
-		throw std::runtime_error(module.GetErrorMessage());
-		return false;
+		const uint32_t* code = shaderCache.GetCode();
+		shaderBytecode.assign(code, code + shaderCache.GetHeader().codeSize / sizeof(uint32_t));
+		shaderStats.fromShaderCache = true;
 	}
+	else
+	{
+		// compile
+		shaderc::SpvCompilationResult module = compiler.CompileGlslToSpv(shaderString, kind, fileName.c_str(), options);
 
-	shaderBytecode = { module.cbegin(), module.cend() };// not sure why sample code copy vector like this
+		if (module.GetCompilationStatus() != shaderc_compilation_status_success)
+		{
+			throw std::runtime_error(module.GetErrorMessage());
+			return false;
+		}
+
+		shaderBytecode = { module.cbegin(), module.cend() };// not sure why sample code copy vector like this
+	}
+	shaderCache.Close();
+
+	//rewritten on a preprocessed hit as well, so the next start takes the fast path again
+	if (useShaderCache && dependenciesHashed)
+	{
+		ShaderCache::Write(cacheFileName, header, dependencyVec, shaderBytecode.data(), shaderBytecode.size() * sizeof(uint32_t));
+	}
 
+	shaderStats.createMs = std::chrono::duration<float, std::chrono::milliseconds::period>(std::chrono::high_resolution_clock::now() - startTime).count();
 	return true;
 }
 
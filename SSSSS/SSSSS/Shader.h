@@ -5,6 +5,7 @@
 #include "GlobalInclude.h"
 
 class Renderer;
+class ShaderIncludeCache;
 
 using namespace shaderc;
 
@@ -13,6 +14,13 @@ class Shader
 public:
 	enum class ShaderType { VertexShader, TessellationControlShader, TessellationEvaluationShader, GeometryShader, FragmentShader, Count };
 
+	struct ShaderStats
+	{
+		bool fromShaderCache = false;//the spir-v was read from the shader cache, nothing was compiled
+		bool preprocessed = false;//the source or an include changed since the cache was written, the preprocessor ran
+		float createMs = 0.0f;//reading or compiling the spir-v
+	};
+
 	Shader();
 	Shader(const ShaderType& _type, const std::string& _fileName);
 	~Shader();
@@ -20,22 +28,46 @@ public:
 	const std::string GetFileName() const;
 	VkPipelineShaderStageCreateInfo GetShaderStageInfo() const;
 	ShaderType GetShaderType() const;
+	void SetVertexFormat(VERTEX_FORMAT _vertexFormat);//call before InitShader, only affects vertex shaders
+	VERTEX_FORMAT GetVertexFormat() const;
+	void SetVertexInput(VERTEX_INPUT _vertexInput);//call before InitShader, only affects vertex shaders
+	VERTEX_INPUT GetVertexInput() const;
+	//spir-v is cached by the hash of the source and the compile options, a cached shader is compiled again when an include changed,
+	//unless its preprocessed source is still the same
+	void SetUseShaderCache(bool _useShaderCache);//call before InitShader
+	const ShaderStats& GetShaderStats() const;
 
 	void ResetShaderBytecode();
 
 	void InitShader(Renderer* _pRenderer);
+	//compiles the shaders on the worker threads of the renderer, then creates their shader modules
+	static void InitShaders(Renderer* pRenderer, const std::vector<Shader*>& pShaderVec);
 	void CleanUp();
 
 private:
 	Renderer* pRenderer;
 	ShaderType type;
 	std::string fileName;
+	VERTEX_FORMAT vertexFormat;
+	VERTEX_INPUT vertexInput;
 	std::vector<uint32_t> shaderBytecode;
 	std::string shaderString;
 	VkShaderModule shaderModule;
 	VkPipelineShaderStageCreateInfo shaderStageInfo;
+	ShaderStats shaderStats;
+
+	// ~ shader cache ~
+
+	bool useShaderCache;
+	const std::string SHADER_CACHE_DIRECTORY = "ShaderCache/";
 
 	bool ReadShaderFromFile(); 
-	bool CreateShaderFromFile(shaderc_shader_kind kind, bool optimize = false);
+	//both are safe to call for different shaders on different threads, pIncludeCache can be null
+	void CompileShader(const shaderc::Compiler& compiler, ShaderIncludeCache* pIncludeCache);
+	bool CreateShaderFromFile(shaderc_shader_kind kind, bool optimize, const shaderc::Compiler& compiler, ShaderIncludeCache* pIncludeCache);
+	//the macros of the shader, the optimization level and the spir-v version of the linked shaderc, as one string for the cache keys
+	std::string GetCompileOptionsKey(shaderc_shader_kind kind, bool optimize) const;
+	std::vector<std::pair<std::string, std::string>> GetMacroDefinitions(shaderc_shader_kind kind) const;
 	void CreateShaderModule(const VkDevice& device);
+	void CreateShaderStage();
 };
@@ -0,0 +1,185 @@
+#include "ShaderCache.h"
+
+#include <fstream>
+#include <filesystem>
+#include <cstring>
+
+#include "Hash.h"
+#include "ShaderIncluder.h"
+
+ShaderCache::ShaderCache() :
+	pCode(nullptr)
+{
+}
+
+ShaderCache::~ShaderCache()
+{
+	Close();
+}
+
+bool ShaderCache::Open(const std::string& fileName, uint64_t sourceHash)
+{
+	Close();
+
+	if (!file.Open(fileName))
+		return false;
+
+	const char* data = file.GetData();
+	uint64_t size = file.GetSize();
+	if (size < sizeof(Header))
+	{
+		Close();
+		return false;
+	}
+
+	memcpy(&header, data, sizeof(Header));
+	if (header.magic != MAGIC ||
+		header.version != VERSION ||
+		header.sourceHash != sourceHash ||
+		header.codeOffset > size ||
+		header.codeSize > size - header.codeOffset ||
+		header.codeOffset % CODE_ALIGNMENT != 0 ||
+		header.codeSize % sizeof(uint32_t) != 0 ||
+		header.dependencyOffset > header.codeOffset)
+	{
+		Close();
+		return false;
+	}
+
+	uint64_t offset = header.dependencyOffset;
+	for (uint32_t i = 0; i < header.dependencyCount; i++)
+	{
+		DependencyRecord record;
+		if (sizeof(DependencyRecord) > header.codeOffset - offset)
+		{
+			Close();
+			return false;
+		}
+		memcpy(&record, data + offset, sizeof(DependencyRecord));
+		offset += sizeof(DependencyRecord);
+		if (record.pathSize > header.codeOffset - offset)
+		{
+			Close();
+			return false;
+		}
+		dependencyVec.push_back({ std::string(data + offset, record.pathSize), record.contentHash });
+		offset += record.pathSize;
+	}
+
+	pCode = reinterpret_cast<const uint32_t*>(data + header.codeOffset);
+	return true;
+}
+
+void ShaderCache::Close()
+{
+	file.Close();
+	header = Header();
+	dependencyVec.clear();
+	pCode = nullptr;
+}
+
+bool ShaderCache::IsOpen() const
+{
+	return pCode != nullptr;
+}
+
+const ShaderCache::Header& ShaderCache::GetHeader() const
+{
+	return header;
+}
+
+const std::vector<ShaderCache::Dependency>& ShaderCache::GetDependencyVec() const
+{
+	return dependencyVec;
+}
+
+const uint32_t* ShaderCache::GetCode() const
+{
+	return pCode;
+}
+
+bool ShaderCache::AreDependenciesCurrent(ShaderIncludeCache* pIncludeCache) const
+{
+	for (const auto& dependency : dependencyVec)
+	{
+		uint64_t contentHash;
+		if (!HashFile(dependency.path, contentHash, pIncludeCache) || contentHash != dependency.contentHash)
+			return false;
+	}
+	return true;
+}
+
+bool ShaderCache::HashFile(const std::string& fileName, uint64_t& contentHash, ShaderIncludeCache* pIncludeCache)
+{
+	if (pIncludeCache != nullptr)
+	{
+		std::shared_ptr<const ShaderIncludeCache::File> pFile = pIncludeCache->GetFile(fileName);
+		if (pFile == nullptr)
+			return false;
+
+		contentHash = pFile->contentHash;
+		return true;
+	}
+
+	MappedFile dependencyFile;
+	if (!dependencyFile.Open(fileName))
+		return false;
+
+	contentHash = Hash64(dependencyFile.GetData(), dependencyFile.GetSize());
+	return true;
+}
+
+bool ShaderCache::Write(const std::string& fileName, const Header& header, const std::vector<Dependency>& dependencyVec, const uint32_t* code, uint64_t codeSize)
+{
+	std::error_code error;
+	std::filesystem::path path(fileName);
+	if (path.has_parent_path())
+	{
+		std::filesystem::create_directories(path.parent_path(), error);
+	}
+
+	Header fileHeader = header;
+	fileHeader.magic = MAGIC;
+	fileHeader.version = VERSION;
+	fileHeader.dependencyCount = static_cast<uint32_t>(dependencyVec.size());
+	fileHeader.dependencyOffset = sizeof(Header);
+	uint64_t dependencyEnd = fileHeader.dependencyOffset;
+	for (const auto& dependency : dependencyVec)
+	{
+		dependencyEnd += sizeof(DependencyRecord) + dependency.path.size();
+	}
+	fileHeader.codeOffset = (dependencyEnd + CODE_ALIGNMENT - 1) / CODE_ALIGNMENT * CODE_ALIGNMENT;
+	fileHeader.codeSize = codeSize;
+
+	std::string tempFileName = fileName + ".tmp";
+	{
+		std::ofstream out(tempFileName, std::ios::binary | std::ios::trunc);
+		if (!out.is_open())
+			return false;
+
+		out.write(reinterpret_cast<const char*>(&fileHeader), sizeof(Header));
+		for (const auto& dependency : dependencyVec)
+		{
+			DependencyRecord record = { dependency.contentHash, static_cast<uint32_t>(dependency.path.size()), 0 };
+			out.write(reinterpret_cast<const char*>(&record), sizeof(DependencyRecord));
+			out.write(dependency.path.data(), dependency.path.size());
+		}
+		const char zeros[CODE_ALIGNMENT] = {};
+		out.write(zeros, fileHeader.codeOffset - dependencyEnd);
+		out.write(reinterpret_cast<const char*>(code), codeSize);
+		if (!out.good())
+		{
+			out.close();
+			std::filesystem::remove(tempFileName, error);
+			return false;
+		}
+	}
+
+	std::filesystem::rename(tempFileName, fileName, error);
+	if (error)
+	{
+		std::filesystem::remove(tempFileName, error);
+		return false;
+	}
+	return true;
+}
@@ -0,0 +1,69 @@
+#pragma once
+
+#include "GlobalInclude.h"
+#include "MappedFile.h"
+
+class ShaderIncludeCache;
+
+//versioned binary file holding the spir-v of one shader and the include files it was built from,
+//keyed by the hash of the source and the compile options, the includes are checked against the hashes of their content
+class ShaderCache
+{
+public:
+	static const uint32_t MAGIC = 0x56505353;//"SSPV"
+	static const uint32_t VERSION = 1;//bump whenever the layout of the file changes or another shaderc is linked
+
+	struct Header
+	{
+		uint32_t magic = MAGIC;
+		uint32_t version = VERSION;
+		uint64_t sourceHash = 0;//hash of the source file content and the compile options
+		uint64_t preprocessedHash = 0;//hash of the preprocessed source and the compile options
+		uint32_t dependencyCount = 0;
+		uint32_t PADDING0 = 0;
+		uint64_t dependencyOffset = 0;//in bytes from the start of the file
+		uint64_t codeOffset = 0;
+		uint64_t codeSize = 0;//in bytes
+	};
+
+	//an included file, by the path the includer resolved it to
+	struct Dependency
+	{
+		std::string path;
+		uint64_t contentHash;
+	};
+
+	ShaderCache();
+	~ShaderCache();
+
+	//maps the file and validates it against the source hash, returns false on any mismatch
+	bool Open(const std::string& fileName, uint64_t sourceHash);
+	void Close();
+	bool IsOpen() const;
+	const Header& GetHeader() const;
+	const std::vector<Dependency>& GetDependencyVec() const;
+	const uint32_t* GetCode() const;
+	//false once any include is missing or its content changed, the files come from pIncludeCache when it is not null
+	bool AreDependenciesCurrent(ShaderIncludeCache* pIncludeCache = nullptr) const;
+
+	//false when the file can not be read
+	static bool HashFile(const std::string& fileName, uint64_t& contentHash, ShaderIncludeCache* pIncludeCache = nullptr);
+	//writes to a temporary file first and renames it, so an interrupted write never leaves a truncated cache behind
+	static bool Write(const std::string& fileName, const Header& header, const std::vector<Dependency>& dependencyVec, const uint32_t* code, uint64_t codeSize);
+
+private:
+	//followed by pathSize bytes of the path
+	struct DependencyRecord
+	{
+		uint64_t contentHash;
+		uint32_t pathSize;
+		uint32_t PADDING0;
+	};
+
+	static const uint64_t CODE_ALIGNMENT = 16;
+
+	MappedFile file;
+	Header header;
+	std::vector<Dependency> dependencyVec;
+	const uint32_t* pCode;
+};
@@ -1,5 +1,24 @@
 #include "ShaderIncluder.h"
 #include "Dependencies/shaderc_util/include/io.h"
+#include "Hash.h"
+
+std::shared_ptr<const ShaderIncludeCache::File> ShaderIncludeCache::GetFile(const std::string& fullPath)
+{
+	//read under the lock, so a file several shaders ask for at once is still read only once
+	std::lock_guard<std::mutex> lock(fileMutex);
+	auto iterator = pFileMap.find(fullPath);
+	if (iterator != pFileMap.end())
+		return iterator->second;
+
+	std::shared_ptr<File> pFile = std::make_shared<File>();
+	if (!shaderc_util::ReadFile(fullPath, &pFile->contents))
+		pFile = nullptr;
+	else
+		pFile->contentHash = Hash64(pFile->contents.data(), pFile->contents.size());
+
+	pFileMap[fullPath] = pFile;
+	return pFile;
+}
 
 shaderc_include_result* MakeErrorIncludeResult(const char* message) {
 	return new shaderc_include_result{ "", 0, message, strlen(message) };
@@ -24,16 +43,27 @@ shaderc_include_result* ShaderIncluder::GetInclude(
 	// time.  Protect the included_files.
 
 	// Read the file and save its full path and contents into stable addresses.
-	FileInfo* new_file_info = new FileInfo{ full_path, {} };
-	if (!shaderc_util::ReadFile(full_path, &(new_file_info->contents))) {
+	FileInfo* new_file_info = new FileInfo{ full_path, {}, nullptr };
+	if (include_cache_ != nullptr) {
+		new_file_info->cached_file = include_cache_->GetFile(full_path);
+		if (new_file_info->cached_file == nullptr) {
+			delete new_file_info;
+			return MakeErrorIncludeResult("Cannot read file");
+		}
+	}
+	else if (!shaderc_util::ReadFile(full_path, &(new_file_info->contents))) {
+		delete new_file_info;
 		return MakeErrorIncludeResult("Cannot read file");
 	}
 
 	included_files_.insert(full_path);
 
+	const std::vector<char>& contents = new_file_info->cached_file != nullptr
+		? new_file_info->cached_file->contents
+		: new_file_info->contents;
 	return new shaderc_include_result{
 		new_file_info->full_path.data(), new_file_info->full_path.length(),
-		new_file_info->contents.data(), new_file_info->contents.size(),
+		contents.data(), contents.size(),
 		new_file_info };
 }
 
@@ -3,12 +3,36 @@
 #include "Dependencies/shaderc_util/include/file_finder.h"
 #include "Dependencies/shaderc/include/shaderc.hpp"
 #include <unordered_set>
+#include <unordered_map>
+#include <memory>
+#include <mutex>
+
+//contents of include files, read once and shared by the includers of all shaders compiled together,
+//safe to use from several threads
+class ShaderIncludeCache
+{
+public:
+	struct File
+	{
+		std::vector<char> contents;
+		uint64_t contentHash;
+	};
+
+	//null when the file can not be read
+	std::shared_ptr<const File> GetFile(const std::string& fullPath);
+
+private:
+	std::mutex fileMutex;
+	std::unordered_map<std::string, std::shared_ptr<const File>> pFileMap;//unreadable files are kept as null
+};
 
 class ShaderIncluder : public shaderc::CompileOptions::IncluderInterface
 {
 public:
-	explicit ShaderIncluder(const shaderc_util::FileFinder* file_finder)
-		: file_finder_(*file_finder) {}
+	// include_cache may be null, the files are then read for every include.
+	explicit ShaderIncluder(const shaderc_util::FileFinder* file_finder,
+		ShaderIncludeCache* include_cache = nullptr)
+		: file_finder_(*file_finder), include_cache_(include_cache) {}
 
 	~ShaderIncluder() override;
 
@@ -30,10 +54,14 @@ public:
 private:
 	// Used by GetInclude() to get the full filepath.
 	const shaderc_util::FileFinder& file_finder_;
+	// Shared with the includers of other compiles, can be null.
+	ShaderIncludeCache* include_cache_;
 	// The full path and content of a source file.
 	struct FileInfo {
 		const std::string full_path;
 		std::vector<char> contents;
+		// Holds the contents when they come from the include cache.
+		std::shared_ptr<const ShaderIncludeCache::File> cached_file;
 	};
 
 	// The set of full paths of included files.
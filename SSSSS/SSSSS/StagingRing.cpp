@@ -0,0 +1,104 @@
+#include "StagingRing.h"
+
+#include "Renderer.h"
+
+StagingRing::StagingRing() :
+	pRenderer(nullptr), buffer(VK_NULL_HANDLE), pMapped(nullptr), size(0), writePosition(0), readPosition(0)
+{
+}
+
+StagingRing::~StagingRing()
+{
+	CleanUp();
+}
+
+void StagingRing::InitStagingRing(Renderer* _pRenderer, VkDeviceSize _size)
+{
+	if (_pRenderer == nullptr)
+	{
+		throw std::runtime_error("staging ring : pRenderer is null!");
+	}
+
+	pRenderer = _pRenderer;
+	size = _size;
+	writePosition = 0;
+	readPosition = 0;
+	pRenderer->CreateBuffer(size, VK_BUFFER_USAGE_TRANSFER_SRC_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, buffer, bufferAllocation);
+	pMapped = static_cast<uint8_t*>(bufferAllocation.pMapped);
+}
+
+void StagingRing::CleanUp()
+{
+	if (pRenderer != nullptr)
+	{
+		pRenderer->DestroyBuffer(buffer, bufferAllocation);
+		retirePointQueue.clear();
+		pMapped = nullptr;
+		pRenderer = nullptr;
+	}
+}
+
+bool StagingRing::Allocate(VkDeviceSize allocationSize, VkDeviceSize alignment, Region& region)
+{
+	VkDeviceSize offset = writePosition % size;
+	VkDeviceSize alignedOffset = (offset + alignment - 1) / alignment * alignment;
+	//a region never wraps, the rest of the ring is skipped instead
+	if (alignedOffset + allocationSize > size)
+	{
+		alignedOffset = 0;
+	}
+	VkDeviceSize padding = alignedOffset >= offset ? alignedOffset - offset : size - offset;
+	if (writePosition + padding + allocationSize - readPosition > size)
+		return false;
+
+	writePosition += padding + allocationSize;
+	region.buffer = buffer;
+	region.offset = alignedOffset;
+	region.size = allocationSize;
+	region.pData = pMapped + alignedOffset;
+	region.dedicatedAllocation = DeviceMemoryAllocator::Allocation();
+	return true;
+}
+
+void StagingRing::Retire(uint64_t value)
+{
+	if (!retirePointQueue.empty() && retirePointQueue.back().writePosition == writePosition)
+		return;
+
+	retirePointQueue.push_back({ value, writePosition });
+}
+
+void StagingRing::Reclaim(uint64_t completedValue)
+{
+	while (!retirePointQueue.empty() && retirePointQueue.front().value <= completedValue)
+	{
+		readPosition = retirePointQueue.front().writePosition;
+		retirePointQueue.pop_front();
+	}
+}
+
+void StagingRing::ReclaimAll()
+{
+	readPosition = writePosition;
+	retirePointQueue.clear();
+}
+
+uint64_t StagingRing::GetOldestRetiredValue() const
+{
+	return retirePointQueue.empty() ? 0 : retirePointQueue.front().value;
+}
+
+VkDeviceSize StagingRing::GetSize() const
+{
+	return size;
+}
+
+VkDeviceSize StagingRing::GetUsedSize() const
+{
+	return writePosition - readPosition;
+}
+
+VkDeviceSize StagingRing::GetMaxAllocationSize() const
+{
+	return size / 4;
+}
@@ -0,0 +1,63 @@
+#pragma once
+
+#include <deque>
+
+#include "GlobalInclude.h"
+#include "DeviceMemoryAllocator.h"
+
+class Renderer;
+
+//one persistently mapped host visible buffer that uploads carve their staging memory from in order,
+//space comes back once the gpu work using it is known to be done, tracked with caller defined increasing values
+class StagingRing
+{
+public:
+	//offsets of regions suit buffer copies and buffer to image copies of every format in use
+	static const VkDeviceSize ALIGNMENT = 16;
+
+	struct Region
+	{
+		VkBuffer buffer = VK_NULL_HANDLE;
+		VkDeviceSize offset = 0;
+		VkDeviceSize size = 0;
+		void* pData = nullptr;
+		DeviceMemoryAllocator::Allocation dedicatedAllocation;//memory is not null when the region has a buffer of its own instead of a part of the ring
+	};
+
+	StagingRing();
+	~StagingRing();
+
+	void InitStagingRing(Renderer* _pRenderer, VkDeviceSize _size);
+	void CleanUp();
+
+	//false when the ring has no room until more retired regions are reclaimed
+	bool Allocate(VkDeviceSize allocationSize, VkDeviceSize alignment, Region& region);
+	//everything allocated since the last retire is reclaimable once the completed value reaches value
+	void Retire(uint64_t value);
+	void Reclaim(uint64_t completedValue);
+	//only when the gpu is known to be done with every region, retired or not
+	void ReclaimAll();
+	//the value the oldest retired regions wait for, 0 when nothing is retired
+	uint64_t GetOldestRetiredValue() const;
+	VkDeviceSize GetSize() const;
+	VkDeviceSize GetUsedSize() const;
+	//larger uploads should get a staging buffer of their own, so one big texture can not stall the ring
+	VkDeviceSize GetMaxAllocationSize() const;
+
+private:
+	struct RetirePoint
+	{
+		uint64_t value;
+		uint64_t writePosition;
+	};
+
+	Renderer* pRenderer;
+	VkBuffer buffer;
+	DeviceMemoryAllocator::Allocation bufferAllocation;
+	uint8_t* pMapped;
+	VkDeviceSize size;
+	//both only grow, the offset in the ring is position % size
+	uint64_t writePosition;
+	uint64_t readPosition;
+	std::deque<RetirePoint> retirePointQueue;
+};
@@ -1,6 +1,12 @@
 #include "Texture.h"
 
 #include "Renderer.h"
+#include "ThreadPool.h"
+#include "MappedFile.h"
+#include "Hash.h"
+
+#include <filesystem>
+#include <unordered_set>
 
 #define STB_IMAGE_IMPLEMENTATION
 #include <stb_image.h>
@@ -8,14 +14,25 @@
 Texture::Texture(const std::string& _fileName, VkFormat _textureFormat, Filter _filter, Wrap _wrap) :
 	pRenderer(nullptr), 
 	fileName(_fileName), 
-	textureFormat(_textureFormat), 
 	filter(_filter), 
 	wrap(_wrap),
 	mipLevels(1),
 	textureImage(VK_NULL_HANDLE), 
-	textureImageMemory(VK_NULL_HANDLE), 
 	textureImageView(VK_NULL_HANDLE),
-	textureSampler(VK_NULL_HANDLE)
+	textureSampler(VK_NULL_HANDLE),
+	textureFormat(_textureFormat), 
+	directWrite(false),
+	useTextureCache(true),
+	mipFilter(MipGenerator::Filter::Box),
+	compression(Compression::None),
+	usage(Usage::Color),
+	uncompressedFormat(_textureFormat),
+	textureComponents({}),
+	sourceHash(0),
+	streaming(false),
+	tailLevel(0),
+	residentLevel(0),
+	requestedLevel(0)
 {
 }
 
@@ -44,6 +61,93 @@ VkImageView Texture::GetTextureImageView() const
 	return textureImageView;
 }
 
+bool Texture::IsUploadComplete() const
+{
+	return pRenderer != nullptr && pRenderer->IsUploadComplete(uploadTicket);
+}
+
+void Texture::SetUseTextureCache(bool _useTextureCache)
+{
+	useTextureCache = _useTextureCache;
+}
+
+void Texture::SetMipFilter(MipGenerator::Filter _mipFilter)
+{
+	mipFilter = _mipFilter;
+}
+
+void Texture::SetCompression(Compression _compression)
+{
+	compression = _compression;
+}
+
+void Texture::SetUsage(Usage _usage)
+{
+	usage = _usage;
+}
+
+void Texture::SetStreaming(bool _streaming)
+{
+	streaming = _streaming;
+}
+
+bool Texture::IsStreaming() const
+{
+	return residentLevel > 0;
+}
+
+uint32_t Texture::GetResidentLevel() const
+{
+	return residentLevel;
+}
+
+uint32_t Texture::GetMipLevels() const
+{
+	return mipLevels;
+}
+
+//one level at a time from the finest resident one down, a level becomes sampleable once its upload ticket completes
+bool Texture::UpdateStreaming(VkDeviceSize& budget)
+{
+	if (requestedLevel < residentLevel)
+	{
+		if (!pRenderer->IsUploadComplete(streamingTicket))
+			return false;
+
+		residentLevel = requestedLevel;
+		textureImageView = residencyImageViewVec[residentLevel];
+		if (residentLevel == 0)
+		{
+			pTextureCache.reset();
+			streamingData = std::vector<uint8_t>();
+			return false;
+		}
+	}
+	if (requestedLevel == 0 || budget == 0)
+		return false;
+
+	uint32_t level = requestedLevel - 1;
+	VkDeviceSize size = GetLevelSize(level);
+	const uint8_t* source = pTextureCache != nullptr ? static_cast<const uint8_t*>(pTextureCache->GetData()) : streamingData.data();
+	//this runs in the render loop, so a full staging ring skips the level until a later frame instead of waiting for room
+	StagingRing::Region staging;
+	if (!pRenderer->TryAllocateStaging(size, staging))
+		return false;
+	memcpy(staging.pData, source + levelOffsetVec[level], static_cast<size_t>(size));
+
+	std::vector<VkDeviceSize> stagedOffsetVec(level + 1, Renderer::SKIP_LEVEL);
+	stagedOffsetVec[level] = 0;
+	pRenderer->UploadImageLevels(staging, textureImage, textureFormat, static_cast<uint32_t>(width), static_cast<uint32_t>(height), stagedOffsetVec, level, 1);
+	requestedLevel = level;
+	budget -= std::min(budget, size);
+	return true;
+}
+
+void Texture::SetStreamingTicket(UploadTicket ticket)
+{
+	streamingTicket = ticket;
+}
+
 void Texture::InitTexture(Renderer* _pRenderer)
 {
 	if(_pRenderer==nullptr)
@@ -52,20 +156,151 @@ void Texture::InitTexture(Renderer* _pRenderer)
 	}
 
 	pRenderer = _pRenderer;
-	CreateTextureImage();
+	if (AcquireSharedImage())
+	{
+		CreateTextureSampler();
+		return;
+	}
+	InitTextureResources();
+	uploadTicket = pRenderer->FlushUploads();
+	ShareImage();
+}
+
+void Texture::InitTextures(Renderer* pRenderer, const std::vector<Texture*>& pTextureVec)
+{
+	if (pRenderer == nullptr)
+	{
+		throw std::runtime_error("textures : pRenderer is null!");
+	}
+
+	//a file is loaded once for all textures with the same settings, the others share its image afterwards
+	ImageCache* pImageCache = pRenderer->GetImageCache();
+	std::vector<Texture*> pFileTextureVec;
+	std::vector<Texture*> pSharingTextureVec;
+	std::unordered_set<std::string> keySet;
+	for (auto pTexture : pTextureVec)
+	{
+		if (pTexture->HasFile())
+		{
+			pTexture->pRenderer = pRenderer;
+			std::string key = pTexture->GetSharedImageKey();
+			if (!pTexture->streaming && (pImageCache->Contains(key) || !keySet.insert(key).second))
+			{
+				pSharingTextureVec.push_back(pTexture);
+			}
+			else
+			{
+				pFileTextureVec.push_back(pTexture);
+			}
+		}
+		else
+		{
+			pTexture->InitTexture(pRenderer);
+		}
+	}
+
+	//headers only, the sizes decide how many textures fit into staging memory at once
+	ThreadPool* pThreadPool = pRenderer->GetThreadPool();
+	uint32_t fileTextureCount = static_cast<uint32_t>(pFileTextureVec.size());
+	std::vector<VkDeviceSize> imageSizeVec(fileTextureCount);
+	pThreadPool->ParallelFor(fileTextureCount, 1, [&](uint32_t begin, uint32_t end)
+	{
+		for (uint32_t i = begin; i < end; i++)
+		{
+			imageSizeVec[i] = pFileTextureVec[i]->ReadImageInfo();
+		}
+	});
+
+	//images only depend on the headers, direct writes decode into them
+	for (auto pTexture : pFileTextureVec)
+	{
+		pTexture->CreateTextureImage();
+	}
+
+	//take as much staging memory as is free without waiting(at most a staging ring worth), decode that group straight into it on the workers,
+	//then record its uploads and flush them together before taking more
+	uint32_t groupBegin = 0;
+	while (groupBegin < fileTextureCount)
+	{
+		uint32_t groupEnd = groupBegin;
+		VkDeviceSize groupSize = 0;
+		while (groupEnd < fileTextureCount && 
+			(groupSize == 0 || groupSize + imageSizeVec[groupEnd] <= Renderer::STAGING_RING_SIZE) &&
+			(imageSizeVec[groupEnd] == 0 || pRenderer->TryAllocateStaging(imageSizeVec[groupEnd], pFileTextureVec[groupEnd]->decodedStaging)))
+		{
+			groupSize += imageSizeVec[groupEnd];
+			groupEnd++;
+		}
+		if (groupEnd == groupBegin)
+		{
+			pFileTextureVec[groupBegin]->decodedStaging = pRenderer->AllocateStaging(imageSizeVec[groupBegin]);
+			groupEnd++;
+		}
+
+		pThreadPool->ParallelFor(groupEnd - groupBegin, 1, [&](uint32_t begin, uint32_t end)
+		{
+			for (uint32_t i = groupBegin + begin; i < groupBegin + end; i++)
+			{
+				pFileTextureVec[i]->DecodeImage(pFileTextureVec[i]->decodedStaging.pData);
+			}
+		});
+
+		for (uint32_t i = groupBegin; i < groupEnd; i++)
+		{
+			pFileTextureVec[i]->InitTextureResources();
+		}
+		UploadTicket uploadTicket = pRenderer->FlushUploads();
+		for (uint32_t i = groupBegin; i < groupEnd; i++)
+		{
+			pFileTextureVec[i]->uploadTicket = uploadTicket;
+			pFileTextureVec[i]->ShareImage();
+		}
+		groupBegin = groupEnd;
+	}
+
+	for (auto pTexture : pSharingTextureVec)
+	{
+		pTexture->AcquireSharedImage();
+		pTexture->CreateTextureSampler();
+	}
+}
+
+bool Texture::HasFile() const
+{
+	return true;
+}
+
+void Texture::InitTextureResources()
+{
+	//textures of InitTextures arrive with their image created and their pixels decoded
+	if (textureImage == VK_NULL_HANDLE)
+	{
+		VkDeviceSize stagedSize = ReadImageInfo();
+		CreateTextureImage();
+		if (stagedSize > 0)
+		{
+			decodedStaging = pRenderer->AllocateStaging(stagedSize);
+		}
+		DecodeImage(decodedStaging.pData);
+	}
+
+	UploadTextureImage();
 	CreateTextureImageView(textureImage, textureFormat, VK_IMAGE_ASPECT_COLOR_BIT);
 	CreateTextureSampler();
 }
 
-void Texture::CreateTextureImage()
+VkDeviceSize Texture::ReadImageInfo()
 {
-	int texChannels;
-	stbi_uc* pixels = stbi_load(fileName.c_str(), &width, &height, &texChannels, STBI_rgb_alpha);
-	VkDeviceSize imageSize = width * height * 4;
+	MappedFile file;
+	if (!file.Open(fileName))
+	{
+		throw std::runtime_error("failed to load texture image " + fileName + "!");
+	}
 
-	if (!pixels)
+	int texChannels;
+	if (!stbi_info_from_memory(reinterpret_cast<const stbi_uc*>(file.GetData()), static_cast<int>(file.GetSize()), &width, &height, &texChannels))
 	{
-		throw std::runtime_error("failed to load texture image!");
+		throw std::runtime_error("failed to load texture image " + fileName + "!");
 	}
 
 	if (filter == Filter::Trilinear)
@@ -73,22 +308,285 @@ void Texture::CreateTextureImage()
 		mipLevels = static_cast<uint32_t>(std::floor(std::log2(std::max(width, height)))) + 1;
 	}
 
-	VkBuffer stagingBuffer;
-	VkDeviceMemory stagingBufferMemory;
-	pRenderer->CreateBuffer(imageSize, VK_BUFFER_USAGE_TRANSFER_SRC_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, stagingBuffer, stagingBufferMemory);
+	SelectFormat(texChannels);
+	directWrite = false;
+	tailLevel = 0;
+	if (!useTextureCache && !IsCompressed())
+	{
+		levelOffsetVec.clear();
+		return GetLevelSize(0);
+	}
+
+	//levels are packed one after another in the format of the image, 4 byte aligned for the buffer offsets of the copy
+	VkDeviceSize size = 0;
+	levelOffsetVec.resize(mipLevels);
+	for (uint32_t i = 0; i < mipLevels; i++)
+	{
+		levelOffsetVec[i] = (size + 3) & ~static_cast<VkDeviceSize>(3);
+		size = levelOffsetVec[i] + GetLevelSize(i);
+	}
+	//complete mip chains can go straight into a linear image when the device samples it from memory the cpu writes
+	directWrite = pRenderer->IsUnifiedMemory() && pRenderer->SupportsLinearImage(textureFormat, static_cast<uint32_t>(width), static_cast<uint32_t>(height), mipLevels);
+	//streaming textures stage their mip tail only, the larger levels follow while rendering
+	while (streaming && !directWrite && tailLevel + 1 < mipLevels && (static_cast<uint32_t>(std::max(width, height)) >> tailLevel) > STREAMING_TAIL_SIZE)
+	{
+		tailLevel++;
+	}
+	VkDeviceSize stagedSize = directWrite ? 0 : size - levelOffsetVec[tailLevel];
+	if (!useTextureCache)
+	{
+		return stagedSize;
+	}
+
+	//the cache is keyed by the content of the image file, so an edited file never picks up a stale cache,
+	//and by the format and build flags, so textures of the same file with other settings keep their own cache files
+	sourceHash = Hash64(file.GetData(), file.GetSize());
+	cacheFileName = TEXTURE_CACHE_DIRECTORY + std::filesystem::path(fileName).filename().string() + "." + HashToString(sourceHash) + "." +
+		std::to_string(static_cast<uint32_t>(textureFormat)) + "_" + std::to_string(GetTextureCacheBuildFlags()) + ".tex";
+	pTextureCache = std::make_shared<TextureCache>();
+	if (pTextureCache->Open(cacheFileName, sourceHash, GetTextureCacheBuildFlags()))
+	{
+		const TextureCache::Header& header = pTextureCache->GetHeader();
+		bool match = header.format == static_cast<uint32_t>(textureFormat) && header.mipLevels == mipLevels && header.dataSize == size;
+		for (uint32_t i = 0; match && i < mipLevels; i++)
+		{
+			match = pTextureCache->GetLevel(i).offset == levelOffsetVec[i];
+		}
+		if (match)
+		{
+			return stagedSize;
+		}
+	}
+	pTextureCache.reset();
+	return stagedSize;
+}
+
+//a cache hit is one copy of the cooked levels, otherwise the file is decoded and, for cooked levels, the mips are built, compressed and cached
+void Texture::DecodeImage(void* pDestination)
+{
+	if (pTextureCache != nullptr)
+	{
+		StoreLevels(static_cast<const uint8_t*>(pTextureCache->GetData()), pDestination);
+		//streaming reads the larger levels from the mapped file later
+		if (tailLevel == 0)
+		{
+			pTextureCache.reset();
+		}
+		return;
+	}
+
+	int decodedWidth;
+	int decodedHeight;
+	int texChannels;
+	stbi_uc* pixels = stbi_load(fileName.c_str(), &decodedWidth, &decodedHeight, &texChannels, STBI_rgb_alpha);
+	if (!pixels || decodedWidth != width || decodedHeight != height)
+	{
+		stbi_image_free(pixels);
+		throw std::runtime_error("failed to load texture image " + fileName + "!");
+	}
 
-	void* data;
-	vkMapMemory(pRenderer->GetDevice(), stagingBufferMemory, 0, imageSize, 0, &data);
-	memcpy(data, pixels, static_cast<size_t>(imageSize));
-	vkUnmapMemory(pRenderer->GetDevice(), stagingBufferMemory);
+	if (levelOffsetVec.empty())
+	{
+		PackChannels(pixels, static_cast<size_t>(width) * height, GetTexelSize(), static_cast<uint8_t*>(pDestination));
+		stbi_image_free(pixels);
+		return;
+	}
 
+	//filter and compress in system memory, staging memory is write combined and slow to read back
+	std::vector<MipGenerator::Level> levelVec;
+	std::vector<uint8_t> data(static_cast<size_t>(MipGenerator::GetLevelLayout(static_cast<uint32_t>(width), static_cast<uint32_t>(height), mipLevels, levelVec)));
+	memcpy(data.data(), pixels, static_cast<size_t>(width) * height * 4);
 	stbi_image_free(pixels);
+	MipGenerator::GenerateMips(data.data(), levelVec, mipFilter, wrap == Wrap::Repeat ? MipGenerator::Wrap::Repeat : MipGenerator::Wrap::Clamp);
+
+	uint32_t lastLevel = mipLevels - 1;
+	std::vector<uint8_t> levelData(static_cast<size_t>(levelOffsetVec[lastLevel] + GetLevelSize(lastLevel)));
+	for (uint32_t i = 0; i < mipLevels; i++)
+	{
+		if (IsCompressed())
+		{
+			BlockCompressor::CompressLevel(data.data() + levelVec[i].offset, levelVec[i].width, levelVec[i].height, GetBlockFormat(), levelData.data() + levelOffsetVec[i], pRenderer->GetThreadPool());
+		}
+		else
+		{
+			PackChannels(data.data() + levelVec[i].offset, static_cast<size_t>(levelVec[i].width) * levelVec[i].height, GetTexelSize(), levelData.data() + levelOffsetVec[i]);
+		}
+	}
+
+	if (useTextureCache)
+	{
+		TextureCache::Header header;
+		header.sourceHash = sourceHash;
+		header.buildFlags = GetTextureCacheBuildFlags();
+		header.format = static_cast<uint32_t>(textureFormat);
+		header.width = static_cast<uint32_t>(width);
+		header.height = static_cast<uint32_t>(height);
+		header.dataSize = levelData.size();
+		std::vector<TextureCache::Level> cacheLevelVec(mipLevels);
+		for (uint32_t i = 0; i < mipLevels; i++)
+		{
+			cacheLevelVec[i] = { levelOffsetVec[i], GetLevelSize(i), levelVec[i].width, levelVec[i].height };
+		}
+		//a failed write only costs the next launch another cook
+		TextureCache::Write(cacheFileName, header, cacheLevelVec, levelData.data());
+	}
+
+	StoreLevels(levelData.data(), pDestination);
+	if (tailLevel > 0)
+	{
+		streamingData = std::move(levelData);
+	}
+}
+
+//staged levels are copied as they are from the mip tail on, the levels of a linear image are written row by row at the pitch the driver chose
+void Texture::StoreLevels(const uint8_t* levelData, void* pDestination) const
+{
+	uint32_t lastLevel = mipLevels - 1;
+	if (!directWrite)
+	{
+		VkDeviceSize tailOffset = levelOffsetVec[tailLevel];
+		memcpy(pDestination, levelData + tailOffset, static_cast<size_t>(levelOffsetVec[lastLevel] + GetLevelSize(lastLevel) - tailOffset));
+		return;
+	}
+
+	uint8_t* pImage = static_cast<uint8_t*>(textureImageAllocation.pMapped);
+	for (uint32_t i = 0; i < mipLevels; i++)
+	{
+		VkImageSubresource subresource = { VK_IMAGE_ASPECT_COLOR_BIT, i, 0 };
+		VkSubresourceLayout layout;
+		vkGetImageSubresourceLayout(pRenderer->GetDevice(), textureImage, &subresource, &layout);
+
+		//a row of a block compressed level is a row of 4x4 blocks
+		uint32_t levelHeight = std::max(1u, static_cast<uint32_t>(height) >> i);
+		uint32_t rowCount = IsCompressed() ? (levelHeight + 3) / 4 : levelHeight;
+		size_t rowSize = static_cast<size_t>(GetLevelSize(i) / rowCount);
+		for (uint32_t row = 0; row < rowCount; row++)
+		{
+			memcpy(pImage + layout.offset + layout.rowPitch * row, levelData + levelOffsetVec[i] + rowSize * row, rowSize);
+		}
+	}
+}
+
+//the fewest channels that hold what the usage reads: masks keep red, normals keep x and y,
+//color keeps all four unless the source is grey, then red is swizzled back to rgb
+void Texture::SelectFormat(int sourceChannels)
+{
+	textureComponents = {};
+	if (IsCompressed())
+	{
+		textureFormat = BlockCompressor::GetVkFormat(GetBlockFormat());
+		return;
+	}
+
+	switch (usage)
+	{
+	case Usage::Mask:
+		textureFormat = VK_FORMAT_R8_UNORM;
+		break;
+	case Usage::Normal:
+		textureFormat = VK_FORMAT_R8G8_UNORM;
+		break;
+	default:
+		textureFormat = uncompressedFormat;
+		//r8 unorm can always be sampled, r8 srgb is optional, without it grey srgb sources stay rgba
+		if (sourceChannels == 1 && (uncompressedFormat == VK_FORMAT_R8G8B8A8_UNORM || (uncompressedFormat == VK_FORMAT_R8G8B8A8_SRGB && pRenderer->SupportsSampledImage(VK_FORMAT_R8_SRGB))))
+		{
+			textureFormat = uncompressedFormat == VK_FORMAT_R8G8B8A8_SRGB ? VK_FORMAT_R8_SRGB : VK_FORMAT_R8_UNORM;
+			textureComponents = { VK_COMPONENT_SWIZZLE_R, VK_COMPONENT_SWIZZLE_R, VK_COMPONENT_SWIZZLE_R, VK_COMPONENT_SWIZZLE_ONE };
+		}
+		break;
+	}
+}
+
+uint32_t Texture::GetTexelSize() const
+{
+	switch (textureFormat)
+	{
+	case VK_FORMAT_R8_UNORM:
+	case VK_FORMAT_R8_SRGB:
+		return 1;
+	case VK_FORMAT_R8G8_UNORM:
+		return 2;
+	default:
+		return 4;
+	}
+}
+
+VkDeviceSize Texture::GetLevelSize(uint32_t level) const
+{
+	uint32_t levelWidth = std::max(1u, static_cast<uint32_t>(width) >> level);
+	uint32_t levelHeight = std::max(1u, static_cast<uint32_t>(height) >> level);
+	if (IsCompressed())
+	{
+		return BlockCompressor::GetLevelSize(levelWidth, levelHeight, GetBlockFormat());
+	}
+	return static_cast<VkDeviceSize>(levelWidth) * levelHeight * GetTexelSize();
+}
+
+//keeps the first channelCount channels of every rgba texel
+void Texture::PackChannels(const uint8_t* source, size_t texelCount, uint32_t channelCount, uint8_t* destination)
+{
+	if (channelCount == 4)
+	{
+		memcpy(destination, source, texelCount * 4);
+		return;
+	}
+	for (size_t i = 0; i < texelCount; i++)
+	{
+		for (uint32_t c = 0; c < channelCount; c++)
+		{
+			destination[i * channelCount + c] = source[i * 4 + c];
+		}
+	}
+}
+
+uint32_t Texture::GetTextureCacheBuildFlags() const
+{
+	return static_cast<uint32_t>(mipFilter) | (static_cast<uint32_t>(wrap) << 4) | (mipLevels << 8) | (static_cast<uint32_t>(compression) << 16) | (static_cast<uint32_t>(usage) << 20);
+}
+
+bool Texture::IsCompressed() const
+{
+	return compression != Compression::None && pRenderer != nullptr && pRenderer->SupportsBlockCompression();
+}
 
-	//Our texture image now has multiple mip levels, but the staging buffer can only be used to fill mip level 0. 
+BlockCompressor::Format Texture::GetBlockFormat() const
+{
+	switch (compression)
+	{
+	case Compression::BC1: return BlockCompressor::Format::BC1;
+	case Compression::BC4: return BlockCompressor::Format::BC4;
+	case Compression::BC5: return BlockCompressor::Format::BC5;
+	default: return BlockCompressor::Format::BC7;
+	}
+}
+
+void Texture::CreateTextureImage()
+{
+	//on unified memory the cpu writes cooked levels into a linear image that is sampled where it is
+	if (directWrite)
+	{
+		pRenderer->CreateImage(
+			width,
+			height,
+			mipLevels,
+			VK_SAMPLE_COUNT_1_BIT,
+			textureFormat,
+			VK_IMAGE_TILING_LINEAR,
+			VK_IMAGE_USAGE_SAMPLED_BIT,
+			VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT | VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+			textureImage,
+			textureImageAllocation,
+			VK_IMAGE_LAYOUT_PREINITIALIZED);
+		return;
+	}
+
+	//cooked levels arrive complete, otherwise the staging buffer only fills mip level 0. 
 	//The other levels are still undefined.To fill these levels we need to generate the data from the single level that we have.
 	//We will use the vkCmdBlitImage command. VkCmdBlit is considered a transfer operation, 
 	//so we must inform Vulkan that we intend to use the texture image as both the source and destination of a transfer.
 	//Add VK_IMAGE_USAGE_TRANSFER_SRC_BIT to the texture image's usage flags
+	bool blitMipmaps = filter == Filter::Trilinear && levelOffsetVec.empty();
 	pRenderer->CreateImage(
 		width,
 		height,
@@ -96,56 +594,124 @@ void Texture::CreateTextureImage()
 		VK_SAMPLE_COUNT_1_BIT,
 		textureFormat,
 		VK_IMAGE_TILING_OPTIMAL,
-		filter == Filter::Trilinear ?
+		blitMipmaps ?
 		VK_IMAGE_USAGE_TRANSFER_SRC_BIT | VK_IMAGE_USAGE_TRANSFER_DST_BIT | VK_IMAGE_USAGE_SAMPLED_BIT :
 		VK_IMAGE_USAGE_TRANSFER_DST_BIT | VK_IMAGE_USAGE_SAMPLED_BIT,
 		VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
 		textureImage,
-		textureImageMemory);
+		textureImageAllocation);
+}
 
-	//helper functions
-	pRenderer->TransitionImageLayout(
-		pRenderer->defaultCommandPool,
-		textureImage,
-		textureFormat,
-		VK_IMAGE_LAYOUT_UNDEFINED,
-		VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
-		mipLevels);
+void Texture::UploadTextureImage()
+{
+	StagingRing::Region staging = decodedStaging;
+	decodedStaging = StagingRing::Region();
 
-	pRenderer->CopyBufferToImage(pRenderer->defaultCommandPool, stagingBuffer, textureImage, static_cast<uint32_t>(width), static_cast<uint32_t>(height));
-	vkDestroyBuffer(pRenderer->GetDevice(), stagingBuffer, nullptr);
-	vkFreeMemory(pRenderer->GetDevice(), stagingBufferMemory, nullptr);
+	//the texels are in place already, only the layout transition is left
+	if (directWrite)
+	{
+		pRenderer->TransitionHostWrittenImage(textureImage, textureFormat, mipLevels);
+		pRenderer->CountDirectWrite(textureImageAllocation.size);
+		return;
+	}
 
-	if (filter == Filter::Trilinear)
+	//copy, generate mips and transition to shader read, in the open upload batch or on the transfer queue
+	if (!levelOffsetVec.empty())
 	{
-		pRenderer->GenerateMipmaps(
-			pRenderer->defaultCommandPool,
-			textureImage,
-			textureFormat,
-			VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL,
-			width,
-			height,
-			mipLevels);
+		//the staging region starts at the mip tail, only the tail goes to shader read,
+		//the bound image view starts at the finest resident level so the levels still streaming in are never reachable through it
+		std::vector<VkDeviceSize> stagedOffsetVec(mipLevels, Renderer::SKIP_LEVEL);
+		for (uint32_t i = tailLevel; i < mipLevels; i++)
+		{
+			stagedOffsetVec[i] = levelOffsetVec[i] - levelOffsetVec[tailLevel];
+		}
+		pRenderer->UploadImageLevels(staging, textureImage, textureFormat, static_cast<uint32_t>(width), static_cast<uint32_t>(height), stagedOffsetVec, tailLevel);
+		residentLevel = tailLevel;
+		requestedLevel = tailLevel;
+		if (tailLevel > 0)
+		{
+			pRenderer->RegisterStreamingTexture(this);
+		}
 	}
 	else
 	{
-		pRenderer->TransitionImageLayout(
-			pRenderer->defaultCommandPool,
-			textureImage,
-			textureFormat,
-			VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
-			VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL,
-			mipLevels);
+		pRenderer->UploadImage(staging, textureImage, textureFormat, static_cast<uint32_t>(width), static_cast<uint32_t>(height), mipLevels, filter == Filter::Trilinear);
 	}
 }
 
+std::string Texture::GetSharedImageKey() const
+{
+	std::string settings = std::to_string(static_cast<int>(uncompressedFormat)) + "," + 
+		std::to_string(static_cast<int>(filter)) + "," + 
+		std::to_string(static_cast<int>(wrap)) + "," + 
+		std::to_string(static_cast<int>(usage)) + "," + 
+		std::to_string(static_cast<int>(compression)) + "," + 
+		std::to_string(static_cast<int>(mipFilter)) + "," + 
+		(useTextureCache ? "1" : "0");
+	return std::filesystem::path(fileName).lexically_normal().generic_string() + "|" + settings;
+}
+
+bool Texture::AcquireSharedImage()
+{
+	if (streaming)
+		return false;
+
+	ImageCache::Image image;
+	std::string key = GetSharedImageKey();
+	if (!pRenderer->GetImageCache()->Acquire(key, image))
+		return false;
+
+	sharedImageKey = key;
+	textureImage = image.image;
+	textureImageView = image.imageView;
+	textureFormat = image.format;
+	width = image.width;
+	height = image.height;
+	mipLevels = image.mipLevels;
+	uploadTicket = image.uploadTicket;
+	return true;
+}
+
+void Texture::ShareImage()
+{
+	if (streaming)
+		return;
+
+	ImageCache::Image image;
+	image.image = textureImage;
+	image.allocation = textureImageAllocation;
+	image.imageView = textureImageView;
+	image.format = textureFormat;
+	image.width = width;
+	image.height = height;
+	image.mipLevels = mipLevels;
+	image.uploadTicket = uploadTicket;
+	sharedImageKey = GetSharedImageKey();
+	pRenderer->GetImageCache()->Add(sharedImageKey, image);
+	textureImageAllocation = DeviceMemoryAllocator::Allocation();
+}
+
 void Texture::CreateTextureImageView(VkImage image, VkFormat format, VkImageAspectFlags aspectFlags)
 {
+	//streaming textures get one view per resident level, the levels above it are not in shader read yet
+	residencyImageViewVec.clear();
+	if (tailLevel > 0)
+	{
+		residencyImageViewVec.resize(tailLevel + 1);
+		for (uint32_t i = 0; i <= tailLevel; i++)
+		{
+			residencyImageViewVec[i] = pRenderer->CreateImageView(image, format, aspectFlags, mipLevels - i, textureComponents, i);
+		}
+		textureImageView = residencyImageViewVec[residentLevel];
+		return;
+	}
+
 	textureImageView = pRenderer->CreateImageView(
 		image,
 		format,
 		aspectFlags, 
-		mipLevels);
+		mipLevels,
+		textureComponents);
 }
 
 void Texture::CreateTextureSampler()
@@ -170,19 +736,45 @@ void Texture::CreateTextureSampler()
 	samplerInfo.maxLod = static_cast<float>(mipLevels);
 	samplerInfo.mipLodBias = 0;
 
-	if (vkCreateSampler(pRenderer->GetDevice(), &samplerInfo, nullptr, &textureSampler) != VK_SUCCESS) {
-		throw std::runtime_error("failed to create texture sampler!");
-	}
+	//nearly every texture samples the same way, so they share samplers
+	textureSampler = pRenderer->GetSamplerCache()->Acquire(samplerInfo);
 }
 
 void Texture::CleanUp()
 {
 	if (pRenderer != nullptr)
 	{
-		vkDestroySampler(pRenderer->GetDevice(), textureSampler, nullptr);
-		vkDestroyImageView(pRenderer->GetDevice(), textureImageView, nullptr);
-		vkDestroyImage(pRenderer->GetDevice(), textureImage, nullptr);
-		vkFreeMemory(pRenderer->GetDevice(), textureImageMemory, nullptr);
+		if (IsStreaming())
+		{
+			pRenderer->UnregisterStreamingTexture(this);
+		}
+		pRenderer->GetSamplerCache()->Release(textureSampler);
+		textureSampler = VK_NULL_HANDLE;
+		tailLevel = 0;
+		residentLevel = 0;
+		requestedLevel = 0;
+		streamingData = std::vector<uint8_t>();
+		pTextureCache.reset();
+		if (!sharedImageKey.empty())
+		{
+			pRenderer->GetImageCache()->Release(sharedImageKey);
+			sharedImageKey.clear();
+			textureImageView = VK_NULL_HANDLE;
+			textureImage = VK_NULL_HANDLE;
+		}
+		else
+		{
+			if (residencyImageViewVec.empty())
+			{
+				vkDestroyImageView(pRenderer->GetDevice(), textureImageView, nullptr);
+			}
+			for (VkImageView imageView : residencyImageViewVec)
+			{
+				vkDestroyImageView(pRenderer->GetDevice(), imageView, nullptr);
+			}
+			residencyImageViewVec.clear();
+			pRenderer->DestroyImage(textureImage, textureImageAllocation);
+		}
 		pRenderer = nullptr;
 	}
 }
@@ -198,10 +790,8 @@ RenderTexture::RenderTexture(const std::string& _name, int _width, int _height,
 	supportMsaa(_supportMsaa), 
 	readFrom(_readFrom),
 	depthStencilImage(VK_NULL_HANDLE),
-	depthStencilImageMemory(VK_NULL_HANDLE),
 	depthStencilImageView(VK_NULL_HANDLE),
 	preResolveImage(VK_NULL_HANDLE),
-	preResolveImageMemory(VK_NULL_HANDLE),
 	preResolveImageView(VK_NULL_HANDLE)
 {
 	width = _width;
@@ -217,6 +807,11 @@ RenderTexture::~RenderTexture()
 	CleanUp();
 }
 
+bool RenderTexture::HasFile() const
+{
+	return false;
+}
+
 void RenderTexture::InitTexture(Renderer* _pRenderer)
 {
 	if (_pRenderer == nullptr)
@@ -266,11 +861,9 @@ void RenderTexture::CleanUp()
 {
 	if (pRenderer != nullptr)
 	{
-		vkDestroyImage(pRenderer->GetDevice(), preResolveImage, nullptr);
-		vkFreeMemory(pRenderer->GetDevice(), preResolveImageMemory, nullptr);
+		pRenderer->DestroyImage(preResolveImage, preResolveImageAllocation);
 		vkDestroyImageView(pRenderer->GetDevice(), preResolveImageView, nullptr);
-		vkDestroyImage(pRenderer->GetDevice(), depthStencilImage, nullptr);
-		vkFreeMemory(pRenderer->GetDevice(), depthStencilImageMemory, nullptr);
+		pRenderer->DestroyImage(depthStencilImage, depthStencilImageAllocation);
 		vkDestroyImageView(pRenderer->GetDevice(), depthStencilImageView, nullptr);
 		vkDestroyImageView(pRenderer->GetDevice(), colorImageView, nullptr);
 		Texture::CleanUp();
@@ -375,7 +968,7 @@ void RenderTexture::CreateRenderTextureImage()
 			VK_IMAGE_USAGE_TRANSIENT_ATTACHMENT_BIT | VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT,
 			VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
 			preResolveImage,
-			preResolveImageMemory);
+			preResolveImageAllocation);
 		preResolveImageView = pRenderer->CreateImageView(preResolveImage, textureFormat, VK_IMAGE_ASPECT_COLOR_BIT, 1);
 		pRenderer->TransitionImageLayout(pRenderer->defaultCommandPool, preResolveImage, textureFormat, VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL, 1);
 	}
@@ -400,7 +993,7 @@ void RenderTexture::CreateRenderTextureImage()
 				VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT,
 			VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
 			depthStencilImage,
-			depthStencilImageMemory);
+			depthStencilImageAllocation);
 		depthStencilImageView = pRenderer->CreateImageView(depthStencilImage, depthStencilFormat, VK_IMAGE_ASPECT_DEPTH_BIT | VK_IMAGE_ASPECT_STENCIL_BIT, 1);
 		pRenderer->TransitionImageLayout(pRenderer->defaultCommandPool, depthStencilImage, depthStencilFormat, VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL, mipLevels);
 		currentDepthStencilLayout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL;
@@ -425,7 +1018,7 @@ void RenderTexture::CreateRenderTextureImage()
 				VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT,
 			VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
 			textureImage,
-			textureImageMemory);
+			textureImageAllocation);
 		//VkFramebufferCreateInfo attachment #0 has mip levelCount of 10 but only a single mip level(levelCount == 1) is allowed 
 		//when creating a Framebuffer.The Vulkan spec states : Each element of pAttachments must only specify a single mip level
 		//(https ://www.khronos.org/registry/vulkan/specs/1.1-extensions/html/vkspec.html#VUID-VkFramebufferCreateInfo-pAttachments-00883)
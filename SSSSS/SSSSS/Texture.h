@@ -1,6 +1,13 @@
 #pragma once
 
+#include <memory>
+
 #include "GlobalInclude.h"
+#include "DeviceMemoryAllocator.h"
+#include "UploadManager.h"
+#include "MipGenerator.h"
+#include "TextureCache.h"
+#include "BlockCompressor.h"
 
 class Renderer;
 
@@ -10,6 +17,10 @@ public:
 
 	enum class Filter { NearestPoint, Bilinear, Trilinear };
 	enum class Wrap { Clamp, Repeat, Mirror };//clamp to edge
+	//block compression of the cooked levels, textures stay in their uncompressed format when the device can not sample bc formats
+	enum class Compression { None, BC1, BC4, BC5, BC7 };
+	//what the texture holds, decides how many channels an uncompressed texture keeps
+	enum class Usage { Color, Normal, Mask };
 
 	Texture(const std::string& _fileName, VkFormat _textureFormat, Filter _filter, Wrap _wrap);
 	virtual ~Texture();
@@ -18,8 +29,30 @@ public:
 	VkSampler GetSampler() const;
 	int GetWidth() const;
 	int GetHeight() const;
-
+	//false while the pixels are still on their way to the gpu, render textures are always complete
+	bool IsUploadComplete() const;
+
+	//mip chains are built on the cpu and cooked into the texture cache on first load, later loads map the cooked file,
+	//without the cache the file is decoded every time and mips are blitted on the gpu
+	void SetUseTextureCache(bool _useTextureCache);//call before InitTexture
+	void SetMipFilter(MipGenerator::Filter _mipFilter);//call before InitTexture
+	void SetCompression(Compression _compression);//call before InitTexture, bc5 keeps red and green, bc4 keeps red
+	void SetUsage(Usage _usage);//call before InitTexture, masks are r8, normals rg8 and color rgba8(r8 for grey sources)
+	//call before InitTexture, only the mip tail is loaded with the other assets, the larger levels are streamed in while rendering,
+	//needs cooked levels(the texture cache or compression), streaming textures do not share their image
+	void SetStreaming(bool _streaming);
+	//false once every level is resident
+	bool IsStreaming() const;
+	uint32_t GetResidentLevel() const;
+	uint32_t GetMipLevels() const;
+	//called by the renderer once per frame, records the next level when there is budget left and returns whether it did
+	bool UpdateStreaming(VkDeviceSize& budget);
+	void SetStreamingTicket(UploadTicket ticket);
+
+	//textures of the same file and settings share one image through the image cache of the renderer, only the first one loads it
 	void virtual InitTexture(Renderer* _pRenderer);
+	//inits every texture, the files are decoded on the worker threads of the renderer first
+	static void InitTextures(Renderer* pRenderer, const std::vector<Texture*>& pTextureVec);
 
 	void virtual CleanUp();
 
@@ -35,10 +68,43 @@ protected:
 	Wrap wrap;
 	uint32_t mipLevels;
 	VkImage textureImage;
-	VkDeviceMemory textureImageMemory;
+	DeviceMemoryAllocator::Allocation textureImageAllocation;
 	VkImageView textureImageView;
 	VkSampler textureSampler;
 	VkFormat textureFormat;
+	UploadTicket uploadTicket;
+	StagingRing::Region decodedStaging;//filled by InitTextures before InitTextureResources
+	bool directWrite;//cooked levels are written by the cpu into a linear image on unified memory, nothing is staged
+
+	// ~ texture cache ~
+
+	bool useTextureCache;
+	MipGenerator::Filter mipFilter;
+	Compression compression;
+	Usage usage;
+	VkFormat uncompressedFormat;//the format of the constructor, textureFormat is picked from it, the usage and the compression
+	VkComponentMapping textureComponents;//swizzle of the image view, identity unless a grey source is stored in red only
+	//cooked mip chains of image files are cached here, keyed by the content hash of the image file
+	const std::string TEXTURE_CACHE_DIRECTORY = "TextureCache/";
+	std::shared_ptr<TextureCache> pTextureCache;//open from ReadImageInfo to DecodeImage on a cache hit, shared so textures stay copyable
+	uint64_t sourceHash;
+	std::string cacheFileName;
+	std::vector<VkDeviceSize> levelOffsetVec;//where each level starts in the staging region, all levels are staged when the cache or compression is used
+
+	// ~ streaming ~
+
+	static const uint32_t STREAMING_TAIL_SIZE = 512;//levels up to this size are loaded with the other assets
+	bool streaming;
+	uint32_t tailLevel;//first level loaded with the other assets, 0 when the whole chain is
+	uint32_t residentLevel;//finest level the gpu may sample, the base level of the bound image view
+	uint32_t requestedLevel;//finest level whose upload has been recorded
+	UploadTicket streamingTicket;//of requestedLevel
+	std::vector<VkImageView> residencyImageViewVec;//one per resident level starting at it, all kept until CleanUp since frames in flight may still use them
+	std::vector<uint8_t> streamingData;//cooked levels of a texture cache miss, a hit keeps pTextureCache open instead
+
+	// ~ image cache ~
+
+	std::string sharedImageKey;//set once the image belongs to the image cache, the texture then only holds a reference
 
 	// ~ vulkan functions ~
 
@@ -46,10 +112,30 @@ protected:
 	void CreateTextureSampler();
 	VkFilter GetVkFilter();
 
+	//false for textures that are not loaded from a file
+	bool virtual HasFile() const;
+
 private:
 	// ~ texture only functions ~
 
+	void InitTextureResources();
+	//both are safe to call for different textures on different threads
+	VkDeviceSize ReadImageInfo();//sets width, height, mipLevels and the level offsets, returns the size of the staged pixels, 0 for direct writes
+	void DecodeImage(void* pDestination);//direct writes need the image created first and ignore pDestination
+	void StoreLevels(const uint8_t* levelData, void* pDestination) const;
+	uint32_t GetTextureCacheBuildFlags() const;
+	bool IsCompressed() const;
+	BlockCompressor::Format GetBlockFormat() const;
+	void SelectFormat(int sourceChannels);
+	uint32_t GetTexelSize() const;//of uncompressed formats
+	VkDeviceSize GetLevelSize(uint32_t level) const;
+	static void PackChannels(const uint8_t* source, size_t texelCount, uint32_t channelCount, uint8_t* destination);
 	void CreateTextureImage();
+	void UploadTextureImage();
+	//the file and every setting the image depends on
+	std::string GetSharedImageKey() const;
+	bool AcquireSharedImage();
+	void ShareImage();
 };
 
 ////////////////////////////////
@@ -70,6 +156,8 @@ public:
 
 	void virtual CleanUp();
 
+	bool virtual HasFile() const;
+
 	VkSampleCountFlagBits GetMsaaSamples() const;
 	VkAttachmentDescription GetColorAttachment(bool clear) const;
 	VkAttachmentDescription GetDepthStencilAttachment(bool clearDepth, bool clearStencil) const;
@@ -100,7 +188,7 @@ private:
 
 	bool supportColor;
 	//VkImage colorImage; //use textureImage instead
-	//VkDeviceMemory colorImageMemory; //use textureImageMemory instead
+	//DeviceMemoryAllocator::Allocation colorImageAllocation; //use textureImageAllocation instead
 	VkImageView colorImageView;
 	VkImageLayout currentColorLayout;
 
@@ -108,7 +196,7 @@ private:
 
 	bool supportDepthStencil;
 	VkImage depthStencilImage;
-	VkDeviceMemory depthStencilImageMemory;
+	DeviceMemoryAllocator::Allocation depthStencilImageAllocation;
 	VkImageView depthStencilImageView; 
 	VkFormat depthStencilFormat;
 	VkImageLayout currentDepthStencilLayout;
@@ -118,7 +206,7 @@ private:
 	bool supportMsaa;
 	VkSampleCountFlagBits msaaSamples;
 	VkImage preResolveImage;
-	VkDeviceMemory preResolveImageMemory;
+	DeviceMemoryAllocator::Allocation preResolveImageAllocation;
 	VkImageView preResolveImageView;
 
 	// ~ vulkan functions ~
@@ -0,0 +1,133 @@
+#include "TextureCache.h"
+
+#include <fstream>
+#include <algorithm>
+#include <filesystem>
+#include <cstring>
+#include <thread>
+
+TextureCache::TextureCache() :
+	pLevelArr(nullptr)
+{
+}
+
+TextureCache::~TextureCache()
+{
+	Close();
+}
+
+bool TextureCache::Open(const std::string& fileName, uint64_t sourceHash, uint32_t buildFlags)
+{
+	Close();
+
+	if (!file.Open(fileName))
+		return false;
+
+	const char* data = file.GetData();
+	uint64_t size = file.GetSize();
+	if (size < sizeof(Header))
+	{
+		Close();
+		return false;
+	}
+
+	memcpy(&header, data, sizeof(Header));
+	if (header.magic != MAGIC ||
+		header.version != VERSION ||
+		header.sourceHash != sourceHash ||
+		header.buildFlags != buildFlags ||
+		header.mipLevels == 0 ||
+		sizeof(Header) + header.mipLevels * sizeof(Level) > size ||
+		header.dataOffset % DATA_ALIGNMENT != 0 ||
+		header.dataOffset > size || header.dataSize > size - header.dataOffset)
+	{
+		Close();
+		return false;
+	}
+
+	pLevelArr = reinterpret_cast<const Level*>(data + sizeof(Header));
+	for (uint32_t i = 0; i < header.mipLevels; i++)
+	{
+		const Level& level = pLevelArr[i];
+		if (level.offset > header.dataSize || level.size > header.dataSize - level.offset ||
+			level.width != std::max(1u, header.width >> i) || level.height != std::max(1u, header.height >> i))
+		{
+			Close();
+			return false;
+		}
+	}
+
+	return true;
+}
+
+void TextureCache::Close()
+{
+	file.Close();
+	header = Header();
+	pLevelArr = nullptr;
+}
+
+bool TextureCache::IsOpen() const
+{
+	return pLevelArr != nullptr;
+}
+
+const TextureCache::Header& TextureCache::GetHeader() const
+{
+	return header;
+}
+
+const TextureCache::Level& TextureCache::GetLevel(uint32_t level) const
+{
+	return pLevelArr[level];
+}
+
+const void* TextureCache::GetData() const
+{
+	return file.GetData() + header.dataOffset;
+}
+
+bool TextureCache::Write(const std::string& fileName, const Header& header, const std::vector<Level>& levelVec, const void* data)
+{
+	std::error_code error;
+	std::filesystem::path path(fileName);
+	if (path.has_parent_path())
+	{
+		std::filesystem::create_directories(path.parent_path(), error);
+	}
+
+	Header fileHeader = header;
+	fileHeader.magic = MAGIC;
+	fileHeader.version = VERSION;
+	fileHeader.mipLevels = static_cast<uint32_t>(levelVec.size());
+	uint64_t tableEnd = sizeof(Header) + sizeof(Level) * levelVec.size();
+	fileHeader.dataOffset = (tableEnd + DATA_ALIGNMENT - 1) / DATA_ALIGNMENT * DATA_ALIGNMENT;
+
+	//textures decoded in parallel may miss on the same file, each thread writes its own temporary file and the last rename wins
+	std::string tempFileName = fileName + "." + std::to_string(std::hash<std::thread::id>()(std::this_thread::get_id())) + ".tmp";
+	{
+		std::ofstream out(tempFileName, std::ios::binary | std::ios::trunc);
+		if (!out.is_open())
+			return false;
+
+		const char zeros[DATA_ALIGNMENT] = {};
+		out.write(reinterpret_cast<const char*>(&fileHeader), sizeof(Header));
+		out.write(reinterpret_cast<const char*>(levelVec.data()), sizeof(Level) * levelVec.size());
+		out.write(zeros, fileHeader.dataOffset - tableEnd);
+		out.write(static_cast<const char*>(data), fileHeader.dataSize);
+		if (!out.good())
+		{
+			out.close();
+			std::filesystem::remove(tempFileName, error);
+			return false;
+		}
+	}
+
+	std::filesystem::rename(tempFileName, fileName, error);
+	if (error)
+	{
+		std::filesystem::remove(tempFileName, error);
+		return false;
+	}
+	return true;
+}
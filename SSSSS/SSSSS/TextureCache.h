@@ -0,0 +1,57 @@
+#pragma once
+
+#include "GlobalInclude.h"
+#include "MappedFile.h"
+
+//versioned binary file holding every mip level of a texture, so a texture loads without decoding or generating mips,
+//the levels are packed one after another in a single data range that is copied to staging memory as a whole
+class TextureCache
+{
+public:
+	static const uint32_t MAGIC = 0x58455453;//"STEX"
+	static const uint32_t VERSION = 1;//bump whenever the layout of the file or the way the levels are built changes
+
+	struct Header
+	{
+		uint32_t magic = MAGIC;
+		uint32_t version = VERSION;
+		uint64_t sourceHash = 0;//hash of the source file content
+		uint32_t buildFlags = 0;//options the levels were built with, a different set of options is a cache miss
+		uint32_t format = VK_FORMAT_R8G8B8A8_UNORM;//VkFormat of the texels
+		uint32_t width = 0;
+		uint32_t height = 0;
+		uint32_t mipLevels = 0;
+		uint32_t PADDING0 = 0;
+		uint64_t dataOffset = 0;//in bytes from the start of the file
+		uint64_t dataSize = 0;
+	};
+
+	struct Level
+	{
+		uint64_t offset;//in bytes from the start of the data
+		uint64_t size;
+		uint32_t width;
+		uint32_t height;
+	};
+
+	TextureCache();
+	~TextureCache();
+
+	//maps the file and validates it against the source hash and build flags, returns false on any mismatch
+	bool Open(const std::string& fileName, uint64_t sourceHash, uint32_t buildFlags);
+	void Close();
+	bool IsOpen() const;
+	const Header& GetHeader() const;
+	const Level& GetLevel(uint32_t level) const;
+	const void* GetData() const;
+
+	//writes to a temporary file of the calling thread first and renames it, so an interrupted write never leaves a truncated cache behind
+	static bool Write(const std::string& fileName, const Header& header, const std::vector<Level>& levelVec, const void* data);
+
+private:
+	static const uint64_t DATA_ALIGNMENT = 16;
+
+	MappedFile file;
+	Header header;
+	const Level* pLevelArr;
+};
@@ -0,0 +1,154 @@
+#include "ThreadPool.h"
+
+#include <atomic>
+#include <memory>
+#include <algorithm>
+
+ThreadPool::ThreadPool() :
+	stopping(false)
+{
+}
+
+ThreadPool::~ThreadPool()
+{
+	CleanUp();
+}
+
+void ThreadPool::InitThreadPool(uint32_t threadCount)
+{
+	CleanUp();
+
+	if (threadCount == 0)
+	{
+		threadCount = std::max(1u, std::thread::hardware_concurrency());
+	}
+
+	stopping = false;
+	for (uint32_t i = 1; i < threadCount; i++)//the calling thread is the first one
+	{
+		workerVec.emplace_back(&ThreadPool::WorkerLoop, this);
+	}
+}
+
+void ThreadPool::CleanUp()
+{
+	{
+		std::lock_guard<std::mutex> lock(queueMutex);
+		stopping = true;
+	}
+	queueCondition.notify_all();
+	for (auto& worker : workerVec)
+	{
+		worker.join();
+	}
+	workerVec.clear();
+	taskQueue.clear();
+}
+
+uint32_t ThreadPool::GetThreadCount() const
+{
+	return static_cast<uint32_t>(workerVec.size()) + 1;
+}
+
+void ThreadPool::ParallelFor(uint32_t count, uint32_t grainSize, const std::function<void(uint32_t, uint32_t)>& func)
+{
+	if (count == 0)
+		return;
+
+	grainSize = std::max(1u, grainSize);
+	uint32_t rangeCount = (count + grainSize - 1) / grainSize;
+	if (rangeCount == 1 || workerVec.empty())
+	{
+		func(0, count);
+		return;
+	}
+
+	//shared with the helper tasks, which may only get to run after this call has returned
+	struct Job
+	{
+		std::atomic<uint32_t> nextRange{ 0 };
+		std::atomic<uint32_t> doneRange{ 0 };
+		std::mutex mutex;
+		std::condition_variable condition;
+		std::exception_ptr exception;
+	};
+	auto job = std::make_shared<Job>();
+	auto runRanges = [job, count, grainSize, rangeCount, &func]()
+	{
+		uint32_t range;
+		while ((range = job->nextRange.fetch_add(1)) < rangeCount)
+		{
+			try
+			{
+				uint32_t begin = range * grainSize;
+				func(begin, std::min(count, begin + grainSize));
+			}
+			catch (...)
+			{
+				std::lock_guard<std::mutex> lock(job->mutex);
+				if (!job->exception)
+					job->exception = std::current_exception();
+			}
+			if (job->doneRange.fetch_add(1) + 1 == rangeCount)
+			{
+				std::lock_guard<std::mutex> lock(job->mutex);
+				job->condition.notify_all();
+			}
+		}
+	};
+
+	uint32_t helperCount = std::min(static_cast<uint32_t>(workerVec.size()), rangeCount - 1);
+	{
+		std::lock_guard<std::mutex> lock(queueMutex);
+		for (uint32_t i = 0; i < helperCount; i++)
+		{
+			//func is only touched while a range is still unclaimed, so late helpers never see a dangling reference
+			taskQueue.emplace_back(runRanges);
+		}
+	}
+	queueCondition.notify_all();
+
+	runRanges();
+
+	std::unique_lock<std::mutex> lock(job->mutex);
+	job->condition.wait(lock, [&job, rangeCount]() { return job->doneRange.load() == rangeCount; });
+	if (job->exception)
+	{
+		std::rethrow_exception(job->exception);
+	}
+}
+
+std::future<void> ThreadPool::Submit(const std::function<void()>& task)
+{
+	auto packagedTask = std::make_shared<std::packaged_task<void()>>(task);
+	std::future<void> future = packagedTask->get_future();
+	if (workerVec.empty())
+	{
+		(*packagedTask)();
+		return future;
+	}
+
+	{
+		std::lock_guard<std::mutex> lock(queueMutex);
+		taskQueue.emplace_back([packagedTask]() { (*packagedTask)(); });
+	}
+	queueCondition.notify_one();
+	return future;
+}
+
+void ThreadPool::WorkerLoop()
+{
+	while (true)
+	{
+		std::function<void()> task;
+		{
+			std::unique_lock<std::mutex> lock(queueMutex);
+			queueCondition.wait(lock, [this]() { return stopping || !taskQueue.empty(); });
+			if (stopping && taskQueue.empty())
+				return;
+			task = std::move(taskQueue.front());
+			taskQueue.pop_front();
+		}
+		task();
+	}
+}
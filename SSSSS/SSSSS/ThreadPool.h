@@ -0,0 +1,39 @@
+#pragma once
+
+#include <vector>
+#include <deque>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <functional>
+#include <future>
+
+//a fixed set of worker threads for cpu side asset work(parsing, encoding, compiling)
+class ThreadPool
+{
+public:
+	ThreadPool();
+	~ThreadPool();
+
+	//0 means one thread per hardware thread, the calling thread counts as one of them
+	void InitThreadPool(uint32_t threadCount = 0);
+	void CleanUp();
+
+	//worker threads plus the calling thread
+	uint32_t GetThreadCount() const;
+
+	//splits [0, count) into ranges of at most grainSize and runs func(begin, end) on them,
+	//the calling thread helps out and returns when every range is done, exceptions are rethrown on the calling thread
+	void ParallelFor(uint32_t count, uint32_t grainSize, const std::function<void(uint32_t, uint32_t)>& func);
+
+	std::future<void> Submit(const std::function<void()>& task);
+
+private:
+	std::vector<std::thread> workerVec;
+	std::deque<std::function<void()>> taskQueue;
+	std::mutex queueMutex;
+	std::condition_variable queueCondition;
+	bool stopping;
+
+	void WorkerLoop();
+};
@@ -0,0 +1,459 @@
+#include "UploadManager.h"
+
+#include "Renderer.h"
+
+UploadManager::UploadManager() :
+	pRenderer(nullptr),
+	transferQueueFamilyIndex(0),
+	graphicsQueueFamilyIndex(0),
+	transferQueue(VK_NULL_HANDLE),
+	graphicsQueue(VK_NULL_HANDLE),
+	transferCommandPool(VK_NULL_HANDLE),
+	graphicsCommandPool(VK_NULL_HANDLE),
+	pStagingRing(nullptr),
+	submittedValue(0),
+	completedValue(0)
+{
+}
+
+UploadManager::~UploadManager()
+{
+	CleanUp();
+}
+
+void UploadManager::InitUploadManager(Renderer* _pRenderer, StagingRing* _pStagingRing, uint32_t _transferQueueFamilyIndex, VkQueue _transferQueue, uint32_t _graphicsQueueFamilyIndex, VkQueue _graphicsQueue)
+{
+	if (_pRenderer == nullptr || _pStagingRing == nullptr)
+	{
+		throw std::runtime_error("upload manager : pRenderer or pStagingRing is null!");
+	}
+
+	pRenderer = _pRenderer;
+	pStagingRing = _pStagingRing;
+	transferQueueFamilyIndex = _transferQueueFamilyIndex;
+	transferQueue = _transferQueue;
+	graphicsQueueFamilyIndex = _graphicsQueueFamilyIndex;
+	graphicsQueue = _graphicsQueue;
+	transferCommandPool = CreateCommandPool(transferQueueFamilyIndex);
+	graphicsCommandPool = IsOwnershipTransferred() ? CreateCommandPool(graphicsQueueFamilyIndex) : transferCommandPool;
+}
+
+void UploadManager::CleanUp()
+{
+	if (pRenderer != nullptr)
+	{
+		WaitIdle();
+		if (graphicsCommandPool != transferCommandPool)
+		{
+			vkDestroyCommandPool(pRenderer->GetDevice(), graphicsCommandPool, nullptr);
+		}
+		vkDestroyCommandPool(pRenderer->GetDevice(), transferCommandPool, nullptr);
+		transferCommandPool = VK_NULL_HANDLE;
+		graphicsCommandPool = VK_NULL_HANDLE;
+		pStagingRing = nullptr;
+		pRenderer = nullptr;
+	}
+}
+
+bool UploadManager::HasDedicatedTransferQueue() const
+{
+	return transferQueue != graphicsQueue;
+}
+
+StagingRing::Region UploadManager::AllocateStaging(VkDeviceSize size)
+{
+	//make room by reclaiming finished flushes, flushing what is recorded and finally waiting for the oldest flush
+	StagingRing::Region region;
+	while (!TryAllocateStaging(size, region))
+	{
+		if (inFlightQueue.empty())
+		{
+			if (recording.transferCommandBuffer == VK_NULL_HANDLE)
+			{
+				throw std::runtime_error("upload manager : staging ring is out of space!");
+			}
+			Flush();
+		}
+		else
+		{
+			WaitForOldest();
+		}
+	}
+	return region;
+}
+
+bool UploadManager::TryAllocateStaging(VkDeviceSize size, StagingRing::Region& region)
+{
+	if (size > pStagingRing->GetMaxAllocationSize())
+	{
+		pRenderer->CreateBuffer(size, VK_BUFFER_USAGE_TRANSFER_SRC_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, region.buffer, region.dedicatedAllocation, DeviceMemoryAllocator::MemoryUsage::Transient);
+		region.pData = region.dedicatedAllocation.pMapped;
+		region.size = size;
+		recording.dedicatedStagingVec.push_back(region);
+		stats.dedicatedStagingCount++;
+		return true;
+	}
+
+	if (pStagingRing->Allocate(size, StagingRing::ALIGNMENT, region))
+		return true;
+
+	Poll();
+	return pStagingRing->Allocate(size, StagingRing::ALIGNMENT, region);
+}
+
+void UploadManager::CopyBuffer(const StagingRing::Region& source, VkBuffer dstBuffer, VkDeviceSize dstOffset, VkDeviceSize size)
+{
+	VkCommandBuffer commandBuffer = GetRecordingCommandBuffer();
+
+	VkBufferCopy copyRegion = {};
+	copyRegion.srcOffset = source.offset;
+	copyRegion.dstOffset = dstOffset;
+	copyRegion.size = size;
+	vkCmdCopyBuffer(commandBuffer, source.buffer, dstBuffer, 1, &copyRegion);
+	stats.uploadedSize += size;
+
+	if (IsOwnershipTransferred())
+	{
+		//release on the transfer queue, acquire on the graphics queue, both barriers have to match
+		VkBufferMemoryBarrier barrier = {};
+		barrier.sType = VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER;
+		barrier.srcQueueFamilyIndex = transferQueueFamilyIndex;
+		barrier.dstQueueFamilyIndex = graphicsQueueFamilyIndex;
+		barrier.buffer = dstBuffer;
+		barrier.offset = dstOffset;
+		barrier.size = size;
+		barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+		barrier.dstAccessMask = 0;
+		releaseBufferBarrierVec.push_back(barrier);
+		barrier.srcAccessMask = 0;
+		barrier.dstAccessMask = VK_ACCESS_VERTEX_ATTRIBUTE_READ_BIT | VK_ACCESS_INDEX_READ_BIT;
+		acquireBufferBarrierVec.push_back(barrier);
+	}
+}
+
+void UploadManager::CopyBufferToImage(const StagingRing::Region& source, VkImage image, VkFormat format, uint32_t width, uint32_t height, uint32_t mipLevels, bool generateMipmaps)
+{
+	VkBufferImageCopy region = {};
+	region.bufferOffset = source.offset;
+	region.imageSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+	region.imageSubresource.mipLevel = 0;
+	region.imageSubresource.baseArrayLayer = 0;
+	region.imageSubresource.layerCount = 1;
+	region.imageOffset = { 0, 0, 0 };
+	region.imageExtent = { width, height, 1 };
+	RecordImageCopy(source, image, format, width, height, 0, mipLevels, { region }, generateMipmaps);
+}
+
+void UploadManager::CopyBufferToImageLevels(const StagingRing::Region& source, VkImage image, VkFormat format, const std::vector<VkBufferImageCopy>& regionVec, uint32_t baseMipLevel, uint32_t levelCount)
+{
+	RecordImageCopy(source, image, format, regionVec[0].imageExtent.width, regionVec[0].imageExtent.height, baseMipLevel, levelCount, regionVec, false);
+}
+
+//a level range of an image in use by the graphics queue can be written here without an ownership transfer, its old contents are not kept
+void UploadManager::RecordImageCopy(const StagingRing::Region& source, VkImage image, VkFormat format, uint32_t width, uint32_t height, uint32_t baseMipLevel, uint32_t mipLevels, const std::vector<VkBufferImageCopy>& regionVec, bool generateMipmaps)
+{
+	VkCommandBuffer commandBuffer = GetRecordingCommandBuffer();
+
+	VkImageMemoryBarrier barrier = {};
+	barrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+	barrier.oldLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+	barrier.newLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+	barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+	barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+	barrier.image = image;
+	barrier.subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+	barrier.subresourceRange.baseMipLevel = baseMipLevel;
+	barrier.subresourceRange.levelCount = mipLevels;
+	barrier.subresourceRange.baseArrayLayer = 0;
+	barrier.subresourceRange.layerCount = 1;
+	barrier.srcAccessMask = 0;
+	barrier.dstAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+	vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT, 0, 0, nullptr, 0, nullptr, 1, &barrier);
+
+	vkCmdCopyBufferToImage(commandBuffer, source.buffer, image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, static_cast<uint32_t>(regionVec.size()), regionVec.data());
+	stats.uploadedSize += source.size;
+
+	//blits need a graphics queue, so mips stay in TRANSFER_DST until the graphics queue owns the image
+	barrier.oldLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+	barrier.newLayout = generateMipmaps ? VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL : VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+	if (IsOwnershipTransferred())
+	{
+		barrier.srcQueueFamilyIndex = transferQueueFamilyIndex;
+		barrier.dstQueueFamilyIndex = graphicsQueueFamilyIndex;
+		barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+		barrier.dstAccessMask = 0;
+		releaseImageBarrierVec.push_back(barrier);
+		barrier.srcAccessMask = 0;
+		barrier.dstAccessMask = generateMipmaps ? VK_ACCESS_TRANSFER_READ_BIT | VK_ACCESS_TRANSFER_WRITE_BIT : VK_ACCESS_SHADER_READ_BIT;
+		acquireImageBarrierVec.push_back(barrier);
+		if (generateMipmaps)
+		{
+			mipmapJobVec.push_back({ image, format, width, height, mipLevels });
+		}
+	}
+	else if (generateMipmaps)
+	{
+		pRenderer->GenerateMipmaps(commandBuffer, image, format, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL, width, height, mipLevels);
+	}
+	else
+	{
+		barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+		barrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
+		vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT, 0, 0, nullptr, 0, nullptr, 1, &barrier);
+	}
+}
+
+void UploadManager::TransitionHostWrittenImage(VkImage image, uint32_t mipLevels)
+{
+	//also starts a recording when there is none, so the next flush submits the graphics side
+	VkCommandBuffer commandBuffer = GetRecordingCommandBuffer();
+
+	//no queue has used the image yet, so the graphics queue takes it without an ownership transfer
+	VkImageMemoryBarrier barrier = {};
+	barrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+	barrier.oldLayout = VK_IMAGE_LAYOUT_PREINITIALIZED;
+	barrier.newLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+	barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+	barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+	barrier.image = image;
+	barrier.subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+	barrier.subresourceRange.baseMipLevel = 0;
+	barrier.subresourceRange.levelCount = mipLevels;
+	barrier.subresourceRange.baseArrayLayer = 0;
+	barrier.subresourceRange.layerCount = 1;
+	barrier.srcAccessMask = 0;//host writes before the submission are visible to it
+	barrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
+	if (IsOwnershipTransferred())
+	{
+		acquireImageBarrierVec.push_back(barrier);
+	}
+	else
+	{
+		vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT, 0, 0, nullptr, 0, nullptr, 1, &barrier);
+	}
+}
+
+UploadTicket UploadManager::Flush()
+{
+	//nothing recorded, the last flush covers everything so far
+	if (recording.transferCommandBuffer == VK_NULL_HANDLE)
+		return { submittedValue };
+
+	recording.value = ++submittedValue;
+
+	VkFenceCreateInfo fenceInfo = {};
+	fenceInfo.sType = VK_STRUCTURE_TYPE_FENCE_CREATE_INFO;
+	if (vkCreateFence(pRenderer->GetDevice(), &fenceInfo, nullptr, &recording.fence) != VK_SUCCESS) {
+		throw std::runtime_error("failed to create upload fence!");
+	}
+
+	VkSubmitInfo submitInfo = {};
+	submitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+	submitInfo.commandBufferCount = 1;
+
+	if (IsOwnershipTransferred())
+	{
+		vkCmdPipelineBarrier(
+			recording.transferCommandBuffer,
+			VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT,
+			0,
+			0, nullptr,
+			static_cast<uint32_t>(releaseBufferBarrierVec.size()), releaseBufferBarrierVec.data(),
+			static_cast<uint32_t>(releaseImageBarrierVec.size()), releaseImageBarrierVec.data());
+		vkEndCommandBuffer(recording.transferCommandBuffer);
+
+		VkSemaphoreCreateInfo semaphoreInfo = {};
+		semaphoreInfo.sType = VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO;
+		if (vkCreateSemaphore(pRenderer->GetDevice(), &semaphoreInfo, nullptr, &recording.semaphore) != VK_SUCCESS) {
+			throw std::runtime_error("failed to create upload semaphore!");
+		}
+
+		submitInfo.pCommandBuffers = &recording.transferCommandBuffer;
+		submitInfo.signalSemaphoreCount = 1;
+		submitInfo.pSignalSemaphores = &recording.semaphore;
+		if (vkQueueSubmit(transferQueue, 1, &submitInfo, VK_NULL_HANDLE) != VK_SUCCESS) {
+			throw std::runtime_error("failed to submit uploads to the transfer queue!");
+		}
+
+		//acquire and generate mips on the graphics queue
+		recording.graphicsCommandBuffer = BeginCommandBuffer(graphicsCommandPool);
+		vkCmdPipelineBarrier(
+			recording.graphicsCommandBuffer,
+			VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, VK_PIPELINE_STAGE_VERTEX_INPUT_BIT | VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT | VK_PIPELINE_STAGE_TRANSFER_BIT,
+			0,
+			0, nullptr,
+			static_cast<uint32_t>(acquireBufferBarrierVec.size()), acquireBufferBarrierVec.data(),
+			static_cast<uint32_t>(acquireImageBarrierVec.size()), acquireImageBarrierVec.data());
+		for (const MipmapJob& job : mipmapJobVec)
+		{
+			pRenderer->GenerateMipmaps(recording.graphicsCommandBuffer, job.image, job.format, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL, job.width, job.height, job.mipLevels);
+		}
+		vkEndCommandBuffer(recording.graphicsCommandBuffer);
+
+		VkPipelineStageFlags waitStage = VK_PIPELINE_STAGE_ALL_COMMANDS_BIT;
+		submitInfo.pCommandBuffers = &recording.graphicsCommandBuffer;
+		submitInfo.waitSemaphoreCount = 1;
+		submitInfo.pWaitSemaphores = &recording.semaphore;
+		submitInfo.pWaitDstStageMask = &waitStage;
+		submitInfo.signalSemaphoreCount = 0;
+		submitInfo.pSignalSemaphores = nullptr;
+		if (vkQueueSubmit(graphicsQueue, 1, &submitInfo, recording.fence) != VK_SUCCESS) {
+			throw std::runtime_error("failed to submit upload ownership acquire!");
+		}
+	}
+	else
+	{
+		VkMemoryBarrier barrier = {};
+		barrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+		barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+		barrier.dstAccessMask = VK_ACCESS_VERTEX_ATTRIBUTE_READ_BIT | VK_ACCESS_INDEX_READ_BIT | VK_ACCESS_SHADER_READ_BIT;
+		vkCmdPipelineBarrier(
+			recording.transferCommandBuffer,
+			VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_ALL_GRAPHICS_BIT,
+			0,
+			1, &barrier,
+			0, nullptr,
+			0, nullptr);
+		vkEndCommandBuffer(recording.transferCommandBuffer);
+
+		submitInfo.pCommandBuffers = &recording.transferCommandBuffer;
+		if (vkQueueSubmit(transferQueue, 1, &submitInfo, recording.fence) != VK_SUCCESS) {
+			throw std::runtime_error("failed to submit uploads!");
+		}
+	}
+
+	pStagingRing->Retire(recording.value);
+	inFlightQueue.push_back(std::move(recording));
+	recording = Submission();
+	releaseBufferBarrierVec.clear();
+	releaseImageBarrierVec.clear();
+	acquireBufferBarrierVec.clear();
+	acquireImageBarrierVec.clear();
+	mipmapJobVec.clear();
+	stats.flushCount++;
+	return { submittedValue };
+}
+
+bool UploadManager::IsComplete(UploadTicket ticket)
+{
+	if (ticket.value <= completedValue)
+		return true;
+
+	Poll();
+	return ticket.value <= completedValue;
+}
+
+void UploadManager::Wait(UploadTicket ticket)
+{
+	if (ticket.value > submittedValue)
+	{
+		throw std::runtime_error("upload manager : waiting for a ticket that was never flushed!");
+	}
+
+	while (completedValue < ticket.value)
+	{
+		WaitForOldest();
+	}
+}
+
+void UploadManager::WaitIdle()
+{
+	Flush();
+	while (!inFlightQueue.empty())
+	{
+		WaitForOldest();
+	}
+}
+
+const UploadManager::UploadManagerStats& UploadManager::GetUploadManagerStats() const
+{
+	return stats;
+}
+
+bool UploadManager::IsOwnershipTransferred() const
+{
+	return transferQueueFamilyIndex != graphicsQueueFamilyIndex;
+}
+
+VkCommandBuffer UploadManager::GetRecordingCommandBuffer()
+{
+	if (recording.transferCommandBuffer == VK_NULL_HANDLE)
+	{
+		recording.transferCommandBuffer = BeginCommandBuffer(transferCommandPool);
+	}
+	return recording.transferCommandBuffer;
+}
+
+VkCommandBuffer UploadManager::BeginCommandBuffer(VkCommandPool commandPool)
+{
+	VkCommandBufferAllocateInfo allocInfo = {};
+	allocInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
+	allocInfo.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
+	allocInfo.commandPool = commandPool;
+	allocInfo.commandBufferCount = 1;
+
+	VkCommandBuffer commandBuffer;
+	if (vkAllocateCommandBuffers(pRenderer->GetDevice(), &allocInfo, &commandBuffer) != VK_SUCCESS) {
+		throw std::runtime_error("failed to allocate upload command buffer!");
+	}
+
+	VkCommandBufferBeginInfo beginInfo = {};
+	beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+	beginInfo.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+	vkBeginCommandBuffer(commandBuffer, &beginInfo);
+
+	return commandBuffer;
+}
+
+VkCommandPool UploadManager::CreateCommandPool(uint32_t queueFamilyIndex)
+{
+	VkCommandPoolCreateInfo poolInfo = {};
+	poolInfo.sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO;
+	poolInfo.queueFamilyIndex = queueFamilyIndex;
+	poolInfo.flags = VK_COMMAND_POOL_CREATE_TRANSIENT_BIT;
+
+	VkCommandPool commandPool;
+	if (vkCreateCommandPool(pRenderer->GetDevice(), &poolInfo, nullptr, &commandPool) != VK_SUCCESS) {
+		throw std::runtime_error("failed to create upload command pool!");
+	}
+	return commandPool;
+}
+
+void UploadManager::Poll()
+{
+	while (!inFlightQueue.empty() && vkGetFenceStatus(pRenderer->GetDevice(), inFlightQueue.front().fence) == VK_SUCCESS)
+	{
+		completedValue = inFlightQueue.front().value;
+		Release(inFlightQueue.front());
+		inFlightQueue.pop_front();
+	}
+	pStagingRing->Reclaim(completedValue);
+}
+
+void UploadManager::WaitForOldest()
+{
+	if (inFlightQueue.empty())
+		return;
+
+	vkWaitForFences(pRenderer->GetDevice(), 1, &inFlightQueue.front().fence, VK_TRUE, UINT64_MAX);
+	Poll();
+}
+
+void UploadManager::Release(Submission& submission)
+{
+	VkDevice device = pRenderer->GetDevice();
+	vkFreeCommandBuffers(device, transferCommandPool, 1, &submission.transferCommandBuffer);
+	if (submission.graphicsCommandBuffer != VK_NULL_HANDLE)
+	{
+		vkFreeCommandBuffers(device, graphicsCommandPool, 1, &submission.graphicsCommandBuffer);
+	}
+	if (submission.semaphore != VK_NULL_HANDLE)
+	{
+		vkDestroySemaphore(device, submission.semaphore, nullptr);
+	}
+	vkDestroyFence(device, submission.fence, nullptr);
+	for (StagingRing::Region& region : submission.dedicatedStagingVec)
+	{
+		pRenderer->DestroyBuffer(region.buffer, region.dedicatedAllocation);
+	}
+}
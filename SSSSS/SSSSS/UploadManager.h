@@ -0,0 +1,110 @@
+#pragma once
+
+#include <deque>
+
+#include "GlobalInclude.h"
+#include "StagingRing.h"
+
+class Renderer;
+
+//identifies the uploads of one flush, value 0 is complete from the start
+struct UploadTicket
+{
+	uint64_t value = 0;
+};
+
+//uploads that do not block the render loop, recorded on a transfer only queue when the device has one,
+//ownership of the written ranges and images is then released to the graphics queue and acquired there,
+//every flush signals an increasing ticket value that completes once the data is usable by the graphics queue,
+//staging memory comes from the staging ring of the renderer, retired with the ticket values
+class UploadManager
+{
+public:
+	//instrumentation
+	struct UploadManagerStats
+	{
+		uint32_t flushCount = 0;
+		uint32_t dedicatedStagingCount = 0;
+		VkDeviceSize uploadedSize = 0;
+	};
+
+	UploadManager();
+	~UploadManager();
+
+	void InitUploadManager(Renderer* _pRenderer, StagingRing* _pStagingRing, uint32_t _transferQueueFamilyIndex, VkQueue _transferQueue, uint32_t _graphicsQueueFamilyIndex, VkQueue _graphicsQueue);
+	void CleanUp();
+	bool HasDedicatedTransferQueue() const;
+
+	//staging memory for the next upload, write the data to pData before recording the copy
+	StagingRing::Region AllocateStaging(VkDeviceSize size);
+	//only reclaims what already finished, never flushes or waits
+	bool TryAllocateStaging(VkDeviceSize size, StagingRing::Region& region);
+	void CopyBuffer(const StagingRing::Region& source, VkBuffer dstBuffer, VkDeviceSize dstOffset, VkDeviceSize size);
+	//copies mip 0 and leaves all levels in VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL, mips are generated on the graphics queue
+	void CopyBufferToImage(const StagingRing::Region& source, VkImage image, VkFormat format, uint32_t width, uint32_t height, uint32_t mipLevels, bool generateMipmaps);
+	//copies levels at once from a staging region holding prebuilt levels, one region per level with absolute buffer offsets,
+	//the levels from baseMipLevel to baseMipLevel + levelCount go to VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL, their previous contents are discarded
+	void CopyBufferToImageLevels(const StagingRing::Region& source, VkImage image, VkFormat format, const std::vector<VkBufferImageCopy>& regionVec, uint32_t baseMipLevel, uint32_t levelCount);
+	//moves a linear image the cpu wrote in place from VK_IMAGE_LAYOUT_PREINITIALIZED to VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL on the graphics queue
+	void TransitionHostWrittenImage(VkImage image, uint32_t mipLevels);
+	//submits everything recorded since the last flush
+	UploadTicket Flush();
+
+	//polls, never blocks
+	bool IsComplete(UploadTicket ticket);
+	void Wait(UploadTicket ticket);
+	void WaitIdle();
+	const UploadManagerStats& GetUploadManagerStats() const;
+
+private:
+	struct MipmapJob
+	{
+		VkImage image;
+		VkFormat format;
+		uint32_t width;
+		uint32_t height;
+		uint32_t mipLevels;
+	};
+
+	//one flush on its way through the queues
+	struct Submission
+	{
+		uint64_t value = 0;
+		VkCommandBuffer transferCommandBuffer = VK_NULL_HANDLE;
+		VkCommandBuffer graphicsCommandBuffer = VK_NULL_HANDLE;//null when the transfer queue is the graphics queue
+		VkSemaphore semaphore = VK_NULL_HANDLE;//transfer to graphics
+		VkFence fence = VK_NULL_HANDLE;
+		std::vector<StagingRing::Region> dedicatedStagingVec;
+	};
+
+	Renderer* pRenderer;
+	uint32_t transferQueueFamilyIndex;
+	uint32_t graphicsQueueFamilyIndex;
+	VkQueue transferQueue;
+	VkQueue graphicsQueue;
+	VkCommandPool transferCommandPool;
+	VkCommandPool graphicsCommandPool;
+	StagingRing* pStagingRing;
+	UploadManagerStats stats;
+
+	//the flush being recorded
+	Submission recording;
+	std::vector<VkBufferMemoryBarrier> releaseBufferBarrierVec;
+	std::vector<VkImageMemoryBarrier> releaseImageBarrierVec;
+	std::vector<VkBufferMemoryBarrier> acquireBufferBarrierVec;
+	std::vector<VkImageMemoryBarrier> acquireImageBarrierVec;
+	std::vector<MipmapJob> mipmapJobVec;
+
+	std::deque<Submission> inFlightQueue;
+	uint64_t submittedValue;
+	uint64_t completedValue;
+
+	bool IsOwnershipTransferred() const;
+	VkCommandBuffer GetRecordingCommandBuffer();
+	void RecordImageCopy(const StagingRing::Region& source, VkImage image, VkFormat format, uint32_t width, uint32_t height, uint32_t baseMipLevel, uint32_t mipLevels, const std::vector<VkBufferImageCopy>& regionVec, bool generateMipmaps);
+	VkCommandBuffer BeginCommandBuffer(VkCommandPool commandPool);
+	VkCommandPool CreateCommandPool(uint32_t queueFamilyIndex);
+	void Poll();
+	void WaitForOldest();
+	void Release(Submission& submission);
+};
@@ -7,10 +7,13 @@
 
 void main() 
 {
-    gl_Position = vec4(inPosition, 1.0);
-	fragPosition = inPosition;
-    fragGeometryNormal = inNormal;
-	fragTangent = inTangent.xyz;
-	fragBitangent = cross(inNormal, inTangent.xyz) * inTangent.w;
-    fragTexCoord = inTexCoord;
+	vec3 position = GetVertexPosition();
+	vec3 normal = GetVertexNormal();
+	vec4 tangent = GetVertexTangent();
+    gl_Position = vec4(position, 1.0);
+	fragPosition = position;
+    fragGeometryNormal = normal;
+	fragTangent = tangent.xyz;
+	fragBitangent = cross(normal, tangent.xyz) * tangent.w;
+    fragTexCoord = GetVertexTexCoord();
 }
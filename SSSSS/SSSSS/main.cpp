@@ -14,6 +14,7 @@
 #include "imgui/imgui_impl_vulkan.h"//ImGui_ImplVulkan_Init and ImGui_ImplVulkan_CreateDeviceObjects are modified to support msaa
 
 #include <iterator>
+#include <chrono>
 
 const float EPSILON = 0.001f;
 const int WIDTH = 1600;
@@ -44,6 +45,7 @@ Shader mFragShaderSkin(Shader::ShaderType::FragmentShader, "skinTSM.frag");
 Shader mVertShaderDeferred(Shader::ShaderType::VertexShader, "deferred.vert");
 Shader mFragShaderDeferred(Shader::ShaderType::FragmentShader, "deferred.frag");
 //Shader mVertShaderShadow(Shader::ShaderType::VertexShader, "shadow.vert");
+Shader mVertShaderTSM(Shader::ShaderType::VertexShader, "shadowTSM.vert");
 Shader mFragShaderTSM(Shader::ShaderType::FragmentShader, "shadowTSM.frag");
 Shader mFragShaderBlurH(Shader::ShaderType::FragmentShader, "blurh.frag");
 Shader mFragShaderBlurV(Shader::ShaderType::FragmentShader, "blurv.frag");
@@ -82,6 +84,10 @@ static int updateSettings = 0;
 static int updateCamera = 0;
 static int updateHead = 0;
 static bool rotateHead = true;
+static float startupMs = 0.0f;//InitRenderer and InitImGui, where the pipelines are created
+//true records every InitAssets upload into one batch with a single gpu wait,
+//false sends them through the upload manager and the first frames render while they arrive, passes skip what is still uploading
+static const bool batchUploads = true;
 
 //imgui stuff
 VkDescriptorPool ImGuiDescriptorPool;
@@ -98,37 +104,41 @@ void CreatePasses()
 	//shadow
 	mPassShadowRed.SetCamera(&mCameraRedLight);
 	mPassShadowRed.AddMesh(&mMeshHead);
+	mPassShadowRed.SetLodPolicy(Pass::LodPolicy::Fixed, 1);
 	//mPassShadowRed.AddMesh(&mMeshSquareX);
 	//mPassShadowRed.AddMesh(&mMeshSquareY);
 	//mPassShadowRed.AddMesh(&mMeshSquareZ);
 	mPassShadowRed.AddRenderTexture(&mRenderTextureRedLight);
 	mPassShadowRed.AddRenderTexture(&mRenderTextureRedLightTSM);
-	mPassShadowRed.AddShader(&mVertShaderSkin);
+	mPassShadowRed.AddShader(&mVertShaderTSM);
 	mPassShadowRed.AddShader(&mFragShaderTSM);
 
 	mPassShadowGreen.SetCamera(&mCameraGreenLight);
 	mPassShadowGreen.AddMesh(&mMeshHead);
+	mPassShadowGreen.SetLodPolicy(Pass::LodPolicy::Fixed, 1);
 	//mPassShadowGreen.AddMesh(&mMeshSquareX);
 	//mPassShadowGreen.AddMesh(&mMeshSquareY);
 	//mPassShadowGreen.AddMesh(&mMeshSquareZ);
 	mPassShadowGreen.AddRenderTexture(&mRenderTextureGreenLight);
 	mPassShadowGreen.AddRenderTexture(&mRenderTextureGreenLightTSM);
-	mPassShadowGreen.AddShader(&mVertShaderSkin);
+	mPassShadowGreen.AddShader(&mVertShaderTSM);
 	mPassShadowGreen.AddShader(&mFragShaderTSM);
 
 	mPassShadowBlue.SetCamera(&mCameraBlueLight);
 	mPassShadowBlue.AddMesh(&mMeshHead);
+	mPassShadowBlue.SetLodPolicy(Pass::LodPolicy::Fixed, 1);
 	//mPassShadowBlue.AddMesh(&mMeshSquareX);
 	//mPassShadowBlue.AddMesh(&mMeshSquareY);
 	//mPassShadowBlue.AddMesh(&mMeshSquareZ);
 	mPassShadowBlue.AddRenderTexture(&mRenderTextureBlueLight);
 	mPassShadowBlue.AddRenderTexture(&mRenderTextureBlueLightTSM);
-	mPassShadowBlue.AddShader(&mVertShaderSkin);
+	mPassShadowBlue.AddShader(&mVertShaderTSM);
 	mPassShadowBlue.AddShader(&mFragShaderTSM);
 
 	//skin
 	mPassSkin.SetCamera(&mCameraOffscreen);
 	mPassSkin.AddMesh(&mMeshHead);
+	mPassSkin.SetLodPolicy(Pass::LodPolicy::ScreenSpaceError, 0, 1.0f);
 	mPassSkin.AddTexture(&mTextureColorSkin);
 	mPassSkin.AddTexture(&mTextureNormalSkin);
 	mPassSkin.AddTexture(&mTextureTransmitanceMask);
@@ -228,6 +238,29 @@ void CreateScenes()
 
 void CreateLevels()
 {
+	//the head uses 20 byte vertices, every vertex shader drawing it has to be compiled for the same format
+	mMeshHead.SetVertexFormat(VERTEX_FORMAT::CompactQuantized);
+	//positions and normals in their own streams, the shadow passes(VERTEX_INPUT::PositionNormal) read 12 instead of 20 bytes per vertex
+	mMeshHead.SetSplitVertexStreams(true);
+	//shadow maps are low frequency enough for half the triangles, the skin pass picks its lod by screen space error
+	mMeshHead.SetLodCount(4);
+	//clusters let every pass skip the parts of the head outside its frustum or facing away from its camera
+	mMeshHead.SetBuildClusters(true);
+	mVertShaderSkin.SetVertexFormat(VERTEX_FORMAT::CompactQuantized);
+	mVertShaderTSM.SetVertexFormat(VERTEX_FORMAT::CompactQuantized);
+	mVertShaderTSM.SetVertexInput(VERTEX_INPUT::PositionNormal);
+	//uncompressed textures keep only the channels their usage reads
+	mTextureNormalSkin.SetUsage(Texture::Usage::Normal);
+	mTextureNormalBrick.SetUsage(Texture::Usage::Normal);
+	mTextureTransmitanceMask.SetUsage(Texture::Usage::Mask);
+	//the skin maps are cooked into bc formats, a quarter of the memory of rgba8 for color and normals, an eighth for the mask
+	mTextureColorSkin.SetCompression(Texture::Compression::BC7);
+	mTextureNormalSkin.SetCompression(Texture::Compression::BC5);
+	mTextureTransmitanceMask.SetCompression(Texture::Compression::BC4);
+	//the skin pass renders with the mip tails of the skin maps right away and sharpens as the larger levels stream in
+	mTextureColorSkin.SetStreaming(true);
+	mTextureNormalSkin.SetStreaming(true);
+	mTextureTransmitanceMask.SetStreaming(true);
 	mLevel.AddLight(&mLightRed);
 	mLevel.AddLight(&mLightGreen);
 	mLevel.AddLight(&mLightBlue);
@@ -262,6 +295,7 @@ void CreateLevels()
 	mLevel.AddShader(&mVertShaderDeferred);
 	mLevel.AddShader(&mFragShaderDeferred);
 	//mLevel.AddShader(&mVertShaderShadow);
+	mLevel.AddShader(&mVertShaderTSM);
 	mLevel.AddShader(&mFragShaderTSM);
 	mLevel.AddShader(&mFragShaderBlurH);
 	mLevel.AddShader(&mFragShaderBlurV);
@@ -464,6 +498,7 @@ void InitRenderer()
 	//}
 
 	//3.parse levels to create descriptor pool and initialize levels
+	mRenderer.SetBatchUploads(batchUploads);
 	mRenderer.InitAssets();
 
 	//4.pipelines
@@ -523,7 +558,7 @@ void InitImGui()
 	init_info.Device = mRenderer.GetDevice();
 	init_info.QueueFamily = mRenderer.GetGraphicsQueueFamilyIndex();
 	init_info.Queue = mRenderer.GetGraphicsQueue();
-	init_info.PipelineCache = VK_NULL_HANDLE;
+	init_info.PipelineCache = mRenderer.GetPipelineCache();
 	init_info.DescriptorPool = ImGuiDescriptorPool;
 	init_info.Allocator = VK_NULL_HANDLE;
 	init_info.CheckVkResultFn = VK_NULL_HANDLE;
@@ -732,6 +767,54 @@ void DrawImGui(VkCommandBuffer commandBuffer)
 	}
 
 	ImGui::Text("Application average %.3f ms/frame (%.1f FPS)", 1000.0f / ImGui::GetIO().Framerate, ImGui::GetIO().Framerate);
+
+	const Mesh::MeshStats& headStats = mMeshHead.GetMeshStats();
+	ImGui::Text("head: %u vertices, %u triangles, %.2f MB vertex buffer", headStats.vertexCount, headStats.triangleCount, headStats.vertexBufferSize / (1024.0f * 1024.0f));
+	ImGui::Text("head: ACMR %.3f -> %.3f, ATVR %.3f -> %.3f", headStats.acmrBefore, headStats.acmrAfter, headStats.atvrBefore, headStats.atvrAfter);
+	ImGui::Text("head: %s indices, %u sub-meshes, %.2f MB index buffer", mMeshHead.GetIndexType() == VK_INDEX_TYPE_UINT16 ? "16 bit" : "32 bit", headStats.subMeshCount, headStats.indexBufferSize / (1024.0f * 1024.0f));
+	for (uint32_t i = 0; i < mMeshHead.GetLodCount(); i++)
+	{
+		const Mesh::Lod& lod = mMeshHead.GetLod(i);
+		ImGui::Text("head lod %u: %u triangles, error %.4f%s", i, lod.indexCount / 3, lod.error, mPassSkin.SelectLod(mMeshHead) == i ? " (skin pass)" : "");
+	}
+	const Renderer::UploadStats& uploadStats = mRenderer.GetUploadStats();
+	ImGui::Text("startup: %s InitAssets %.1f ms, %u gpu waits, %u staging ring allocations, %u staging buffers (%.2f MB)", batchUploads ? "batched" : "async", uploadStats.initAssetsMs, uploadStats.submitCount, uploadStats.stagingRingAllocationCount, uploadStats.stagingBufferCount, uploadStats.stagingSize / (1024.0f * 1024.0f));
+	const Renderer::PipelineCacheStats& pipelineCacheStats = mRenderer.GetPipelineCacheStats();
+	ImGui::Text("startup: %.1f ms with a %s pipeline cache (%.1f KB loaded), %u pipelines in %.1f ms", startupMs, pipelineCacheStats.warm ? "warm" : "cold", pipelineCacheStats.loadedSize / 1024.0f, pipelineCacheStats.pipelineCount, pipelineCacheStats.createPipelinesMs);
+	const std::array<const Shader*, 8> pShaderArr = { &mVertShaderSkin, &mFragShaderSkin, &mVertShaderDeferred, &mFragShaderDeferred, &mVertShaderTSM, &mFragShaderTSM, &mFragShaderBlurH, &mFragShaderBlurV };
+	uint32_t cachedShaderCount = 0;
+	float shaderMs = 0.0f;
+	for (auto pShader : pShaderArr)
+	{
+		cachedShaderCount += pShader->GetShaderStats().fromShaderCache ? 1 : 0;
+		shaderMs += pShader->GetShaderStats().createMs;
+	}
+	ImGui::Text("shaders: %u of %zu from the shader cache, %.1f ms of work on %u threads", cachedShaderCount, pShaderArr.size(), shaderMs, mRenderer.GetThreadPool()->GetThreadCount());
+	ImGui::Text("unified memory: %s, %u resources written in place (%.2f MB)", mRenderer.IsUnifiedMemory() ? "yes" : "no", uploadStats.directWriteCount, uploadStats.directWriteSize / (1024.0f * 1024.0f));
+	UploadManager* pUploadManager = mRenderer.GetUploadManager();
+	const UploadManager::UploadManagerStats& uploadManagerStats = pUploadManager->GetUploadManagerStats();
+	ImGui::Text("async uploads: %s queue, %u flushes, %u dedicated staging buffers, %.2f MB", pUploadManager->HasDedicatedTransferQueue() ? "transfer" : "graphics", uploadManagerStats.flushCount, uploadManagerStats.dedicatedStagingCount, uploadManagerStats.uploadedSize / (1024.0f * 1024.0f));
+	const GeometryArena::ArenaStats& arenaStats = mRenderer.GetGeometryArena()->GetArenaStats();
+	ImGui::Text("geometry arena: %u allocations in %u blocks, %.2f of %.2f MB used", arenaStats.allocationCount, arenaStats.blockCount, arenaStats.usedSize / (1024.0f * 1024.0f), arenaStats.reservedSize / (1024.0f * 1024.0f));
+	const std::array<std::pair<const char*, const Texture*>, 3> streamingTextureArr = { {
+		{ "skin color", &mTextureColorSkin }, { "skin normal", &mTextureNormalSkin }, { "transmittance mask", &mTextureTransmitanceMask } } };
+	for (const auto& streamingTexture : streamingTextureArr)
+	{
+		ImGui::Text("%s: levels %u-%u of %u resident%s", streamingTexture.first, streamingTexture.second->GetResidentLevel(), streamingTexture.second->GetMipLevels() - 1, streamingTexture.second->GetMipLevels(), streamingTexture.second->IsStreaming() ? ", streaming" : "");
+	}
+	const ImageCache::ImageCacheStats& imageCacheStats = mRenderer.GetImageCache()->GetImageCacheStats();
+	const SamplerCache::SamplerCacheStats& samplerCacheStats = mRenderer.GetSamplerCache()->GetSamplerCacheStats();
+	ImGui::Text("shared: %u texture images for %u textures (%.2f MB), %u samplers for %u textures", imageCacheStats.imageCount, imageCacheStats.referenceCount, imageCacheStats.imageSize / (1024.0f * 1024.0f), samplerCacheStats.samplerCount, samplerCacheStats.referenceCount);
+	const DeviceMemoryAllocator::MemoryStats& memoryStats = mRenderer.GetMemoryStats();
+	ImGui::Text("device memory: %u allocations, %u of %u vkAllocateMemory (%u blocks, %u dedicated), %.2f of %.2f MB used", memoryStats.allocationCount, memoryStats.deviceAllocationCount, memoryStats.maxDeviceAllocationCount, memoryStats.blockCount, memoryStats.dedicatedCount, memoryStats.usedSize / (1024.0f * 1024.0f), memoryStats.reservedSize / (1024.0f * 1024.0f));
+	const std::array<std::pair<const char*, const Pass*>, 4> cullPassArr = { {
+		{ "shadow red", &mPassShadowRed }, { "shadow green", &mPassShadowGreen }, { "shadow blue", &mPassShadowBlue }, { "skin", &mPassSkin } } };
+	for (const auto& cullPass : cullPassArr)
+	{
+		const Pass::CullStats& cullStats = cullPass.second->GetCullStats();
+		ImGui::Text("%s: %u/%u clusters, culled %u frustum + %u cone of %u triangles, %u draws, %u meshes uploading", cullPass.first,
+			cullStats.visibleClusterCount, cullStats.clusterCount, cullStats.frustumCulledTriangleCount, cullStats.coneCulledTriangleCount, cullStats.triangleCount, cullStats.drawCount, cullStats.pendingMeshCount);
+	}
 	ImGui::End();
 
 	// Rendering
@@ -742,6 +825,7 @@ void DrawImGui(VkCommandBuffer commandBuffer)
 void DrawBegin()
 {
 	newFrame = mRenderer.WaitForFence();
+	mRenderer.frameVec[newFrame].UpdateTextureBindings();
 	mRenderer.BeginCommandBuffer(mRenderer.defaultCommandBuffers[newFrame]);
 	//mRenderer.frameVec[imageIndex].UpdateFrameUniformBuffer();
 	
@@ -1080,6 +1164,7 @@ void MainLoop()
 	{
 		glfwPollEvents();
 		UpdateGameLogic();
+		mRenderer.UpdateTextureStreaming();
 		DrawBegin();
 		UpdateUniformBuffers();//update CPU data before submit the command buffer
 		DrawEnd();
@@ -1106,8 +1191,10 @@ int main()
 		CreateScenes();
 		CreateLevels();
 		CreateWindow();
+		auto startTime = std::chrono::high_resolution_clock::now();
 		InitRenderer();
 		InitImGui();
+		startupMs = std::chrono::duration<float, std::chrono::milliseconds::period>(std::chrono::high_resolution_clock::now() - startTime).count();
 		MainLoop();
 		CleanUp();
 	}
@@ -7,5 +7,5 @@
 
 void main() 
 {
-    gl_Position = passUBO.proj * passUBO.view * objectUBO.model * vec4(inPosition, 1.0);
+    gl_Position = passUBO.proj * passUBO.view * objectUBO.model * vec4(GetVertexPosition(), 1.0);
 }
@@ -0,0 +1,14 @@
+#version 450
+#extension GL_ARB_separate_shader_objects : enable
+#extension GL_KHR_vulkan_glsl : enable
+
+#include "GlobalInclude.glsl"
+#include "GlobalIncludeVert.glsl"
+
+//compiled with VERTEX_INPUT_POSITION_NORMAL, shadowTSM.frag only reads the depth and the geometry normal
+void main() 
+{
+	vec4 positionWorld = objectUBO.model * vec4(GetVertexPosition(), 1.0);
+	gl_Position = passUBO.proj * passUBO.view * positionWorld;
+	fragGeometryNormal = (objectUBO.modelInvTrans * vec4(GetVertexNormal(), 0.0)).xyz;
+}
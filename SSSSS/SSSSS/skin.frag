@@ -20,8 +20,8 @@ void main()
 	vec2 uv = FlipV(fragTexCoord);
 	//TBN have to be re-normalized because of the fragment interpolation 
 	mat3 tangentToWorld = mat3(normalize(fragTangent), normalize(fragBitangent), normalize(fragGeometryNormal));
-	vec3 normal = texture(texSamplerNormal, uv).xyz;
-	vec3 normalWorld = normalize(tangentToWorld * normalize((normal * 2.0 - 1.0)));
+	vec3 normal = UnpackNormal(texture(texSamplerNormal, uv).xy);
+	vec3 normalWorld = normalize(tangentToWorld * normal);
 	vec3 normalWorldAsColor = normalWorld * 0.5 + 0.5;
 	vec3 albedo = texture(texSamplerColor, uv).rgb;
 	vec3 cameraDirWorld = normalize(passUBO.cameraPosition.xyz - fragPosition);
@@ -7,11 +7,14 @@
 
 void main() 
 {
-	vec4 positionWorld = objectUBO.model * vec4(inPosition, 1.0);
+	vec3 position = GetVertexPosition();
+	vec3 normal = GetVertexNormal();
+	vec4 tangent = GetVertexTangent();
+	vec4 positionWorld = objectUBO.model * vec4(position, 1.0);
 	fragPosition = positionWorld.xyz;
     gl_Position = passUBO.proj * passUBO.view * positionWorld;
-    fragGeometryNormal = (objectUBO.modelInvTrans * vec4(inNormal, 0.0)).xyz;
-    fragTexCoord = inTexCoord;
-	fragTangent = normalize((objectUBO.model * vec4(inTangent.xyz, 0.0)).xyz);
-	fragBitangent = normalize((objectUBO.model * vec4(cross(inNormal, inTangent.xyz) * inTangent.w, 0.0)).xyz);
+    fragGeometryNormal = (objectUBO.modelInvTrans * vec4(normal, 0.0)).xyz;
+    fragTexCoord = GetVertexTexCoord();
+	fragTangent = normalize((objectUBO.model * vec4(tangent.xyz, 0.0)).xyz);
+	fragBitangent = normalize((objectUBO.model * vec4(cross(normal, tangent.xyz) * tangent.w, 0.0)).xyz);
 }
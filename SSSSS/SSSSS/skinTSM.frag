@@ -22,11 +22,11 @@ void main()
 	vec2 uv = FlipV(fragTexCoord);
 	//TBN have to be re-normalized because of the fragment interpolation 
 	mat3 tangentToWorld = mat3(normalize(fragTangent), normalize(fragBitangent), normalize(fragGeometryNormal));
-	vec3 normal = texture(texSamplerNormal, uv).xyz;
-	vec3 normalWorld = normalize(tangentToWorld * normalize((normal * 2.0 - 1.0)));
+	vec3 normal = UnpackNormal(texture(texSamplerNormal, uv).xy);
+	vec3 normalWorld = normalize(tangentToWorld * normal);
 	vec3 normalWorldAsColor = normalWorld * 0.5 + 0.5;
 	vec3 albedo = texture(texSamplerColor, uv).rgb;
-	vec3 transmitanceMask = texture(texSamplerTransmitanceMask, uv).rgb;
+	float transmitanceMask = texture(texSamplerTransmitanceMask, uv).r;//a one channel texture(r8 or bc4)
 	vec3 cameraDirWorld = normalize(passUBO.cameraPosition.xyz - fragPosition);
 	
 	vec3 diffuseTotal = vec3(0, 0, 0);
@@ -57,7 +57,7 @@ void main()
 			vec3 distortedNormal = - (lightDir + sceneUBO.distortion *
 												transmitanceMask *
 												normalWorld);
-			TSM.gba *= pow(clamp(transmitanceMask.r * dot(cameraDirWorld, distortedNormal), 0, 1), sceneUBO.translucencyPower) * sceneUBO.lightArr[i].color.xyz;
+			TSM.gba *= pow(clamp(transmitanceMask * dot(cameraDirWorld, distortedNormal), 0, 1), sceneUBO.translucencyPower) * sceneUBO.lightArr[i].color.xyz;
 			shadow = TSM.r;
 		}
 		else if(sceneUBO.shadowMode == 4)
@@ -66,7 +66,7 @@ void main()
 			vec3 distortedNormal = - (lightDir + sceneUBO.distortion *
 												transmitanceMask *
 												normalWorld);
-			TSM.gba = pow(clamp(transmitanceMask.r * dot(cameraDirWorld, distortedNormal), 0, 1), sceneUBO.translucencyPower) * sceneUBO.lightArr[i].color.xyz;
+			TSM.gba = pow(clamp(transmitanceMask * dot(cameraDirWorld, distortedNormal), 0, 1), sceneUBO.translucencyPower) * sceneUBO.lightArr[i].color.xyz;
 			shadow = ShadowFeelerPCF_7X7(
 						sceneUBO.lightArr[i].view,
 						sceneUBO.lightArr[i].proj,
@@ -0,0 +1,236 @@
+#include "BlockCompressor.h"
+
+#include <cmath>
+#include <cstring>
+#include <algorithm>
+
+#include "ThreadPool.h"
+#include "Check.h"
+
+//reference decoders of the formats, straight from the block layouts in the vulkan spec
+static void UnpackRGB565(uint16_t packed, float* color)
+{
+	uint32_t r = (packed >> 11) & 31;
+	uint32_t g = (packed >> 5) & 63;
+	uint32_t b = packed & 31;
+	color[0] = static_cast<float>((r << 3) | (r >> 2));
+	color[1] = static_cast<float>((g << 2) | (g >> 4));
+	color[2] = static_cast<float>((b << 3) | (b >> 2));
+}
+
+static void DecodeBC1Block(const uint8_t* block, float (*texels)[3])
+{
+	uint16_t color0;
+	uint16_t color1;
+	uint32_t indices;
+	memcpy(&color0, block, 2);
+	memcpy(&color1, block + 2, 2);
+	memcpy(&indices, block + 4, 4);
+
+	float palette[4][3];
+	UnpackRGB565(color0, palette[0]);
+	UnpackRGB565(color1, palette[1]);
+	for (uint32_t c = 0; c < 3; c++)
+	{
+		if (color0 > color1)
+		{
+			palette[2][c] = (2.0f * palette[0][c] + palette[1][c]) / 3.0f;
+			palette[3][c] = (palette[0][c] + 2.0f * palette[1][c]) / 3.0f;
+		}
+		else
+		{
+			palette[2][c] = (palette[0][c] + palette[1][c]) / 2.0f;
+			palette[3][c] = 0.0f;
+		}
+	}
+	for (uint32_t i = 0; i < 16; i++)
+	{
+		memcpy(texels[i], palette[(indices >> (i * 2)) & 3], sizeof(texels[i]));
+	}
+}
+
+static void DecodeBC4Block(const uint8_t* block, float* texels)
+{
+	float palette[8];
+	palette[0] = block[0];
+	palette[1] = block[1];
+	if (block[0] > block[1])
+	{
+		for (uint32_t i = 1; i < 7; i++)
+			palette[i + 1] = ((7 - i) * palette[0] + i * palette[1]) / 7.0f;
+	}
+	else
+	{
+		for (uint32_t i = 1; i < 5; i++)
+			palette[i + 1] = ((5 - i) * palette[0] + i * palette[1]) / 5.0f;
+		palette[6] = 0.0f;
+		palette[7] = 255.0f;
+	}
+
+	uint64_t indices = 0;
+	memcpy(&indices, block + 2, 6);
+	for (uint32_t i = 0; i < 16; i++)
+	{
+		texels[i] = palette[(indices >> (i * 3)) & 7];
+	}
+}
+
+//smooth gradients in every channel, what bc formats are built for
+static std::vector<uint8_t> BuildGradient(uint32_t width, uint32_t height)
+{
+	std::vector<uint8_t> image(static_cast<size_t>(width) * height * 4);
+	for (uint32_t y = 0; y < height; y++)
+	{
+		for (uint32_t x = 0; x < width; x++)
+		{
+			uint8_t* texel = &image[(static_cast<size_t>(y) * width + x) * 4];
+			texel[0] = static_cast<uint8_t>(x * 255 / std::max(width - 1, 1u));
+			texel[1] = static_cast<uint8_t>(y * 255 / std::max(height - 1, 1u));
+			texel[2] = static_cast<uint8_t>((x + y) * 255 / std::max(width + height - 2, 1u));
+			texel[3] = 255;
+		}
+	}
+	return image;
+}
+
+struct RoundTripError
+{
+	float maxError;
+	float rmse;
+};
+
+//compares every channel of every texel inside the image, the padding of partial blocks is skipped
+static RoundTripError MeasureRoundTrip(const std::vector<uint8_t>& image, uint32_t width, uint32_t height, BlockCompressor::Format format)
+{
+	std::vector<uint8_t> compressed(BlockCompressor::GetLevelSize(width, height, format));
+	BlockCompressor::CompressLevel(image.data(), width, height, format, compressed.data(), nullptr);
+
+	uint32_t channelCount = format == BlockCompressor::Format::BC1 ? 3 : 1;
+	uint32_t blockCountX = (width + 3) / 4;
+	uint32_t blockSize = BlockCompressor::GetBlockSize(format);
+	RoundTripError error = { 0.0f, 0.0f };
+	double squaredSum = 0.0;
+	for (uint32_t y = 0; y < height; y++)
+	{
+		for (uint32_t x = 0; x < width; x++)
+		{
+			const uint8_t* block = &compressed[(static_cast<size_t>(y / 4) * blockCountX + x / 4) * blockSize];
+			uint32_t index = (y % 4) * 4 + x % 4;
+			float decoded[3];
+			if (format == BlockCompressor::Format::BC1)
+			{
+				float texels[16][3];
+				DecodeBC1Block(block, texels);
+				memcpy(decoded, texels[index], sizeof(decoded));
+			}
+			else
+			{
+				float texels[16];
+				DecodeBC4Block(block, texels);
+				decoded[0] = texels[index];
+			}
+
+			const uint8_t* texel = &image[(static_cast<size_t>(y) * width + x) * 4];
+			for (uint32_t c = 0; c < channelCount; c++)
+			{
+				float difference = std::abs(decoded[c] - texel[c]);
+				error.maxError = std::max(error.maxError, difference);
+				squaredSum += difference * difference;
+			}
+		}
+	}
+	error.rmse = static_cast<float>(std::sqrt(squaredSum / (static_cast<double>(width) * height * channelCount)));
+	return error;
+}
+
+//a 4 color palette along the principal axis of every block keeps a smooth gradient within a few steps of 565
+static void TestBC1GradientError()
+{
+	std::vector<uint8_t> image = BuildGradient(64, 64);
+	RoundTripError error = MeasureRoundTrip(image, 64, 64, BlockCompressor::Format::BC1);
+	CHECK(error.maxError <= 16.0f);
+	CHECK(error.rmse <= 4.0f);
+}
+
+//8 values between the extremes of every block, a gradient of one channel is almost exact
+static void TestBC4GradientError()
+{
+	std::vector<uint8_t> image = BuildGradient(64, 64);
+	RoundTripError error = MeasureRoundTrip(image, 64, 64, BlockCompressor::Format::BC4);
+	CHECK(error.maxError <= 1.5f);
+	CHECK(error.rmse <= 1.0f);
+}
+
+//a solid block only loses the 565 quantization in bc1 and nothing in bc4
+static void TestSolidColor()
+{
+	std::vector<uint8_t> image(8 * 8 * 4);
+	for (size_t i = 0; i < image.size(); i += 4)
+	{
+		image[i] = 200;
+		image[i + 1] = 100;
+		image[i + 2] = 40;
+		image[i + 3] = 255;
+	}
+	RoundTripError bc1 = MeasureRoundTrip(image, 8, 8, BlockCompressor::Format::BC1);
+	RoundTripError bc4 = MeasureRoundTrip(image, 8, 8, BlockCompressor::Format::BC4);
+	CHECK(bc1.maxError <= 4.0f);
+	CHECK(bc4.maxError == 0.0f);
+}
+
+//partial blocks at the edges repeat the last texel, so they encode exactly like an image padded that way
+static void TestPartialBlocksRepeatEdges()
+{
+	const uint32_t width = 13;
+	const uint32_t height = 7;
+	std::vector<uint8_t> image = BuildGradient(width, height);
+	std::vector<uint8_t> padded(16 * 8 * 4);
+	for (uint32_t y = 0; y < 8; y++)
+	{
+		for (uint32_t x = 0; x < 16; x++)
+		{
+			const uint8_t* texel = &image[(static_cast<size_t>(std::min(y, height - 1)) * width + std::min(x, width - 1)) * 4];
+			memcpy(&padded[(static_cast<size_t>(y) * 16 + x) * 4], texel, 4);
+		}
+	}
+
+	const BlockCompressor::Format formats[] = { BlockCompressor::Format::BC1, BlockCompressor::Format::BC4 };
+	for (BlockCompressor::Format format : formats)
+	{
+		std::vector<uint8_t> compressed(BlockCompressor::GetLevelSize(width, height, format));
+		std::vector<uint8_t> paddedCompressed(BlockCompressor::GetLevelSize(16, 8, format));
+		CHECK(compressed.size() == paddedCompressed.size());
+		BlockCompressor::CompressLevel(image.data(), width, height, format, compressed.data(), nullptr);
+		BlockCompressor::CompressLevel(padded.data(), 16, 8, format, paddedCompressed.data(), nullptr);
+		CHECK(compressed == paddedCompressed);
+	}
+}
+
+//rows of blocks are independent, spreading them over the pool must not change a byte
+static void TestThreadPoolMatchesSerial()
+{
+	ThreadPool threadPool;
+	threadPool.InitThreadPool(4);
+
+	std::vector<uint8_t> image = BuildGradient(128, 96);
+	const BlockCompressor::Format formats[] = { BlockCompressor::Format::BC1, BlockCompressor::Format::BC4 };
+	for (BlockCompressor::Format format : formats)
+	{
+		std::vector<uint8_t> serial(BlockCompressor::GetLevelSize(128, 96, format));
+		std::vector<uint8_t> parallel(serial.size());
+		BlockCompressor::CompressLevel(image.data(), 128, 96, format, serial.data(), nullptr);
+		BlockCompressor::CompressLevel(image.data(), 128, 96, format, parallel.data(), &threadPool);
+		CHECK(serial == parallel);
+	}
+
+	threadPool.CleanUp();
+}
+
+void RunBlockCompressorTests()
+{
+	TestBC1GradientError();
+	TestBC4GradientError();
+	TestSolidColor();
+	TestPartialBlocksRepeatEdges();
+	TestThreadPoolMatchesSerial();
+}
@@ -0,0 +1,13 @@
+#pragma once
+
+#include <cstdio>
+
+//failed checks of all tests, main returns failure unless it is 0
+inline int& FailureCount()
+{
+	static int failureCount = 0;
+	return failureCount;
+}
+
+#define CHECK(condition) \
+	do { if (!(condition)) { std::printf("%s(%d): CHECK(%s) failed\n", __FILE__, __LINE__, #condition); FailureCount()++; } } while (0)
@@ -0,0 +1,174 @@
+#include "MeshOptimizer.h"
+
+#include <algorithm>
+#include <array>
+
+#include "Check.h"
+#include "TestMesh.h"
+
+//the limits Mesh::CreateIndexBuffer splits with
+static const uint32_t MAX_16BIT_INDEX = 0xFFFF;
+static const uint32_t MAX_SUB_MESH_COUNT = 64;
+
+//every range holds triangles and every index of it fits 16 bits after subtracting its vertex offset
+static bool RangesNarrowTo16Bit(const std::vector<uint32_t>& indices, const std::vector<MeshOptimizer::IndexRange>& rangeVec)
+{
+	uint32_t coveredCount = 0;
+	for (const auto& range : rangeVec)
+	{
+		if (range.indexCount == 0 || range.firstIndex != coveredCount || range.vertexOffset < 0)
+			return false;
+		for (uint32_t i = range.firstIndex; i < range.firstIndex + range.indexCount; i++)
+		{
+			if (indices[i] < static_cast<uint32_t>(range.vertexOffset) || indices[i] - static_cast<uint32_t>(range.vertexOffset) > MAX_16BIT_INDEX)
+				return false;
+		}
+		coveredCount += range.indexCount;
+	}
+	return coveredCount == indices.size();
+}
+
+static bool Split(const std::vector<uint32_t>& indices, std::vector<MeshOptimizer::IndexRange>& rangeVec)
+{
+	return MeshOptimizer::SplitIndexRanges(indices.data(), static_cast<uint32_t>(indices.size()), MAX_16BIT_INDEX, MAX_SUB_MESH_COUNT, rangeVec);
+}
+
+static void TestSmallMeshIsOneRange()
+{
+	std::vector<uint32_t> indices = { 0, 1, 2, 2, 1, 3 };
+	std::vector<MeshOptimizer::IndexRange> rangeVec;
+	CHECK(Split(indices, rangeVec));
+	CHECK(rangeVec.size() == 1);
+	CHECK(RangesNarrowTo16Bit(indices, rangeVec));
+}
+
+static void TestDistantClustersSplit()
+{
+	std::vector<uint32_t> indices = { 0, 1, 2, 100000, 100001, 100002, 100001, 100003, 100002 };
+	std::vector<MeshOptimizer::IndexRange> rangeVec;
+	CHECK(Split(indices, rangeVec));
+	CHECK(rangeVec.size() == 2);
+	CHECK(RangesNarrowTo16Bit(indices, rangeVec));
+}
+
+//a triangle wider than 16 bits can not be narrowed by any split, the mesh has to keep 32 bit indices
+static void TestWideFirstTriangleKeeps32Bit()
+{
+	std::vector<uint32_t> indices = { 0, 1, 70000, 1, 2, 3 };
+	std::vector<MeshOptimizer::IndexRange> rangeVec;
+	CHECK(!Split(indices, rangeVec));
+}
+
+static void TestWideLaterTriangleKeeps32Bit()
+{
+	std::vector<uint32_t> indices = { 0, 1, 2, 2, 1, 3, 5, 6, 80000, 80000, 80001, 80002 };
+	std::vector<MeshOptimizer::IndexRange> rangeVec;
+	CHECK(!Split(indices, rangeVec));
+}
+
+static void TestTooManyRangesKeeps32Bit()
+{
+	std::vector<uint32_t> indices;
+	for (uint32_t i = 0; i <= MAX_SUB_MESH_COUNT; i++)
+	{
+		uint32_t base = i * (MAX_16BIT_INDEX + 1);
+		indices.insert(indices.end(), { base, base + 1, base + 2 });
+	}
+	std::vector<MeshOptimizer::IndexRange> rangeVec;
+	CHECK(!Split(indices, rangeVec));
+
+	indices.resize(MAX_SUB_MESH_COUNT * 3);
+	CHECK(Split(indices, rangeVec));
+	CHECK(rangeVec.size() == MAX_SUB_MESH_COUNT);
+	CHECK(RangesNarrowTo16Bit(indices, rangeVec));
+}
+
+static void TestEmptyListHasNoRanges()
+{
+	std::vector<uint32_t> indices;
+	std::vector<MeshOptimizer::IndexRange> rangeVec = { {} };
+	CHECK(Split(indices, rangeVec));
+	CHECK(rangeVec.empty());
+}
+
+//shuffles whole triangles with a fixed seed, a scrambled order is what the cache optimization has to repair
+static void ShuffleTriangles(std::vector<uint32_t>& indices)
+{
+	uint32_t state = 12345;
+	uint32_t triangleCount = static_cast<uint32_t>(indices.size() / 3);
+	for (uint32_t i = triangleCount - 1; i > 0; i--)
+	{
+		state = state * 1664525u + 1013904223u;
+		uint32_t j = (state >> 8) % (i + 1);
+		std::swap_ranges(indices.begin() + i * 3, indices.begin() + i * 3 + 3, indices.begin() + j * 3);
+	}
+}
+
+//triangles rotated so the smallest index comes first, which keeps the winding, and then sorted
+static std::vector<std::array<uint32_t, 3>> SortedTriangles(const std::vector<uint32_t>& indices)
+{
+	std::vector<std::array<uint32_t, 3>> triangleVec;
+	for (size_t i = 0; i + 2 < indices.size(); i += 3)
+	{
+		std::array<uint32_t, 3> triangle = { indices[i], indices[i + 1], indices[i + 2] };
+		std::rotate(triangle.begin(), std::min_element(triangle.begin(), triangle.end()), triangle.end());
+		triangleVec.push_back(triangle);
+	}
+	std::sort(triangleVec.begin(), triangleVec.end());
+	return triangleVec;
+}
+
+static void TestVertexCacheKeepsTrianglesAndLowersAcmr()
+{
+	std::vector<uint32_t> indices;
+	std::vector<Vertex> vertices;
+	BuildGrid(32, 32, indices, vertices);
+	ShuffleTriangles(indices);
+	std::vector<uint32_t> source = indices;
+	uint32_t vertexCount = static_cast<uint32_t>(vertices.size());
+
+	std::vector<uint32_t> clusterVec;
+	MeshOptimizer::OptimizeVertexCache(indices, vertexCount, clusterVec);
+	CHECK(SortedTriangles(indices) == SortedTriangles(source));
+	CHECK(!clusterVec.empty() && clusterVec[0] == 0);
+	CHECK(std::is_sorted(clusterVec.begin(), clusterVec.end()));
+
+	float sourceAcmr = MeshOptimizer::AnalyzeVertexCache(source, vertexCount).acmr;
+	float optimizedAcmr = MeshOptimizer::AnalyzeVertexCache(indices, vertexCount).acmr;
+	CHECK(optimizedAcmr <= sourceAcmr);
+	CHECK(optimizedAcmr < 1.0f);//a scrambled grid is close to 3, tipsify gets a grid well below 1
+}
+
+//overdraw ordering moves whole clusters, its threshold bounds how much acmr it may give back
+static void TestOverdrawKeepsTrianglesAndAcmr()
+{
+	std::vector<uint32_t> indices;
+	std::vector<Vertex> vertices;
+	BuildGrid(32, 32, indices, vertices);
+	ShuffleTriangles(indices);
+	std::vector<uint32_t> source = indices;
+	uint32_t vertexCount = static_cast<uint32_t>(vertices.size());
+
+	std::vector<uint32_t> clusterVec;
+	MeshOptimizer::OptimizeVertexCache(indices, vertexCount, clusterVec);
+	float cacheAcmr = MeshOptimizer::AnalyzeVertexCache(indices, vertexCount).acmr;
+	const float threshold = 1.05f;
+	MeshOptimizer::OptimizeOverdraw(indices, vertices, clusterVec, threshold);
+	CHECK(SortedTriangles(indices) == SortedTriangles(source));
+
+	float overdrawAcmr = MeshOptimizer::AnalyzeVertexCache(indices, vertexCount).acmr;
+	CHECK(overdrawAcmr <= MeshOptimizer::AnalyzeVertexCache(source, vertexCount).acmr);
+	CHECK(overdrawAcmr <= cacheAcmr * threshold);
+}
+
+void RunMeshOptimizerTests()
+{
+	TestSmallMeshIsOneRange();
+	TestDistantClustersSplit();
+	TestWideFirstTriangleKeeps32Bit();
+	TestWideLaterTriangleKeeps32Bit();
+	TestTooManyRangesKeeps32Bit();
+	TestEmptyListHasNoRanges();
+	TestVertexCacheKeepsTrianglesAndLowersAcmr();
+	TestOverdrawKeepsTrianglesAndAcmr();
+}
@@ -0,0 +1,80 @@
+#include "MeshSimplifier.h"
+
+#include <cmath>
+#include <limits>
+
+#include "Check.h"
+#include "TestMesh.h"
+
+//a triangle list that indexes the source vertices and has no collapsed triangles
+static bool IsValidTriangleList(const std::vector<uint32_t>& indices, size_t vertexCount)
+{
+	if (indices.size() % 3 != 0)
+		return false;
+	for (size_t i = 0; i < indices.size(); i += 3)
+	{
+		if (indices[i] >= vertexCount || indices[i + 1] >= vertexCount || indices[i + 2] >= vertexCount)
+			return false;
+		if (indices[i] == indices[i + 1] || indices[i + 1] == indices[i + 2] || indices[i] == indices[i + 2])
+			return false;
+	}
+	return true;
+}
+
+//every collapse on a plane is free, so the target is reached without error
+static void TestFlatGridReachesTargetWithoutError()
+{
+	std::vector<uint32_t> indices;
+	std::vector<Vertex> vertices;
+	BuildGrid(16, 16, indices, vertices);
+	uint32_t targetIndexCount = static_cast<uint32_t>(indices.size() / 2);
+
+	std::vector<uint32_t> result;
+	float error = MeshSimplifier::Simplify(indices, vertices, targetIndexCount, std::numeric_limits<float>::max(), result);
+	CHECK(!result.empty());
+	CHECK(result.size() <= targetIndexCount);
+	CHECK(IsValidTriangleList(result, vertices.size()));
+	CHECK(error < 1e-4f);
+}
+
+//a bumpy grid can only lose triangles by moving the surface, maxError caps how far
+static void TestMaxErrorBoundsTheCollapses()
+{
+	std::vector<uint32_t> indices;
+	std::vector<Vertex> vertices;
+	BuildGrid(16, 16, indices, vertices);
+	for (Vertex& vertex : vertices)
+	{
+		vertex.pos.z = std::sin(vertex.pos.x * 1.3f) * std::cos(vertex.pos.y * 0.7f);
+	}
+
+	const float maxError = 0.05f;
+	std::vector<uint32_t> result;
+	float error = MeshSimplifier::Simplify(indices, vertices, 0, maxError, result);
+	CHECK(IsValidTriangleList(result, vertices.size()));
+	CHECK(result.size() < indices.size());
+	CHECK(error <= maxError);
+
+	std::vector<uint32_t> unbounded;
+	MeshSimplifier::Simplify(indices, vertices, 0, std::numeric_limits<float>::max(), unbounded);
+	CHECK(unbounded.size() < result.size());
+}
+
+static void TestTargetAboveSourceKeepsMesh()
+{
+	std::vector<uint32_t> indices;
+	std::vector<Vertex> vertices;
+	BuildGrid(4, 4, indices, vertices);
+
+	std::vector<uint32_t> result;
+	float error = MeshSimplifier::Simplify(indices, vertices, static_cast<uint32_t>(indices.size()), std::numeric_limits<float>::max(), result);
+	CHECK(result.size() == indices.size());
+	CHECK(error == 0.0f);
+}
+
+void RunMeshSimplifierTests()
+{
+	TestFlatGridReachesTargetWithoutError();
+	TestMaxErrorBoundsTheCollapses();
+	TestTargetAboveSourceKeepsMesh();
+}
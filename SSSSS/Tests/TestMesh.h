@@ -0,0 +1,28 @@
+#pragma once
+
+#include "GlobalInclude.h"
+
+//a flat width x height grid of quads, two triangles each
+inline void BuildGrid(uint32_t width, uint32_t height, std::vector<uint32_t>& indices, std::vector<Vertex>& vertices)
+{
+	vertices.clear();
+	for (uint32_t y = 0; y <= height; y++)
+	{
+		for (uint32_t x = 0; x <= width; x++)
+		{
+			Vertex vertex = {};
+			vertex.pos = glm::vec3(static_cast<float>(x), static_cast<float>(y), 0.0f);
+			vertex.normal = glm::vec3(0.0f, 0.0f, 1.0f);
+			vertices.push_back(vertex);
+		}
+	}
+	indices.clear();
+	for (uint32_t y = 0; y < height; y++)
+	{
+		for (uint32_t x = 0; x < width; x++)
+		{
+			uint32_t i = y * (width + 1) + x;
+			indices.insert(indices.end(), { i, i + 1, i + width + 1, i + 1, i + width + 2, i + width + 1 });
+		}
+	}
+}
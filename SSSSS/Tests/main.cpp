@@ -0,0 +1,22 @@
+#include "Check.h"
+
+#include <cstdlib>
+
+void RunMeshOptimizerTests();
+void RunMeshSimplifierTests();
+void RunBlockCompressorTests();
+
+int main()
+{
+	RunMeshOptimizerTests();
+	RunMeshSimplifierTests();
+	RunBlockCompressorTests();
+
+	if (FailureCount() > 0)
+	{
+		std::printf("%d checks failed\n", FailureCount());
+		return EXIT_FAILURE;
+	}
+	std::printf("all checks passed\n");
+	return EXIT_SUCCESS;
+}